@@ -0,0 +1,128 @@
+#include "clock.h"
+#include "coarse_clock.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+namespace {
+
+volatile int64_t benchmark_sink;
+
+struct LegacyClockPath {
+  unsigned __int128 measurements = 0;
+  int64_t conversion_factor = 0;
+
+  LegacyClockPath() {
+    auto &calibration = turbokit::time_manager.calibration;
+    int64_t base_time = calibration.base_time.load();
+    int64_t base_cycles = calibration.base_cycles.load();
+    measurements = ((unsigned __int128)base_time << 64) |
+                   (unsigned __int128)(uint64_t)base_cycles;
+    conversion_factor =
+        (int64_t)(((unsigned __int128)65536 << turbokit::Clock::cycle_shift) /
+                  calibration.cycle_multiplier.load());
+  }
+
+  int64_t get_current_time() {
+    int64_t previous_time;
+    int64_t previous_cycles;
+    do {
+      previous_cycles = measurements;
+      previous_time = measurements >> 64;
+      __sync_synchronize();
+    } while ((int64_t)measurements != previous_cycles);
+    int64_t elapsed_cycles = __rdtsc() - previous_cycles;
+    return previous_time +
+           ((uint64_t)std::max(elapsed_cycles, (int64_t)1) * (uint64_t)65536) /
+               (uint64_t)conversion_factor;
+  }
+};
+
+template <typename Function>
+double measure(const char *name, size_t iterations, Function &&function) {
+  int64_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i != iterations; ++i) {
+    sink += function();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double per_call =
+      std::chrono::duration<double, std::nano>(end - start).count() /
+      iterations;
+  benchmark_sink = sink;
+  std::printf("%-32s %8.2f ns/call\n", name, per_call);
+  return per_call;
+}
+
+} // namespace
+
+int main() {
+  const size_t iterations = 20000000;
+
+  auto warmup_end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (std::chrono::steady_clock::now() < warmup_end) {
+    turbokit::clock.get_current_time();
+  }
+
+  std::printf("Single thread, %zu calls each\n", iterations);
+  measure("rdtsc", iterations, [] { return (int64_t)__rdtsc(); });
+  measure("turbokit::clock", iterations,
+          [] { return turbokit::clock.get_current_time(); });
+  measure("HighPerformanceClock::now", iterations, [] {
+    return turbokit::HighPerformanceClock::now().time_since_epoch().count();
+  });
+  LegacyClockPath legacy;
+  measure("legacy fenced division path", iterations,
+          [&] { return legacy.get_current_time(); });
+  measure("std::chrono::steady_clock", iterations, [] {
+    return (int64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+  });
+  measure("turbokit::clock wall time", iterations,
+          [] { return turbokit::clock.get_wall_time(); });
+  measure("std::chrono::system_clock", iterations, [] {
+    return (int64_t)std::chrono::system_clock::now().time_since_epoch().count();
+  });
+  measure("clock_gettime(MONOTONIC)", iterations, [] {
+    timespec time_spec;
+    clock_gettime(CLOCK_MONOTONIC, &time_spec);
+    return (int64_t)time_spec.tv_nsec;
+  });
+  turbokit::coarse_clock.start();
+  measure("coarse_clock.now", iterations,
+          [] { return turbokit::coarse_clock.now(); });
+  measure("coarse_clock.wall_now", iterations,
+          [] { return turbokit::coarse_clock.wall_now(); });
+  turbokit::coarse_clock.stop();
+
+  size_t thread_count = std::max(2u, std::thread::hardware_concurrency());
+  std::printf("\n%zu threads, %zu calls each\n", thread_count,
+              iterations / 4);
+  std::vector<std::thread> threads;
+  std::vector<double> results(thread_count);
+  for (size_t i = 0; i != thread_count; ++i) {
+    threads.emplace_back([&, i] {
+      int64_t sink = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t j = 0; j != iterations / 4; ++j) {
+        sink += turbokit::clock.get_current_time();
+      }
+      auto end = std::chrono::steady_clock::now();
+      benchmark_sink = sink;
+      results[i] = std::chrono::duration<double, std::nano>(end - start)
+                       .count() /
+                   (iterations / 4);
+    });
+  }
+  double total = 0;
+  for (size_t i = 0; i != thread_count; ++i) {
+    threads[i].join();
+    total += results[i];
+  }
+  std::printf("%-32s %8.2f ns/call\n", "turbokit::clock (per thread)",
+              total / thread_count);
+  return 0;
+}
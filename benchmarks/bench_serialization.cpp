@@ -0,0 +1,220 @@
+#include "buffer_chain.h"
+#include "compression.h"
+#include "flat_serialization.h"
+#include "perf_counters.h"
+#include "serialization.h"
+#include "stream_serialization.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+volatile size_t benchmark_sink;
+
+constexpr size_t order_count = 20000;
+constexpr size_t iterations = 50;
+
+struct Order {
+  uint64_t id;
+  std::string symbol;
+  std::vector<double> fills;
+  std::map<std::string, int64_t> tags;
+  std::optional<std::string> note;
+
+  template <typename Context> void serialize(Context &context) {
+    context(id, symbol, fills, tags, note);
+  }
+};
+
+template <typename Function>
+void measure(const char *name, size_t bytes, Function &&function) {
+  turbokit::PerfStopwatch stopwatch;
+  stopwatch.start();
+  for (size_t i = 0; i != iterations; ++i) {
+    function();
+  }
+  stopwatch.stop();
+  double nanoseconds = (double)stopwatch.elapsed_nanoseconds() / iterations;
+  std::printf("%-36s %10.1f us/op %8.2f GB/s", name, nanoseconds / 1000,
+              bytes / nanoseconds);
+  if (stopwatch.is_available()) {
+    const auto &values = stopwatch.values();
+    std::printf("  %5.2f IPC", values.instructions_per_cycle());
+  }
+  std::printf("\n");
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 random(1);
+  std::vector<Order> orders(order_count);
+  for (size_t i = 0; i != order_count; ++i) {
+    Order &order = orders[i];
+    order.id = random();
+    order.symbol = "SYM" + std::to_string(random() % 5000);
+    order.fills.resize(random() % 16);
+    for (double &fill : order.fills) {
+      fill = (double)(random() % 100000) / 100;
+    }
+    for (size_t j = random() % 4; j; --j) {
+      order.tags.emplace("tag" + std::to_string(j), (int64_t)random());
+    }
+    if (random() % 2) {
+      order.note = std::string(random() % 64, 'n');
+    }
+  }
+
+  std::vector<std::byte> reference;
+  turbokit::serializeTo(reference, orders);
+  size_t bytes = reference.size();
+  std::printf("%zu orders, %zu bytes serialized\n", order_count, bytes);
+
+  std::vector<std::byte> output;
+  measure("serialize_to (two pass)", bytes, [&] {
+    turbokit::serializeTo(output, orders);
+    benchmark_sink = output.size();
+  });
+  measure("serialize_to_growable", bytes, [&] {
+    turbokit::serializeToGrowable(output, orders);
+    benchmark_sink = output.size();
+  });
+  measure("serialize_to_buffer (two pass)", bytes, [&] {
+    turbokit::BufferHandle buffer = turbokit::serializeToBuffer(orders);
+    benchmark_sink = buffer->get_size();
+  });
+  measure("serialize_to_growable_buffer", bytes, [&] {
+    turbokit::BufferHandle buffer =
+        turbokit::serializeToGrowableBuffer(orders);
+    benchmark_sink = buffer->get_size();
+  });
+  measure("BufferChain::append_serialized", bytes, [&] {
+    turbokit::BufferChain chain;
+    chain.append_serialized(orders);
+    benchmark_sink = chain.size();
+  });
+  measure("serialize_to_framed_buffer", bytes, [&] {
+    turbokit::BufferHandle buffer = turbokit::serializeToFramedBuffer(orders);
+    benchmark_sink = buffer->get_size();
+  });
+  measure("crc32c", bytes, [&] {
+    benchmark_sink = turbokit::crc32c(reference.data(), bytes);
+  });
+  measure("crc32c_software", bytes, [&] {
+    benchmark_sink = turbokit::crc32c_software(reference.data(), bytes);
+  });
+  std::vector<std::byte> compact;
+  turbokit::serializeToCompact(compact, orders);
+  std::printf("compact format: %zu bytes\n", compact.size());
+  measure("serialize_to_compact", compact.size(), [&] {
+    turbokit::serializeToCompact(output, orders);
+    benchmark_sink = output.size();
+  });
+  std::vector<std::byte> portable;
+  turbokit::serializeToPortable(portable, orders);
+  measure("serialize_to_portable", portable.size(), [&] {
+    turbokit::serializeToPortable(output, orders);
+    benchmark_sink = output.size();
+  });
+  measure("deserialize_buffer", bytes, [&] {
+    std::vector<Order> decoded;
+    turbokit::deserializeBuffer(
+        std::string_view((const char *)reference.data(), bytes), decoded);
+    benchmark_sink = decoded.size();
+  });
+  measure("deserialize_compact_buffer", compact.size(), [&] {
+    std::vector<Order> decoded;
+    turbokit::deserializeCompactBuffer(
+        std::string_view((const char *)compact.data(), compact.size()),
+        decoded);
+    benchmark_sink = decoded.size();
+  });
+  measure("deserialize_portable_buffer", portable.size(), [&] {
+    std::vector<Order> decoded;
+    turbokit::deserializePortableBuffer(
+        std::string_view((const char *)portable.data(), portable.size()),
+        decoded);
+    benchmark_sink = decoded.size();
+  });
+
+  turbokit::BufferHandle compressed =
+      turbokit::serializeToCompressedBuffer(orders);
+  std::string_view compressed_data((const char *)compressed->get_data(),
+                                   compressed->get_size());
+  std::printf("compressed: %zu bytes\n", compressed->get_size());
+  measure("serialize_to_compressed_buffer", bytes, [&] {
+    turbokit::BufferHandle buffer =
+        turbokit::serializeToCompressedBuffer(orders);
+    benchmark_sink = buffer->get_size();
+  });
+  measure("serialize_to_compressed_chain", bytes, [&] {
+    turbokit::BufferChain chain;
+    turbokit::serializeToCompressedChain(chain, orders);
+    benchmark_sink = chain.size();
+  });
+  measure("decompress_buffer", bytes, [&] {
+    turbokit::BufferHandle buffer = turbokit::decompressBuffer(compressed_data);
+    benchmark_sink = buffer->get_size();
+  });
+
+  char stream_path[] = "/tmp/turbokit_bench_XXXXXX";
+  int stream_fd = mkstemp(stream_path);
+  unlink(stream_path);
+  measure("serialize_to_fd", bytes, [&] {
+    ftruncate(stream_fd, 0);
+    lseek(stream_fd, 0, SEEK_SET);
+    turbokit::serializeToFd(stream_fd, orders);
+    benchmark_sink = lseek(stream_fd, 0, SEEK_CUR);
+  });
+  measure("deserialize_from_fd", bytes, [&] {
+    std::vector<Order> decoded;
+    lseek(stream_fd, 0, SEEK_SET);
+    turbokit::deserializeFromFd(stream_fd, decoded);
+    benchmark_sink = decoded.size();
+  });
+  close(stream_fd);
+
+  std::vector<std::byte> flat;
+  turbokit::flatSerializeTo(flat, orders);
+  std::string_view flat_data((const char *)flat.data(), flat.size());
+  std::printf("flat format: %zu bytes\n", flat.size());
+  measure("flat_serialize_to", flat.size(), [&] {
+    turbokit::flatSerializeTo(output, orders);
+    benchmark_sink = output.size();
+  });
+  measure("flat_root + 1000 random lookups", flat.size(), [&] {
+    auto root = turbokit::flatRoot<std::vector<Order>>(flat_data);
+    size_t total = 0;
+    for (size_t i = 0; i != 1000; ++i) {
+      auto order = root[(i * 7919) % order_count];
+      total += order.field(&Order::symbol).size();
+      total += order.field(&Order::tags).contains("tag1");
+    }
+    benchmark_sink = total;
+  });
+
+  std::vector<float> samples(1 << 20);
+  for (size_t i = 0; i != samples.size(); ++i) {
+    samples[i] = (float)random() / 1e9f;
+  }
+  size_t sample_bytes = sizeof(float) * samples.size();
+  std::printf("%zu floats, %zu bytes\n", samples.size(), sample_bytes);
+  std::vector<std::byte> copy(sample_bytes);
+  measure("memcpy", sample_bytes, [&] {
+    std::memcpy(copy.data(), samples.data(), sample_bytes);
+    benchmark_sink = (size_t)copy[sample_bytes - 1];
+  });
+  measure("serialize_to_growable floats", sample_bytes, [&] {
+    turbokit::serializeToGrowable(output, samples);
+    benchmark_sink = output.size();
+  });
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "perf_counters.h"
+#include "timer_wheel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+volatile size_t benchmark_sink;
+
+constexpr size_t connection_count = 2000000;
+constexpr int64_t millisecond = 1000000;
+
+struct WheelConnection : turbokit::TimerNode {};
+
+struct MapConnection {
+  std::multimap<int64_t, MapConnection *>::iterator timeout;
+};
+
+template <typename Function>
+void measure(const char *name, Function &&function) {
+  turbokit::PerfStopwatch stopwatch;
+  stopwatch.start();
+  size_t operations = function();
+  stopwatch.stop();
+  std::printf("%-36s %8.2f ns/op", name,
+              (double)stopwatch.elapsed_nanoseconds() / operations);
+  if (stopwatch.is_available()) {
+    const auto &values = stopwatch.values();
+    std::printf("  %5.2f IPC %8.2f cache misses/op",
+                values.instructions_per_cycle(),
+                (double)values.cache_misses / operations);
+  }
+  std::printf("\n");
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 random(1);
+  std::vector<int64_t> timeouts(connection_count);
+  std::vector<int64_t> refreshed_timeouts(connection_count);
+  for (size_t i = 0; i != connection_count; ++i) {
+    timeouts[i] = (1 + random() % 30000) * millisecond;
+    refreshed_timeouts[i] = (1 + random() % 30000) * millisecond + 500;
+  }
+
+  std::printf("%zu timers, 1 ms resolution\n", connection_count);
+  {
+    turbokit::TimerWheel wheel(std::chrono::milliseconds(1), 0);
+    std::vector<WheelConnection> connections(connection_count);
+    measure("TimerWheel schedule", [&] {
+      for (size_t i = 0; i != connection_count; ++i) {
+        wheel.schedule(connections[i], timeouts[i]);
+      }
+      return connection_count;
+    });
+    measure("TimerWheel cancel + reschedule", [&] {
+      for (size_t i = 0; i != connection_count; ++i) {
+        wheel.cancel(connections[i]);
+        wheel.schedule(connections[i], refreshed_timeouts[i]);
+      }
+      return connection_count;
+    });
+    measure("TimerWheel expire (1 ms steps)", [&] {
+      size_t expired = 0;
+      for (int64_t now = 0; !wheel.empty(); now += millisecond) {
+        expired += wheel.advance(now, [](turbokit::TimerNode &) {});
+      }
+      benchmark_sink = expired;
+      return expired;
+    });
+  }
+  {
+    std::multimap<int64_t, MapConnection *> timers;
+    std::vector<MapConnection> connections(connection_count);
+    measure("std::multimap schedule", [&] {
+      for (size_t i = 0; i != connection_count; ++i) {
+        connections[i].timeout = timers.emplace(timeouts[i], &connections[i]);
+      }
+      return connection_count;
+    });
+    measure("std::multimap cancel + reschedule", [&] {
+      for (size_t i = 0; i != connection_count; ++i) {
+        timers.erase(connections[i].timeout);
+        connections[i].timeout =
+            timers.emplace(refreshed_timeouts[i], &connections[i]);
+      }
+      return connection_count;
+    });
+    measure("std::multimap expire (1 ms steps)", [&] {
+      size_t expired = 0;
+      for (int64_t now = 0; !timers.empty(); now += millisecond) {
+        auto end = timers.upper_bound(now);
+        for (auto it = timers.begin(); it != end; ++it) {
+          ++expired;
+        }
+        timers.erase(timers.begin(), end);
+      }
+      benchmark_sink = expired;
+      return expired;
+    });
+  }
+  return 0;
+}
@@ -1,17 +1,48 @@
 #pragma once
 
+#include "freelist.h"
 #include "vector.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace turbokit {
 
+enum class MemoryBlockAllocation : uint16_t {
+  ALLOCATE_HEAP,
+  ALLOCATE_MAPPED,
+  ALLOCATE_HUGEPAGES,
+  ALLOCATE_HUGETLB,
+  ALLOCATE_MAPPED_FILE,
+};
+
+constexpr auto ALLOCATE_HEAP = MemoryBlockAllocation::ALLOCATE_HEAP;
+constexpr auto ALLOCATE_MAPPED = MemoryBlockAllocation::ALLOCATE_MAPPED;
+constexpr auto ALLOCATE_HUGEPAGES = MemoryBlockAllocation::ALLOCATE_HUGEPAGES;
+constexpr auto ALLOCATE_HUGETLB = MemoryBlockAllocation::ALLOCATE_HUGETLB;
+constexpr auto ALLOCATE_MAPPED_FILE =
+    MemoryBlockAllocation::ALLOCATE_MAPPED_FILE;
+
 struct alignas(std::max_align_t) MemoryBlock {
   union {
     MemoryBlock *successor;
     size_t capacity;
   };
   std::atomic_uint32_t reference_count;
+  uint16_t size_class;
+  MemoryBlockAllocation allocation;
 
   std::byte *get_data() { return (std::byte *)(this + 1); }
 
@@ -22,21 +53,245 @@ struct alignas(std::max_align_t) MemoryBlock {
   MemoryBlock() = delete;
   ~MemoryBlock() = delete;
 
-  static MemoryBlock *create(size_t bytes_needed) {
-    MemoryBlock *result =
-        (MemoryBlock *)std::malloc(sizeof(MemoryBlock) + bytes_needed);
-    if (!result) {
-      throw std::bad_alloc();
+  static MemoryBlock *create(size_t bytes_needed);
+
+  static MemoryBlock *create(size_t bytes_needed,
+                             MemoryBlockAllocation allocation);
+
+  static MemoryBlock *map_file(const std::string &path, bool writable = false);
+
+  static void destroy(MemoryBlock *block);
+};
+
+template <> struct FreeListLink<MemoryBlock> {
+  static MemoryBlock *&get(MemoryBlock *block) { return block->successor; }
+};
+
+template <size_t SizeClass> struct MemoryBlockSizeClassTag {};
+
+template <size_t SizeClass>
+using MemoryBlockPool =
+    FreeList<MemoryBlock, MemoryBlockSizeClassTag<SizeClass>>;
+
+struct MemoryBlockSizeClasses {
+  static constexpr size_t minimum_shift = 6;
+  static constexpr size_t count = 11;
+  static constexpr size_t maximum_size = size_t(1)
+                                         << (minimum_shift + count - 1);
+  static constexpr size_t cached_bytes_per_class = 256 * 1024;
+
+  static size_t index_of(size_t bytes) {
+    if (bytes <= (size_t(1) << minimum_shift)) {
+      return 0;
+    }
+    return 64 - __builtin_clzll(bytes - 1) - minimum_shift;
+  }
+
+  static size_t size_of(size_t index) {
+    return size_t(1) << (minimum_shift + index);
+  }
+
+  static size_t max_cached_blocks(size_t index) {
+    return std::max<size_t>(cached_bytes_per_class / size_of(index), 8);
+  }
+
+  template <size_t... Indices>
+  static MemoryBlock *acquire(size_t index, std::index_sequence<Indices...>) {
+    static constexpr MemoryBlock *(*acquire_functions[])() = {
+        &MemoryBlockPool<Indices>::remove_element...};
+    return acquire_functions[index]();
+  }
+
+  template <size_t... Indices>
+  static void release(MemoryBlock *block, size_t index,
+                      std::index_sequence<Indices...>) {
+    static constexpr void (*release_functions[])(MemoryBlock *, size_t) = {
+        &MemoryBlockPool<Indices>::add_element...};
+    release_functions[index](block, max_cached_blocks(index));
+  }
+};
+
+struct MemoryBlockMapping {
+  // Default x86-64 huge page size; MAP_HUGETLB uses the kernel default pool.
+  static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+  static size_t page_size() {
+    static const size_t size = ::sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  static size_t granularity(MemoryBlockAllocation allocation) {
+    return allocation == ALLOCATE_HUGETLB ? huge_page_size : page_size();
+  }
+
+  // Mapped files keep the header at the end of a leading anonymous page so
+  // that the file contents start page aligned right after it.
+  static size_t header_size(MemoryBlockAllocation allocation) {
+    return allocation == ALLOCATE_MAPPED_FILE ? page_size()
+                                              : sizeof(MemoryBlock);
+  }
+
+  static size_t round_up(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+  }
+
+  static size_t mapping_size(MemoryBlockAllocation allocation,
+                             size_t capacity) {
+    return round_up(header_size(allocation) + capacity,
+                    granularity(allocation));
+  }
+
+  static std::byte *mapping_base(MemoryBlock *block) {
+    return block->get_data() - header_size(block->allocation);
+  }
+
+  [[noreturn]] static void fail(const char *operation, int error) {
+    throw std::runtime_error(std::string("MemoryBlock: ") + operation +
+                             " failed: " + std::strerror(error));
+  }
+
+  static void *map_anonymous(size_t length, int flags) {
+    void *result = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (result == MAP_FAILED) {
+      fail("mmap", errno);
     }
-    result->capacity = bytes_needed;
-    result->reference_count.store(0, std::memory_order_relaxed);
     return result;
   }
 
-  static void destroy(MemoryBlock *block) { std::free((std::byte *)block); }
+  // Transparent huge pages only back naturally aligned 2 MiB ranges, so
+  // over-reserve and trim the mapping down to an aligned start.
+  static std::byte *map_hugepages(size_t length) {
+    std::byte *reserved =
+        (std::byte *)map_anonymous(length + huge_page_size, 0);
+    std::byte *aligned =
+        (std::byte *)round_up((uintptr_t)reserved, huge_page_size);
+    if (aligned != reserved) {
+      ::munmap(reserved, aligned - reserved);
+    }
+    size_t tail = (reserved + length + huge_page_size) - (aligned + length);
+    if (tail) {
+      ::munmap(aligned + length, tail);
+    }
+    ::madvise(aligned, length, MADV_HUGEPAGE);
+    return aligned;
+  }
 };
 
+inline MemoryBlock *MemoryBlock::create(size_t bytes_needed,
+                                        MemoryBlockAllocation allocation) {
+  if (allocation == ALLOCATE_HEAP) {
+    return create(bytes_needed);
+  }
+  if (allocation == ALLOCATE_MAPPED_FILE) {
+    throw std::invalid_argument("MemoryBlock: use map_file for file mappings");
+  }
+  size_t length = MemoryBlockMapping::mapping_size(allocation, bytes_needed);
+  std::byte *base = nullptr;
+  if (allocation == ALLOCATE_HUGEPAGES) {
+    base = MemoryBlockMapping::map_hugepages(length);
+  } else {
+    base = (std::byte *)MemoryBlockMapping::map_anonymous(
+        length, allocation == ALLOCATE_HUGETLB ? MAP_HUGETLB : 0);
+  }
+  MemoryBlock *result = (MemoryBlock *)base;
+  result->capacity = bytes_needed;
+  result->reference_count.store(0, std::memory_order_relaxed);
+  result->size_class = 0;
+  result->allocation = allocation;
+  return result;
+}
+
+inline MemoryBlock *MemoryBlock::map_file(const std::string &path,
+                                          bool writable) {
+  int fd = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0) {
+    MemoryBlockMapping::fail("open", errno);
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    int error = errno;
+    ::close(fd);
+    MemoryBlockMapping::fail("fstat", error);
+  }
+  size_t file_size = status.st_size;
+  size_t header_size = MemoryBlockMapping::header_size(ALLOCATE_MAPPED_FILE);
+  size_t length =
+      MemoryBlockMapping::mapping_size(ALLOCATE_MAPPED_FILE, file_size);
+  std::byte *base = nullptr;
+  try {
+    base = (std::byte *)MemoryBlockMapping::map_anonymous(length, 0);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  if (file_size) {
+    // Private mappings are copy-on-write, so in-place decoding that touches
+    // the bytes never writes back to the file unless asked to.
+    void *mapped = ::mmap(base + header_size, file_size, PROT_READ | PROT_WRITE,
+                          (writable ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED, fd,
+                          0);
+    if (mapped == MAP_FAILED) {
+      int error = errno;
+      ::munmap(base, length);
+      ::close(fd);
+      MemoryBlockMapping::fail("mmap", error);
+    }
+  }
+  ::close(fd);
+  MemoryBlock *result = (MemoryBlock *)(base + header_size) - 1;
+  result->capacity = file_size;
+  result->reference_count.store(0, std::memory_order_relaxed);
+  result->size_class = 0;
+  result->allocation = ALLOCATE_MAPPED_FILE;
+  return result;
+}
+
+inline MemoryBlock *MemoryBlock::create(size_t bytes_needed) {
+  MemoryBlock *result = nullptr;
+  uint16_t block_size_class = 0;
+  if (bytes_needed <= MemoryBlockSizeClasses::maximum_size) {
+    [[likely]];
+    size_t index = MemoryBlockSizeClasses::index_of(bytes_needed);
+    block_size_class = index + 1;
+    result = MemoryBlockSizeClasses::acquire(
+        index, std::make_index_sequence<MemoryBlockSizeClasses::count>());
+    if (!result) {
+      result = (MemoryBlock *)std::malloc(
+          sizeof(MemoryBlock) + MemoryBlockSizeClasses::size_of(index));
+    }
+  } else {
+    result = (MemoryBlock *)std::malloc(sizeof(MemoryBlock) + bytes_needed);
+  }
+  if (!result) {
+    throw std::bad_alloc();
+  }
+  result->capacity = bytes_needed;
+  result->reference_count.store(0, std::memory_order_relaxed);
+  result->size_class = block_size_class;
+  result->allocation = ALLOCATE_HEAP;
+  return result;
+}
+
+inline void MemoryBlock::destroy(MemoryBlock *block) {
+  if (block->size_class) {
+    [[likely]];
+    MemoryBlockSizeClasses::release(
+        block, block->size_class - 1,
+        std::make_index_sequence<MemoryBlockSizeClasses::count>());
+    return;
+  }
+  if (block->allocation != ALLOCATE_HEAP) {
+    ::munmap(MemoryBlockMapping::mapping_base(block),
+             MemoryBlockMapping::mapping_size(block->allocation,
+                                              block->capacity));
+    return;
+  }
+  std::free((std::byte *)block);
+}
+
 static_assert(std::is_trivial_v<MemoryBlock>);
+static_assert(sizeof(MemoryBlock) == 16);
 
 class UniqueMemoryBlock {
 private:
@@ -59,7 +314,12 @@ public:
   }
 
   UniqueMemoryBlock &operator=(UniqueMemoryBlock &&other) noexcept {
-    std::swap(block_ptr, other.block_ptr);
+    if (this != &other) {
+      if (block_ptr) {
+        MemoryBlock::destroy(block_ptr);
+      }
+      block_ptr = std::exchange(other.block_ptr, nullptr);
+    }
     return *this;
   }
 
@@ -110,10 +370,8 @@ public:
   }
 
   SharedMemoryBlock &operator=(const SharedMemoryBlock &other) noexcept {
-    block_ptr = other.block_ptr;
-    if (block_ptr) {
-      increment_reference();
-    }
+    SharedMemoryBlock copy(other);
+    std::swap(block_ptr, copy.block_ptr);
     return *this;
   }
 
@@ -157,10 +415,109 @@ public:
   void take_ownership(MemoryBlock *block) noexcept { block_ptr = block; }
 };
 
+class BufferSlice {
+private:
+  SharedMemoryBlock block;
+  size_t offset = 0;
+  size_t length = 0;
+
+  static SharedMemoryBlock share(UniqueMemoryBlock &&block) {
+    return SharedMemoryBlock(block.relinquish());
+  }
+
+  void check_range(size_t slice_offset, size_t slice_length) const {
+    if (slice_offset > length || slice_length > length - slice_offset) {
+      throw std::out_of_range("BufferSlice: range exceeds slice size");
+    }
+  }
+
+public:
+  BufferSlice() = default;
+
+  explicit BufferSlice(SharedMemoryBlock block) noexcept
+      : block(std::move(block)),
+        length(this->block ? this->block->get_size() : 0) {}
+
+  explicit BufferSlice(UniqueMemoryBlock &&block)
+      : BufferSlice(share(std::move(block))) {}
+
+  BufferSlice(SharedMemoryBlock block, size_t offset, size_t length)
+      : block(std::move(block)), offset(offset), length(length) {
+    size_t block_size = this->block ? this->block->get_size() : 0;
+    if (offset > block_size || length > block_size - offset) {
+      throw std::out_of_range("BufferSlice: range exceeds block size");
+    }
+  }
+
+  explicit operator bool() const noexcept { return (bool)block; }
+
+  std::byte *get_data() const noexcept {
+    return block ? block->get_data() + offset : nullptr;
+  }
+
+  size_t get_size() const noexcept { return length; }
+
+  bool empty() const noexcept { return length == 0; }
+
+  std::string_view view() const noexcept {
+    return {(const char *)get_data(), length};
+  }
+
+  const SharedMemoryBlock &get_block() const noexcept { return block; }
+
+  size_t get_offset() const noexcept { return offset; }
+
+  BufferSlice slice(size_t slice_offset, size_t slice_length) const & {
+    check_range(slice_offset, slice_length);
+    BufferSlice result;
+    result.block = block;
+    result.offset = offset + slice_offset;
+    result.length = slice_length;
+    return result;
+  }
+
+  BufferSlice slice(size_t slice_offset, size_t slice_length) && {
+    check_range(slice_offset, slice_length);
+    offset += slice_offset;
+    length = slice_length;
+    return std::move(*this);
+  }
+
+  BufferSlice slice(size_t slice_offset) const & {
+    return slice(slice_offset, length - std::min(slice_offset, length));
+  }
+
+  BufferSlice slice(size_t slice_offset) && {
+    size_t remaining = length - std::min(slice_offset, length);
+    return std::move(*this).slice(slice_offset, remaining);
+  }
+
+  void remove_prefix(size_t count) {
+    check_range(count, 0);
+    offset += count;
+    length -= count;
+  }
+
+  void remove_suffix(size_t count) {
+    check_range(0, count);
+    length -= count;
+  }
+};
+
 inline UniqueMemoryBlock createMemoryBlock(size_t bytes_needed) {
   return UniqueMemoryBlock(MemoryBlock::create(bytes_needed));
 }
 
+inline UniqueMemoryBlock createMemoryBlock(size_t bytes_needed,
+                                           MemoryBlockAllocation allocation) {
+  return UniqueMemoryBlock(MemoryBlock::create(bytes_needed, allocation));
+}
+
+inline UniqueMemoryBlock mapMemoryBlock(const std::string &path,
+                                        bool writable = false) {
+  return UniqueMemoryBlock(MemoryBlock::map_file(path, writable));
+}
+
 using Buffer = MemoryBlock;
 using BufferHandle = UniqueMemoryBlock;
 using SharedBufferHandle = SharedMemoryBlock;
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "buffer.h"
+#include "freelist.h"
+#include "intrusive_list.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace turbokit {
+
+struct BufferChainSegment {
+  IntrusiveListLink<BufferChainSegment> link;
+  BufferSlice slice;
+  bool is_writable = false;
+};
+
+template <> struct FreeListLink<BufferChainSegment> {
+  static BufferChainSegment *&get(BufferChainSegment *segment) {
+    return segment->link.successor;
+  }
+};
+
+class BufferChain {
+private:
+  using SegmentList =
+      IntrusiveList<BufferChainSegment, &BufferChainSegment::link>;
+  using SegmentPool = FreeList<BufferChainSegment>;
+
+  static constexpr size_t max_pooled_segments = 256;
+
+  SegmentList segments;
+  size_t total_size = 0;
+  size_t count = 0;
+
+  static BufferChainSegment *allocate_segment(BufferSlice &&slice,
+                                              bool is_writable) {
+    BufferChainSegment *segment = SegmentPool::remove_element();
+    if (!segment) {
+      segment = new BufferChainSegment();
+    }
+    segment->slice = std::move(slice);
+    segment->is_writable = is_writable;
+    return segment;
+  }
+
+  static void release_segment(BufferChainSegment *segment) {
+    segment->slice = BufferSlice();
+    segment->is_writable = false;
+    SegmentPool::add_element(segment, max_pooled_segments);
+  }
+
+  size_t tail_space() {
+    if (segments.empty()) {
+      return 0;
+    }
+    BufferChainSegment &tail = segments.back();
+    if (!tail.is_writable) {
+      return 0;
+    }
+    const BufferSlice &slice = tail.slice;
+    return slice.get_block()->get_size() - slice.get_offset() -
+           slice.get_size();
+  }
+
+public:
+  static constexpr size_t default_segment_size = 4096;
+
+  BufferChain() = default;
+
+  BufferChain(const BufferChain &) = delete;
+  BufferChain &operator=(const BufferChain &) = delete;
+
+  BufferChain(BufferChain &&other) noexcept
+      : segments(std::move(other.segments)),
+        total_size(std::exchange(other.total_size, 0)),
+        count(std::exchange(other.count, 0)) {}
+
+  BufferChain &operator=(BufferChain &&other) noexcept {
+    if (this != &other) {
+      clear();
+      segments = std::move(other.segments);
+      total_size = std::exchange(other.total_size, 0);
+      count = std::exchange(other.count, 0);
+    }
+    return *this;
+  }
+
+  ~BufferChain() { clear(); }
+
+  size_t size() const noexcept { return total_size; }
+  size_t segment_count() const noexcept { return count; }
+  bool empty() const noexcept { return total_size == 0; }
+
+  void clear() {
+    while (!segments.empty()) {
+      BufferChainSegment &segment = segments.front();
+      segments.pop_front();
+      release_segment(&segment);
+    }
+    total_size = 0;
+    count = 0;
+  }
+
+  void append(BufferSlice slice) {
+    if (slice.empty()) {
+      return;
+    }
+    total_size += slice.get_size();
+    ++count;
+    segments.push_back(*allocate_segment(std::move(slice), false));
+  }
+
+  void prepend(BufferSlice slice) {
+    if (slice.empty()) {
+      return;
+    }
+    total_size += slice.get_size();
+    ++count;
+    segments.push_front(*allocate_segment(std::move(slice), false));
+  }
+
+  void append(BufferChain &&other) {
+    while (!other.segments.empty()) {
+      BufferChainSegment &segment = other.segments.front();
+      other.segments.pop_front();
+      segments.push_back(segment);
+    }
+    total_size += std::exchange(other.total_size, 0);
+    count += std::exchange(other.count, 0);
+  }
+
+  std::pair<std::byte *, size_t> reserve_tail(size_t minimum_bytes) {
+    size_t space = tail_space();
+    if (space < std::max<size_t>(minimum_bytes, 1)) {
+      size_t block_size = std::max(minimum_bytes, default_segment_size);
+      BufferSlice slice =
+          BufferSlice(createMemoryBlock(block_size)).slice(0, 0);
+      ++count;
+      segments.push_back(*allocate_segment(std::move(slice), true));
+      space = block_size;
+    }
+    const BufferSlice &tail = segments.back().slice;
+    return {tail.get_data() + tail.get_size(), space};
+  }
+
+  void commit_tail(size_t bytes) {
+    if (!bytes) {
+      return;
+    }
+    if (bytes > tail_space()) {
+      throw std::out_of_range("BufferChain: commit exceeds reserved space");
+    }
+    BufferSlice &tail = segments.back().slice;
+    tail = BufferSlice(tail.get_block(), tail.get_offset(),
+                       tail.get_size() + bytes);
+    total_size += bytes;
+  }
+
+  void write(const void *data, size_t length) {
+    const std::byte *source = (const std::byte *)data;
+    while (length) {
+      auto [destination, space] = reserve_tail(1);
+      size_t chunk = std::min(space, length);
+      std::memcpy(destination, source, chunk);
+      commit_tail(chunk);
+      source += chunk;
+      length -= chunk;
+    }
+  }
+
+  template <typename... Types> void append_serialized(const Types &...values);
+
+  void consume(size_t bytes) {
+    bytes = std::min(bytes, total_size);
+    total_size -= bytes;
+    while (bytes) {
+      BufferChainSegment &segment = segments.front();
+      size_t segment_size = segment.slice.get_size();
+      if (bytes < segment_size) {
+        segment.slice.remove_prefix(bytes);
+        return;
+      }
+      bytes -= segment_size;
+      segments.pop_front();
+      --count;
+      release_segment(&segment);
+    }
+  }
+
+  size_t export_iovecs(iovec *vectors, size_t max_count) const {
+    size_t exported = 0;
+    auto &list = const_cast<SegmentList &>(segments);
+    for (auto it = list.begin(); it != list.end() && exported != max_count;
+         ++it) {
+      if (it->slice.empty()) {
+        continue;
+      }
+      vectors[exported].iov_base = it->slice.get_data();
+      vectors[exported].iov_len = it->slice.get_size();
+      ++exported;
+    }
+    return exported;
+  }
+
+  template <typename Function> void for_each_slice(Function &&function) const {
+    auto &list = const_cast<SegmentList &>(segments);
+    for (auto &segment : list) {
+      if (!segment.slice.empty()) {
+        function(segment.slice);
+      }
+    }
+  }
+
+  ssize_t write_to(int fd) {
+    constexpr size_t max_vectors = std::min<size_t>(IOV_MAX, 64);
+    iovec vectors[max_vectors];
+    ssize_t total_written = 0;
+    while (!empty()) {
+      size_t vector_count = export_iovecs(vectors, max_vectors);
+      size_t requested = 0;
+      for (size_t i = 0; i != vector_count; ++i) {
+        requested += vectors[i].iov_len;
+      }
+      ssize_t written = ::writev(fd, vectors, vector_count);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return total_written ? total_written : -1;
+      }
+      consume(written);
+      total_written += written;
+      if ((size_t)written < requested) {
+        break;
+      }
+    }
+    return total_written;
+  }
+
+  void copy_to(void *destination) const {
+    std::byte *output = (std::byte *)destination;
+    for_each_slice([&](const BufferSlice &slice) {
+      std::memcpy(output, slice.get_data(), slice.get_size());
+      output += slice.get_size();
+    });
+  }
+
+  std::string to_string() const {
+    std::string result(total_size, '\0');
+    copy_to(result.data());
+    return result;
+  }
+};
+
+struct BufferChainSerializeSink {
+  BufferChain &chain;
+  size_t initial_size = chain.size();
+  std::byte *segment_start = nullptr;
+  std::vector<std::pair<size_t, std::byte *>> segment_positions = {};
+
+  void grow(std::byte *&current, std::byte *&end, size_t needed) {
+    finish(current);
+    auto [data, space] = chain.reserve_tail(needed);
+    segment_positions.emplace_back(chain.size() - initial_size, data);
+    segment_start = current = data;
+    end = data + space;
+  }
+
+  // Segments never move once reserved, so a position maps to the segment
+  // that was being filled when it was written. A patch that straddles a
+  // segment end continues at the start of the next segment.
+  void patch(std::byte *, size_t position, const void *source,
+             size_t length) {
+    auto segment = std::upper_bound(
+        segment_positions.begin(), segment_positions.end(), position,
+        [](size_t value, const auto &entry) { return value < entry.first; });
+    --segment;
+    const std::byte *input = (const std::byte *)source;
+    while (length) {
+      auto next = std::next(segment);
+      size_t step = next == segment_positions.end()
+                        ? length
+                        : std::min(length, next->first - position);
+      std::memcpy(segment->second + (position - segment->first), input, step);
+      input += step;
+      position += step;
+      length -= step;
+      segment = next;
+    }
+  }
+
+  void finish(std::byte *current) {
+    chain.commit_tail(current - segment_start);
+    segment_start = current;
+  }
+
+  size_t tell(const std::byte *current) {
+    return chain.size() - initial_size + (current - segment_start);
+  }
+};
+
+template <typename... Types>
+void BufferChain::append_serialized(const Types &...values) {
+  BufferChainSerializeSink sink{*this};
+  GrowableSerializeContext<BufferChainSerializeSink> context{sink};
+  (context(values), ...);
+  sink.finish(context.current);
+}
+
+} // namespace turbokit
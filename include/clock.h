@@ -3,49 +3,194 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
 
+#include <cpuid.h>
+#include <time.h>
 #include <x86intrin.h>
 
-#if defined(__has_feature)
-#if __has_feature(thread_sanitizer)
-#define IS_USING_TSAN
-#endif
-#endif
-
 namespace turbokit {
 
-inline struct Clock {
+struct alignas(64) ClockCalibration {
+  std::atomic_uint64_t sequence = 0;
+  std::atomic_int64_t base_time = 0;
+  std::atomic_int64_t base_cycles = 0;
+  std::atomic_uint64_t cycle_multiplier = 0;
   std::atomic_int64_t cycle_threshold = 0;
-  std::atomic_int64_t cycle_conversion_factor = 0;
-  unsigned __int128 previous_measurements = 0;
-  int64_t last_calibration_time = 0;
+  std::atomic_int64_t base_wall_time = 0;
+  std::atomic_uint64_t wall_cycle_multiplier = 0;
+};
+
+inline int64_t readTimespec(clockid_t clock_id) {
+  timespec time_spec;
+  clock_gettime(clock_id, &time_spec);
+  return (int64_t)time_spec.tv_sec * 1000000000 + time_spec.tv_nsec;
+}
+
+inline bool hasReliableTsc() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8))) {
+    return true;
+  }
+  char clocksource[32] = {};
+  if (FILE *file = std::fopen(
+          "/sys/devices/system/clocksource/clocksource0/current_clocksource",
+          "r")) {
+    if (!std::fgets(clocksource, sizeof(clocksource), file)) {
+      clocksource[0] = 0;
+    }
+    std::fclose(file);
+  }
+  return std::strncmp(clocksource, "tsc", 3) == 0;
+}
+
+inline uint64_t detectTscFrequency() {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  unsigned int max_leaf = __get_cpuid_max(0, nullptr);
+  if (max_leaf >= 0x15) {
+    __cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+    if (eax && ebx && ecx) {
+      return (uint64_t)ecx * ebx / eax;
+    }
+  }
+  __cpuid(1, eax, ebx, ecx, edx);
+  if (ecx & (1u << 31)) {
+    __cpuid(0x40000000, eax, ebx, ecx, edx);
+    if (eax >= 0x40000010) {
+      __cpuid(0x40000010, eax, ebx, ecx, edx);
+      if (eax) {
+        return (uint64_t)eax * 1000;
+      }
+    }
+  }
+  unsigned long long frequency_khz = 0;
+  if (FILE *file =
+          std::fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r")) {
+    if (std::fscanf(file, "%llu", &frequency_khz) != 1) {
+      frequency_khz = 0;
+    }
+    std::fclose(file);
+    if (frequency_khz) {
+      return frequency_khz * 1000;
+    }
+  }
+  if (max_leaf >= 0x16) {
+    __cpuid_count(0x16, 0, eax, ebx, ecx, edx);
+    if (eax) {
+      return (uint64_t)eax * 1000000;
+    }
+  }
+  return 0;
+}
+
+inline struct Clock {
+  static constexpr int cycle_shift = 32;
+  static constexpr int64_t calibration_interval = 1000000000;
+  static constexpr int64_t reset_interval = 100000000;
+  static constexpr int64_t wall_step_threshold = 1000000;
+  static constexpr int64_t wall_slew_ppm = 500;
+  ClockCalibration calibration;
+  alignas(64) int64_t last_calibration_time = 0;
   int64_t last_calibration_cycles = 0;
-  std::atomic_int64_t access_count = 0;
   std::atomic_bool synchronization_lock = false;
+  bool use_steady_clock = false;
+  // Cycle multiplier for raw-cycle conversions when no calibration is
+  // published (the steady clock fallback), measured once.
+  std::atomic_uint64_t measured_cycle_multiplier = 0;
+
+  Clock() noexcept {
+    if (!hasReliableTsc()) {
+      use_steady_clock = true;
+      return;
+    }
+    uint64_t frequency = detectTscFrequency();
+    if (!frequency) {
+      return;
+    }
+    int64_t current_time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    int64_t current_cycles = __rdtsc();
+    uint64_t multiplier =
+        (uint64_t)(((unsigned __int128)1000000000 << cycle_shift) / frequency);
+    last_calibration_time = current_time;
+    last_calibration_cycles = current_cycles;
+    publish_calibration(
+        current_time, current_cycles, multiplier,
+        (int64_t)(((unsigned __int128)reset_interval << cycle_shift) /
+                  multiplier));
+  }
+
+  void publish_calibration(int64_t base_time, int64_t base_cycles,
+                           uint64_t multiplier, int64_t threshold) {
+    int64_t real_time = readTimespec(CLOCK_REALTIME);
+    int64_t wall_offset = real_time - readTimespec(CLOCK_MONOTONIC);
+    real_time = base_time + wall_offset;
+    int64_t wall_time = real_time;
+    uint64_t wall_multiplier = multiplier;
+    uint64_t previous_wall_multiplier =
+        calibration.wall_cycle_multiplier.load(std::memory_order_relaxed);
+    int64_t previous_cycles =
+        calibration.base_cycles.load(std::memory_order_relaxed);
+    if (previous_wall_multiplier && base_cycles > previous_cycles) {
+      int64_t extrapolated_time =
+          calibration.base_wall_time.load(std::memory_order_relaxed) +
+          (int64_t)(((unsigned __int128)(base_cycles - previous_cycles) *
+                     previous_wall_multiplier) >>
+                    cycle_shift);
+      int64_t error = real_time - extrapolated_time;
+      if (error > -wall_step_threshold && error < wall_step_threshold) {
+        int64_t maximum_slew = reset_interval / 1000000 * wall_slew_ppm;
+        int64_t slew = std::clamp(error, -maximum_slew, maximum_slew);
+        wall_time = extrapolated_time;
+        wall_multiplier =
+            multiplier + (int64_t)((__int128)multiplier * slew / reset_interval);
+      }
+    }
+    uint64_t sequence = calibration.sequence.load(std::memory_order_relaxed);
+    calibration.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    calibration.base_time.store(base_time, std::memory_order_relaxed);
+    calibration.base_cycles.store(base_cycles, std::memory_order_relaxed);
+    calibration.cycle_multiplier.store(multiplier, std::memory_order_relaxed);
+    calibration.cycle_threshold.store(threshold, std::memory_order_relaxed);
+    calibration.base_wall_time.store(wall_time, std::memory_order_relaxed);
+    calibration.wall_cycle_multiplier.store(wall_multiplier,
+                                            std::memory_order_relaxed);
+    calibration.sequence.store(sequence + 2, std::memory_order_release);
+  }
 
   [[gnu::noinline]] int64_t perform_calibration(int64_t current_cycles) {
     int64_t current_time =
         std::chrono::duration_cast<std::chrono::nanoseconds>(
             std::chrono::steady_clock::now().time_since_epoch())
             .count();
-    if (synchronization_lock.exchange(true)) {
+    if (use_steady_clock ||
+        synchronization_lock.exchange(true, std::memory_order_acquire)) {
       return current_time;
     }
-    unsigned __int128 new_measurement =
-        ((unsigned __int128)current_time << 64) |
-        ((unsigned __int128)current_cycles);
-#ifdef IS_USING_TSAN
-    unsigned __int128 previous =
-        __sync_val_compare_and_swap_16(&previous_measurements, 0, 0);
-#else
-    unsigned __int128 previous = previous_measurements;
-#endif
-    __sync_val_compare_and_swap_16(&previous_measurements, previous,
-                                   new_measurement);
-    const int64_t calibration_interval = 1000000000;
-    const int64_t reset_interval = 100000000;
+    int64_t base_time = calibration.base_time.load(std::memory_order_relaxed);
+    int64_t base_cycles =
+        calibration.base_cycles.load(std::memory_order_relaxed);
+    uint64_t multiplier =
+        calibration.cycle_multiplier.load(std::memory_order_relaxed);
+    int64_t threshold =
+        calibration.cycle_threshold.load(std::memory_order_relaxed);
+    int64_t extrapolated_time = 0;
+    if (threshold > 0 && current_cycles > base_cycles) {
+      extrapolated_time =
+          base_time + (int64_t)(((unsigned __int128)(current_cycles -
+                                                      base_cycles) *
+                                 multiplier) >>
+                                cycle_shift);
+    }
     if (current_time - last_calibration_time >=
-        (cycle_threshold ? calibration_interval : calibration_interval / 10)) {
+        (threshold ? calibration_interval : calibration_interval / 10)) {
       int64_t previous_time = last_calibration_time;
       int64_t previous_cycles = last_calibration_cycles;
       last_calibration_time = current_time;
@@ -54,54 +199,146 @@ inline struct Clock {
         int64_t cycle_difference = current_cycles - previous_cycles;
         int64_t time_difference = current_time - previous_time;
         if (cycle_difference > 0 && time_difference > 0) {
-          uint64_t cycle_count = cycle_difference;
-          uint64_t time_count = time_difference;
-          uint64_t conversion_rate = (cycle_count << 16) / time_count;
-          if (cycle_count << 16 >> 16 == cycle_count) {
-            cycle_conversion_factor = conversion_rate;
-            cycle_threshold =
-                std::min(cycle_conversion_factor * reset_interval / 65536,
-                         std::numeric_limits<int64_t>::max() / 65536);
-          } else {
-            cycle_threshold = 0;
-          }
+          unsigned __int128 scaled_time = (unsigned __int128)time_difference
+                                          << cycle_shift;
+          multiplier = (uint64_t)std::min<unsigned __int128>(
+              scaled_time / (uint64_t)cycle_difference,
+              std::numeric_limits<uint64_t>::max());
+          threshold = multiplier ? (int64_t)std::min<unsigned __int128>(
+                                       ((unsigned __int128)reset_interval
+                                        << cycle_shift) /
+                                           multiplier,
+                                       std::numeric_limits<int64_t>::max())
+                                 : 0;
         }
       }
     }
+    if (threshold && extrapolated_time > current_time &&
+        extrapolated_time - current_time < reset_interval) {
+      current_time = extrapolated_time;
+    }
+    publish_calibration(current_time, current_cycles, multiplier, threshold);
     synchronization_lock.store(false, std::memory_order_release);
     return current_time;
   }
 
+  [[gnu::noinline]] uint64_t measure_cycle_multiplier() {
+    auto start_time = std::chrono::steady_clock::now();
+    int64_t start_cycles = __rdtsc();
+    auto end_time = start_time;
+    int64_t end_cycles = start_cycles;
+    while (end_time - start_time < std::chrono::milliseconds(10)) {
+      end_time = std::chrono::steady_clock::now();
+      end_cycles = __rdtsc();
+    }
+    int64_t time_difference =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                             start_time)
+            .count();
+    uint64_t multiplier = (uint64_t)(((unsigned __int128)time_difference
+                                      << cycle_shift) /
+                                     std::max<int64_t>(end_cycles -
+                                                           start_cycles,
+                                                       1));
+    if (!use_steady_clock && multiplier &&
+        !synchronization_lock.exchange(true, std::memory_order_acquire)) {
+      if (calibration.cycle_multiplier.load(std::memory_order_relaxed) == 0) {
+        int64_t current_time =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                end_time.time_since_epoch())
+                .count();
+        last_calibration_time = current_time;
+        last_calibration_cycles = end_cycles;
+        publish_calibration(
+            current_time, end_cycles, multiplier,
+            (int64_t)(((unsigned __int128)reset_interval << cycle_shift) /
+                      multiplier));
+      }
+      synchronization_lock.store(false, std::memory_order_release);
+    }
+    uint64_t expected = 0;
+    if (multiplier &&
+        !measured_cycle_multiplier.compare_exchange_strong(
+            expected, multiplier, std::memory_order_relaxed)) {
+      multiplier = expected;
+    }
+    return multiplier;
+  }
+
+  int64_t cycles_to_nanoseconds(int64_t cycles) {
+    uint64_t multiplier =
+        calibration.cycle_multiplier.load(std::memory_order_relaxed);
+    if (!multiplier) {
+      [[unlikely]];
+      multiplier = measured_cycle_multiplier.load(std::memory_order_relaxed);
+      if (!multiplier) {
+        multiplier = measure_cycle_multiplier();
+      }
+    }
+    return (int64_t)(((__int128)cycles * (__int128)multiplier) >> cycle_shift);
+  }
+
   int64_t get_current_time() {
-#ifdef IS_USING_TSAN
-    unsigned __int128 measurements =
-        __sync_val_compare_and_swap_16(&previous_measurements, 0, 0);
-    int64_t previous_time;
-    int64_t previous_cycles;
-    previous_cycles = measurements;
-    previous_time = measurements >> 64;
-#else
-    int64_t previous_time;
-    int64_t previous_cycles;
-    do {
-      previous_cycles = previous_measurements;
-      previous_time = previous_measurements >> 64;
-      __sync_synchronize();
-    } while ((int64_t)previous_measurements != previous_cycles);
-#endif
+    uint64_t sequence = calibration.sequence.load(std::memory_order_acquire);
+    int64_t base_time = calibration.base_time.load(std::memory_order_relaxed);
+    int64_t base_cycles =
+        calibration.base_cycles.load(std::memory_order_relaxed);
+    uint64_t multiplier =
+        calibration.cycle_multiplier.load(std::memory_order_relaxed);
+    uint64_t threshold =
+        calibration.cycle_threshold.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
     int64_t current_cycles = __rdtsc();
-    int64_t elapsed_cycles = current_cycles - previous_cycles;
-    auto threshold = cycle_threshold.load(std::memory_order_relaxed);
-    if (threshold > 0 && elapsed_cycles < threshold) {
+    uint64_t elapsed_cycles = current_cycles - base_cycles;
+    if (elapsed_cycles < threshold && (sequence & 1) == 0 &&
+        calibration.sequence.load(std::memory_order_relaxed) == sequence) {
       [[likely]];
-      return previous_time + ((uint64_t)std::max(elapsed_cycles, (int64_t)1) *
-                              (uint64_t)65536) /
-                                 (uint64_t)cycle_conversion_factor.load(
-                                     std::memory_order_relaxed);
+      return base_time + (int64_t)((elapsed_cycles * multiplier) >> cycle_shift);
     }
     [[unlikely]];
     return perform_calibration(current_cycles);
   }
+
+  bool try_read_wall_time(int64_t current_cycles, int64_t &wall_time) {
+    uint64_t sequence = calibration.sequence.load(std::memory_order_acquire);
+    int64_t base_wall_time =
+        calibration.base_wall_time.load(std::memory_order_relaxed);
+    int64_t base_cycles =
+        calibration.base_cycles.load(std::memory_order_relaxed);
+    uint64_t multiplier =
+        calibration.wall_cycle_multiplier.load(std::memory_order_relaxed);
+    uint64_t threshold =
+        calibration.cycle_threshold.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t elapsed_cycles = current_cycles - base_cycles;
+    if (elapsed_cycles < threshold && (sequence & 1) == 0 &&
+        calibration.sequence.load(std::memory_order_relaxed) == sequence) {
+      wall_time = base_wall_time +
+                  (int64_t)((elapsed_cycles * multiplier) >> cycle_shift);
+      return true;
+    }
+    return false;
+  }
+
+  [[gnu::noinline]] int64_t perform_wall_calibration(int64_t current_cycles) {
+    perform_calibration(current_cycles);
+    int64_t wall_time;
+    if (!use_steady_clock && try_read_wall_time(__rdtsc(), wall_time)) {
+      return wall_time;
+    }
+    return readTimespec(CLOCK_REALTIME);
+  }
+
+  int64_t get_wall_time() {
+    int64_t current_cycles = __rdtsc();
+    int64_t wall_time;
+    if (try_read_wall_time(current_cycles, wall_time)) {
+      [[likely]];
+      return wall_time;
+    }
+    [[unlikely]];
+    return perform_wall_calibration(current_cycles);
+  }
 } time_manager;
 
 struct HighPerformanceClock {
@@ -117,8 +354,36 @@ struct HighPerformanceClock {
   }
 };
 
+struct HighPerformanceSystemClock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<std::chrono::system_clock, duration>;
+  static constexpr bool is_steady = false;
+
+  static time_point now() noexcept {
+    return time_point(std::chrono::nanoseconds(time_manager.get_wall_time()));
+  }
+
+  static int64_t unix_nanoseconds() noexcept {
+    return time_manager.get_wall_time();
+  }
+
+  static std::time_t to_time_t(const time_point &time) noexcept {
+    return std::chrono::system_clock::to_time_t(
+        std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+            time));
+  }
+
+  static time_point from_time_t(std::time_t time) noexcept {
+    return std::chrono::time_point_cast<duration>(
+        std::chrono::system_clock::from_time_t(time));
+  }
+};
+
 using Clock = Clock;
 using FastClock = HighPerformanceClock;
+using FastSystemClock = HighPerformanceSystemClock;
 inline Clock &clock = time_manager;
 
 } // namespace turbokit
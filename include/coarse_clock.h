@@ -0,0 +1,149 @@
+#pragma once
+
+#include "clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace turbokit {
+
+class CoarseClock {
+  struct alignas(64) CachedTime {
+    std::atomic_int64_t value = 0;
+  };
+
+  CachedTime monotonic_time;
+  CachedTime wall_time;
+
+  // Set for clocks that start their ticker on the first read, so a cached
+  // value can never silently stay at construction time.
+  std::atomic_bool start_pending = false;
+
+  alignas(64) std::mutex ticker_mutex;
+  std::condition_variable ticker_condition;
+  std::thread ticker;
+  bool stop_requested = false;
+
+  void run(std::chrono::nanoseconds interval) {
+    std::unique_lock lock(ticker_mutex);
+    while (!stop_requested) {
+      update();
+      ticker_condition.wait_for(lock, interval);
+    }
+  }
+
+  [[gnu::noinline, gnu::cold]] void start_on_first_read() noexcept {
+    if (!start_pending.exchange(false)) {
+      return;
+    }
+    try {
+      start();
+    } catch (const std::system_error &error) {
+      std::fprintf(stderr,
+                   "CoarseClock: failed to start the ticker (%s); values "
+                   "are only refreshed by update()\n",
+                   error.what());
+      update();
+    }
+  }
+
+  void ensure_started() noexcept {
+    if (start_pending.load(std::memory_order_relaxed)) {
+      [[unlikely]];
+      start_on_first_read();
+    }
+  }
+
+public:
+  struct StartOnFirstRead {};
+
+  CoarseClock() { update(); }
+  explicit CoarseClock(StartOnFirstRead) : start_pending(true) { update(); }
+  ~CoarseClock() { stop(); }
+
+  CoarseClock(const CoarseClock &) = delete;
+  CoarseClock &operator=(const CoarseClock &) = delete;
+
+  int64_t now() noexcept {
+    ensure_started();
+    return monotonic_time.value.load(std::memory_order_relaxed);
+  }
+
+  int64_t wall_now() noexcept {
+    ensure_started();
+    return wall_time.value.load(std::memory_order_relaxed);
+  }
+
+  void update() {
+    monotonic_time.value.store(time_manager.get_current_time(),
+                               std::memory_order_relaxed);
+    wall_time.value.store(time_manager.get_wall_time(),
+                          std::memory_order_relaxed);
+  }
+
+  void start(std::chrono::nanoseconds interval = std::chrono::milliseconds(1)) {
+    start_pending.store(false, std::memory_order_relaxed);
+    std::lock_guard lock(ticker_mutex);
+    if (ticker.joinable()) {
+      return;
+    }
+    stop_requested = false;
+    update();
+    ticker = std::thread([this, interval] { run(interval); });
+  }
+
+  void stop() {
+    start_pending.store(false, std::memory_order_relaxed);
+    std::thread finished_ticker;
+    {
+      std::lock_guard lock(ticker_mutex);
+      stop_requested = true;
+      finished_ticker = std::move(ticker);
+    }
+    ticker_condition.notify_all();
+    if (finished_ticker.joinable()) {
+      finished_ticker.join();
+    }
+  }
+
+  bool is_running() {
+    std::lock_guard lock(ticker_mutex);
+    return ticker.joinable();
+  }
+};
+
+// Starts its 1 ms ticker on the first read unless start() or stop() was
+// called before.
+inline CoarseClock coarse_clock{CoarseClock::StartOnFirstRead{}};
+
+struct CoarseMonotonicClock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = HighPerformanceClock::time_point;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept {
+    return time_point(std::chrono::nanoseconds(coarse_clock.now()));
+  }
+};
+
+struct CoarseSystemClock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<std::chrono::system_clock, duration>;
+  static constexpr bool is_steady = false;
+
+  static time_point now() noexcept {
+    return time_point(std::chrono::nanoseconds(coarse_clock.wall_now()));
+  }
+};
+
+} // namespace turbokit
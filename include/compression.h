@@ -0,0 +1,484 @@
+#pragma once
+
+#include "buffer.h"
+#include "buffer_chain.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace turbokit {
+
+// LZ77 block codec in the style of LZ4: a stream of sequences, each a token
+// (literal count in the high nibble, match length - 4 in the low nibble,
+// 15 meaning "continued in 255-terminated extension bytes"), the literals,
+// then a 16-bit little-endian match offset. The final sequence carries
+// literals only. Tuned for speed on repetitive data rather than ratio.
+struct LzCodec {
+  static constexpr size_t min_match = 4;
+  static constexpr size_t max_offset = 65535;
+  static constexpr size_t hash_bits = 12;
+  // Matches never start in the last 12 bytes and never cover the last 5,
+  // which keeps the compressor's 8-byte loads in bounds.
+  static constexpr size_t match_start_margin = 12;
+  static constexpr size_t literal_tail = 5;
+
+  static uint32_t load32(const uint8_t *pointer) {
+    uint32_t value;
+    std::memcpy(&value, pointer, sizeof(value));
+    return value;
+  }
+  static uint64_t load64(const uint8_t *pointer) {
+    uint64_t value;
+    std::memcpy(&value, pointer, sizeof(value));
+    return value;
+  }
+  static uint32_t hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - hash_bits);
+  }
+
+  static size_t common_length(const uint8_t *left, const uint8_t *right,
+                              const uint8_t *limit) {
+    const uint8_t *start = left;
+    while (left + 8 <= limit) {
+      uint64_t difference = load64(left) ^ load64(right);
+      if (difference) {
+        if constexpr (host_is_little_endian) {
+          return left - start + __builtin_ctzll(difference) / 8;
+        } else {
+          return left - start + __builtin_clzll(difference) / 8;
+        }
+      }
+      left += 8;
+      right += 8;
+    }
+    while (left < limit && *left == *right) {
+      ++left;
+      ++right;
+    }
+    return left - start;
+  }
+
+  static uint8_t *write_length(uint8_t *output, size_t length) {
+    for (; length >= 255; length -= 255) {
+      *output++ = 255;
+    }
+    *output++ = (uint8_t)length;
+    return output;
+  }
+
+  static uint8_t *write_sequence(uint8_t *output, const uint8_t *literals,
+                                 size_t literal_count, size_t offset,
+                                 size_t match_length) {
+    uint8_t *token = output++;
+    if (literal_count >= 15) {
+      *token = 15 << 4;
+      output = write_length(output, literal_count - 15);
+    } else {
+      *token = (uint8_t)(literal_count << 4);
+    }
+    std::memcpy(output, literals, literal_count);
+    output += literal_count;
+    if (!match_length) {
+      return output;
+    }
+    *output++ = (uint8_t)offset;
+    *output++ = (uint8_t)(offset >> 8);
+    match_length -= min_match;
+    if (match_length >= 15) {
+      *token |= 15;
+      output = write_length(output, match_length - 15);
+    } else {
+      *token |= (uint8_t)match_length;
+    }
+    return output;
+  }
+
+  static size_t bound(size_t length) { return length + length / 255 + 16; }
+
+  // No input byte expands to more than 255 output bytes: literals copy one
+  // byte, a token and offset produce at most 19, and each length byte 255.
+  static constexpr size_t max_expansion = 255;
+
+  // Compresses into destination, which must hold bound(length) bytes.
+  static size_t compress(const void *source, size_t length,
+                         void *destination) {
+    const uint8_t *input = (const uint8_t *)source;
+    const uint8_t *end = input + length;
+    const uint8_t *anchor = input;
+    uint8_t *output = (uint8_t *)destination;
+    if (length > match_start_margin) {
+      uint32_t table[size_t(1) << hash_bits] = {};
+      const uint8_t *scan_limit = end - match_start_margin;
+      const uint8_t *match_limit = end - literal_tail;
+      const uint8_t *position = input + 1;
+      while (position < scan_limit) {
+        uint32_t sequence = load32(position);
+        uint32_t &entry = table[hash(sequence)];
+        const uint8_t *candidate = input + entry;
+        entry = (uint32_t)(position - input);
+        if (candidate >= position ||
+            (size_t)(position - candidate) > max_offset ||
+            load32(candidate) != sequence) {
+          position += 1 + ((position - anchor) >> 6);
+          continue;
+        }
+        while (position > anchor && candidate > input &&
+               position[-1] == candidate[-1]) {
+          --position;
+          --candidate;
+        }
+        size_t match_length =
+            min_match + common_length(position + min_match,
+                                      candidate + min_match, match_limit);
+        output = write_sequence(output, anchor, position - anchor,
+                                position - candidate, match_length);
+        position += match_length;
+        anchor = position;
+        if (position < scan_limit) {
+          table[hash(load32(position - 2))] =
+              (uint32_t)(position - 2 - input);
+        }
+      }
+    }
+    output = write_sequence(output, anchor, end - anchor, 0, 0);
+    return output - (uint8_t *)destination;
+  }
+
+  static size_t read_length(const uint8_t *&input, const uint8_t *end) {
+    size_t length = 0;
+    uint8_t byte;
+    do {
+      if (input == end) {
+        throw DataFormatError("LzCodec: truncated length");
+      }
+      byte = *input++;
+      length += byte;
+    } while (byte == 255);
+    return length;
+  }
+
+  // Decompresses into destination and returns the number of bytes produced;
+  // malformed input throws instead of reading or writing out of bounds.
+  static size_t decompress(const void *source, size_t length,
+                           void *destination, size_t capacity) {
+    const uint8_t *input = (const uint8_t *)source;
+    const uint8_t *input_end = input + length;
+    uint8_t *output_start = (uint8_t *)destination;
+    uint8_t *output = output_start;
+    uint8_t *output_end = output_start + capacity;
+    while (input != input_end) {
+      uint8_t token = *input++;
+      size_t literal_count = token >> 4;
+      if (literal_count == 15) {
+        literal_count += read_length(input, input_end);
+      }
+      if ((size_t)(input_end - input) < literal_count ||
+          (size_t)(output_end - output) < literal_count) {
+        throw DataFormatError("LzCodec: literals out of bounds");
+      }
+      // Short runs are the common case; copy them with one fixed-size move
+      // when both sides have room for it.
+      if (literal_count <= 16 && input_end - input >= 16 &&
+          output_end - output >= 16) {
+        std::memcpy(output, input, 16);
+      } else {
+        std::memcpy(output, input, literal_count);
+      }
+      input += literal_count;
+      output += literal_count;
+      if (input == input_end) {
+        break;
+      }
+      if (input_end - input < 2) {
+        throw DataFormatError("LzCodec: truncated offset");
+      }
+      size_t offset = input[0] | (size_t)input[1] << 8;
+      input += 2;
+      if (!offset || offset > (size_t)(output - output_start)) {
+        throw DataFormatError("LzCodec: match offset out of range");
+      }
+      size_t match_length = token & 15;
+      if (match_length == 15) {
+        match_length += read_length(input, input_end);
+      }
+      match_length += min_match;
+      if ((size_t)(output_end - output) < match_length) {
+        throw DataFormatError("LzCodec: match out of bounds");
+      }
+      const uint8_t *match = output - offset;
+      if ((size_t)(output_end - output) >= match_length + 8) {
+        // Close repeats are expanded bytewise until the copy distance,
+        // rounded up to a whole number of periods, reaches eight bytes.
+        size_t distance = offset;
+        size_t i = 0;
+        if (offset < 8) {
+          distance = offset * ((8 + offset - 1) / offset);
+          for (; i != std::min(distance, match_length); ++i) {
+            output[i] = match[i];
+          }
+        }
+        for (; i < match_length; i += 8) {
+          std::memcpy(output + i, output + i - distance, 8);
+        }
+        output += match_length;
+      } else {
+        for (size_t i = 0; i != match_length; ++i) {
+          *output++ = match[i];
+        }
+      }
+    }
+    return output - output_start;
+  }
+};
+
+// Compressed stream: a magic number followed by independent blocks, each
+// with a little-endian header of its raw size and stored size. The top bit
+// of the stored size marks a block kept uncompressed because it did not
+// shrink.
+struct CompressedStream {
+  static constexpr uint32_t stream_magic = 0x315a4c4b;
+  static constexpr size_t magic_size = sizeof(uint32_t);
+  static constexpr size_t block_size = 256 * 1024;
+  static constexpr size_t block_header_size = 8;
+  static constexpr uint32_t stored_raw = 0x80000000u;
+
+  static size_t block_bound(size_t length) {
+    return block_header_size + LzCodec::bound(length);
+  }
+
+  static size_t write_magic(std::byte *destination) {
+    store_little_endian<uint32_t>(destination, &stream_magic, 1);
+    return magic_size;
+  }
+
+  // Writes one block of at most block_size bytes and returns its size.
+  static size_t write_block(std::byte *destination, const std::byte *source,
+                            size_t length) {
+    size_t stored =
+        LzCodec::compress(source, length, destination + block_header_size);
+    uint32_t header[2] = {(uint32_t)length, (uint32_t)stored};
+    if (stored >= length) {
+      std::memcpy(destination + block_header_size, source, length);
+      header[1] = (uint32_t)length | stored_raw;
+      stored = length;
+    }
+    store_little_endian<uint32_t>(destination, header, 2);
+    return block_header_size + stored;
+  }
+
+  static size_t raw_size(std::string_view data) {
+    if (data.size() < magic_size) {
+      throw DataFormatError("CompressedStream: truncated stream");
+    }
+    uint32_t magic;
+    load_little_endian<uint32_t>(&magic, data.data(), 1);
+    if (magic != stream_magic) {
+      throw DataFormatError("CompressedStream: bad magic");
+    }
+    size_t total = 0;
+    for (size_t offset = magic_size; offset != data.size();) {
+      if (data.size() - offset < block_header_size) {
+        throw DataFormatError("CompressedStream: truncated block header");
+      }
+      uint32_t header[2];
+      load_little_endian<uint32_t>(header, data.data() + offset, 2);
+      size_t stored = header[1] & ~stored_raw;
+      if (header[0] > block_size ||
+          data.size() - offset - block_header_size < stored) {
+        throw DataFormatError("CompressedStream: bad block header");
+      }
+      // Rejecting sizes the stored bytes cannot produce bounds the output
+      // allocation by the input size.
+      if ((header[1] & stored_raw)
+              ? header[0] != stored
+              : header[0] > stored * LzCodec::max_expansion) {
+        throw DataFormatError("CompressedStream: implausible block size");
+      }
+      total += header[0];
+      offset += block_header_size + stored;
+    }
+    return total;
+  }
+
+  static void decompress(std::string_view data, std::byte *destination) {
+    for (size_t offset = magic_size; offset != data.size();) {
+      uint32_t header[2];
+      load_little_endian<uint32_t>(header, data.data() + offset, 2);
+      const char *block = data.data() + offset + block_header_size;
+      size_t stored = header[1] & ~stored_raw;
+      if (header[1] & stored_raw) {
+        if (stored != header[0]) {
+          throw DataFormatError("CompressedStream: bad stored block");
+        }
+        std::memcpy(destination, block, stored);
+      } else if (LzCodec::decompress(block, stored, destination, header[0]) !=
+                 header[0]) {
+        throw DataFormatError("CompressedStream: block size mismatch");
+      }
+      destination += header[0];
+      offset += block_header_size + stored;
+    }
+  }
+};
+
+// Growable sink that stages serialized bytes in a pooled block and appends
+// them to a BufferChain as compressed blocks, so staging memory stays
+// bounded by the block size. Each block is compressed into a reused scratch
+// block and copied into the chain at its compressed size, so the chain does
+// not keep worst-case space for every block.
+struct CompressingSerializeSink {
+  static constexpr size_t chunk_size = CompressedStream::block_size;
+  BufferChain &chain;
+  UniqueMemoryBlock staging = {};
+  UniqueMemoryBlock scratch = {};
+  size_t flushed = 0;
+
+  void grow(std::byte *&current, std::byte *&end, size_t needed) {
+    flush(current);
+    size_t size = std::max(needed, CompressedStream::block_size);
+    if (!staging || staging->get_size() < size) {
+      staging = createMemoryBlock(size);
+    }
+    current = staging->get_data();
+    end = current + size;
+  }
+
+  void flush(std::byte *current) {
+    if (!staging) {
+      return;
+    }
+    const std::byte *source = staging->get_data();
+    size_t length = current - source;
+    if (length && !scratch) {
+      scratch = createMemoryBlock(
+          CompressedStream::block_bound(CompressedStream::block_size));
+    }
+    for (size_t offset = 0; offset != length;) {
+      size_t chunk = std::min(length - offset, CompressedStream::block_size);
+      size_t size = CompressedStream::write_block(scratch->get_data(),
+                                                  source + offset, chunk);
+      // Fill whatever the tail has left, then one segment for the rest.
+      for (size_t done = 0; done != size;) {
+        auto [destination, space] = chain.reserve_tail(done ? size - done : 1);
+        size_t step = std::min(space, size - done);
+        std::memcpy(destination, scratch->get_data() + done, step);
+        chain.commit_tail(step);
+        done += step;
+      }
+      offset += chunk;
+    }
+    flushed += length;
+  }
+
+  void finish(std::byte *current) { flush(current); }
+
+  size_t tell(const std::byte *current) {
+    return flushed + (staging ? current - staging->get_data() : 0);
+  }
+};
+
+[[gnu::warn_unused_result]] inline BufferHandle
+compress_buffer(std::string_view data) {
+  size_t blocks = (data.size() + CompressedStream::block_size - 1) /
+                  CompressedStream::block_size;
+  BufferHandle result =
+      createMemoryBlock(CompressedStream::magic_size +
+                        blocks * CompressedStream::block_header_size +
+                        LzCodec::bound(data.size()));
+  std::byte *output = result->get_data();
+  size_t size = CompressedStream::write_magic(output);
+  for (size_t offset = 0; offset != data.size();) {
+    size_t chunk =
+        std::min(data.size() - offset, CompressedStream::block_size);
+    size += CompressedStream::write_block(
+        output + size, (const std::byte *)data.data() + offset, chunk);
+    offset += chunk;
+  }
+  result->capacity = size;
+  return result;
+}
+
+// Decompresses into a single pooled block sized from the block headers,
+// which raw_size() has checked against the stored sizes, so the allocation
+// is at most LzCodec::max_expansion times the input.
+[[gnu::warn_unused_result]] inline BufferHandle
+decompress_buffer(std::string_view data) {
+  BufferHandle result = createMemoryBlock(CompressedStream::raw_size(data));
+  CompressedStream::decompress(data, result->get_data());
+  return result;
+}
+
+template <typename... Types>
+[[gnu::warn_unused_result]] BufferHandle
+serialize_to_compressed_buffer(const Types &...values) {
+  BufferHandle raw = serialize_to_buffer(values...);
+  return compress_buffer(
+      std::string_view((const char *)raw->get_data(), raw->get_size()));
+}
+
+// Appends a self-contained compressed stream to the chain, compressing
+// block by block as serialization proceeds.
+template <typename... Types>
+void serialize_to_compressed_chain(BufferChain &chain,
+                                   const Types &...values) {
+  std::byte magic[CompressedStream::magic_size];
+  CompressedStream::write_magic(magic);
+  chain.write(magic, sizeof(magic));
+  CompressingSerializeSink sink{chain};
+  GrowableSerializeContext<CompressingSerializeSink> context{sink};
+  (context(values), ...);
+  sink.finish(context.current);
+}
+
+// BufferSlice fields borrow from the decompressed block.
+template <typename... Types>
+void deserialize_compressed_buffer(std::string_view data, Types &...results) {
+  BufferSlice raw(decompress_buffer(data));
+  deserialize_buffer(raw, results...);
+}
+
+template <typename... Types>
+void deserialize_compressed_buffer(Buffer *buffer, Types &...results) {
+  deserialize_compressed_buffer(
+      std::string_view{(const char *)buffer->get_data(), buffer->get_size()},
+      results...);
+}
+
+template <typename... Types>
+void deserialize_compressed_buffer(const BufferSlice &slice,
+                                   Types &...results) {
+  deserialize_compressed_buffer(slice.view(), results...);
+}
+
+inline BufferHandle compressBuffer(std::string_view data) {
+  return compress_buffer(data);
+}
+inline BufferHandle decompressBuffer(std::string_view data) {
+  return decompress_buffer(data);
+}
+template <typename... Types>
+BufferHandle serializeToCompressedBuffer(const Types &...values) {
+  return serialize_to_compressed_buffer(values...);
+}
+template <typename... Types>
+void serializeToCompressedChain(BufferChain &chain, const Types &...values) {
+  serialize_to_compressed_chain(chain, values...);
+}
+template <typename... Types>
+void deserializeCompressedBuffer(std::string_view data, Types &...results) {
+  deserialize_compressed_buffer(data, results...);
+}
+template <typename... Types>
+void deserializeCompressedBuffer(Buffer *buffer, Types &...results) {
+  deserialize_compressed_buffer(buffer, results...);
+}
+template <typename... Types>
+void deserializeCompressedBuffer(const BufferSlice &slice, Types &...results) {
+  deserialize_compressed_buffer(slice, results...);
+}
+
+} // namespace turbokit
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace turbokit {
+
+// CRC-32C (Castagnoli), as used by iSCSI, ext4 and most storage formats.
+// crc32c() picks the SSE4.2 crc32 instruction at runtime when the CPU has
+// it and falls back to slicing-by-8 tables otherwise. Passing a previous
+// result as `crc` continues the checksum over concatenated data.
+
+struct Crc32cTables {
+  static constexpr uint32_t polynomial = 0x82f63b78;
+  uint32_t table[8][256] = {};
+  constexpr Crc32cTables() {
+    for (uint32_t n = 0; n != 256; ++n) {
+      uint32_t crc = n;
+      for (int bit = 0; bit != 8; ++bit) {
+        crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+      }
+      table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n != 256; ++n) {
+      for (int slice = 1; slice != 8; ++slice) {
+        uint32_t previous = table[slice - 1][n];
+        table[slice][n] = (previous >> 8) ^ table[0][previous & 0xff];
+      }
+    }
+  }
+};
+
+inline constexpr Crc32cTables crc32c_tables{};
+
+inline uint32_t crc32c_software(const void *data, size_t length,
+                                uint32_t crc = 0) {
+  const auto &table = crc32c_tables.table;
+  const uint8_t *next = (const uint8_t *)data;
+  crc = ~crc;
+  for (; length >= 8; next += 8, length -= 8) {
+    uint64_t word;
+    std::memcpy(&word, next, 8);
+    if constexpr (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__) {
+      word = __builtin_bswap64(word);
+    }
+    word ^= crc;
+    crc = table[7][word & 0xff] ^ table[6][(word >> 8) & 0xff] ^
+          table[5][(word >> 16) & 0xff] ^ table[4][(word >> 24) & 0xff] ^
+          table[3][(word >> 32) & 0xff] ^ table[2][(word >> 40) & 0xff] ^
+          table[1][(word >> 48) & 0xff] ^ table[0][word >> 56];
+  }
+  for (; length; --length) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *next++) & 0xff];
+  }
+  return ~crc;
+}
+
+#if defined(__x86_64__)
+
+// Tables that advance a CRC over a run of zero bytes. The interleaved
+// hardware loop checksums three blocks independently and uses these to
+// shift the earlier results past the later blocks before combining them.
+struct Crc32cShiftTables {
+  uint32_t table[4][256];
+
+  static uint32_t multiply(const uint32_t *matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    for (; vector; vector >>= 1, ++matrix) {
+      if (vector & 1) {
+        sum ^= *matrix;
+      }
+    }
+    return sum;
+  }
+  static void square(uint32_t *result, const uint32_t *matrix) {
+    for (int n = 0; n != 32; ++n) {
+      result[n] = multiply(matrix, matrix[n]);
+    }
+  }
+
+  explicit Crc32cShiftTables(size_t zero_bytes) {
+    uint32_t even[32];
+    uint32_t odd[32];
+    odd[0] = Crc32cTables::polynomial;
+    for (int n = 1; n != 32; ++n) {
+      odd[n] = 1u << (n - 1);
+    }
+    square(even, odd);
+    square(odd, even);
+    // odd now shifts by four zero bits; keep squaring up to zero_bytes.
+    const uint32_t *result = nullptr;
+    while (true) {
+      square(even, odd);
+      zero_bytes >>= 1;
+      if (!zero_bytes) {
+        result = even;
+        break;
+      }
+      square(odd, even);
+      zero_bytes >>= 1;
+      if (!zero_bytes) {
+        result = odd;
+        break;
+      }
+    }
+    for (uint32_t n = 0; n != 256; ++n) {
+      table[0][n] = multiply(result, n);
+      table[1][n] = multiply(result, n << 8);
+      table[2][n] = multiply(result, n << 16);
+      table[3][n] = multiply(result, n << 24);
+    }
+  }
+
+  uint32_t shift(uint32_t crc) const {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+  }
+};
+
+// The crc32 instruction has a latency of three cycles and a throughput of
+// one, so three independent streams keep the unit busy.
+template <size_t BlockSize>
+[[gnu::target("sse4.2")]] inline uint64_t
+crc32c_interleave(uint64_t crc, const uint8_t *&next, size_t &length) {
+  static const Crc32cShiftTables shift(BlockSize);
+  while (length >= 3 * BlockSize) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t *end = next + BlockSize;
+    do {
+      uint64_t words[3];
+      std::memcpy(&words[0], next, 8);
+      std::memcpy(&words[1], next + BlockSize, 8);
+      std::memcpy(&words[2], next + 2 * BlockSize, 8);
+      crc = _mm_crc32_u64(crc, words[0]);
+      crc1 = _mm_crc32_u64(crc1, words[1]);
+      crc2 = _mm_crc32_u64(crc2, words[2]);
+      next += 8;
+    } while (next != end);
+    crc = shift.shift((uint32_t)crc) ^ crc1;
+    crc = shift.shift((uint32_t)crc) ^ crc2;
+    next += 2 * BlockSize;
+    length -= 3 * BlockSize;
+  }
+  return crc;
+}
+
+[[gnu::target("sse4.2")]] inline uint32_t
+crc32c_hardware(const void *data, size_t length, uint32_t crc = 0) {
+  const uint8_t *next = (const uint8_t *)data;
+  uint64_t value = ~crc;
+  for (; length && ((uintptr_t)next & 7); --length) {
+    value = _mm_crc32_u8((uint32_t)value, *next++);
+  }
+  value = crc32c_interleave<8192>(value, next, length);
+  value = crc32c_interleave<256>(value, next, length);
+  for (; length >= 8; next += 8, length -= 8) {
+    uint64_t word;
+    std::memcpy(&word, next, 8);
+    value = _mm_crc32_u64(value, word);
+  }
+  for (; length; --length) {
+    value = _mm_crc32_u8((uint32_t)value, *next++);
+  }
+  return ~(uint32_t)value;
+}
+
+inline bool crc32c_has_hardware() {
+  static const bool supported = __builtin_cpu_supports("sse4.2");
+  return supported;
+}
+
+#else
+
+inline bool crc32c_has_hardware() { return false; }
+
+#endif
+
+inline uint32_t crc32c(const void *data, size_t length, uint32_t crc = 0) {
+#if defined(__x86_64__)
+  if (crc32c_has_hardware()) {
+    return crc32c_hardware(data, length, crc);
+  }
+#endif
+  return crc32c_software(data, length, crc);
+}
+
+} // namespace turbokit
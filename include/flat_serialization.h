@@ -0,0 +1,632 @@
+#pragma once
+
+#include "buffer.h"
+#include "hash_map.h"
+#include "serialization.h"
+#include "simple_vector.h"
+#include "span.h"
+#include "vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace turbokit {
+
+// Random access format. Every value is addressed by a 64-bit slot: trivial
+// values of up to 8 bytes are stored in the slot itself, everything else is
+// written out of line (8 byte aligned) and the slot holds its offset from the
+// start of the buffer.
+//
+//   header    magic, version, root slot
+//   string    length, bytes
+//   sequence  count, elements (trivial) or count, element slots
+//   map       count, capacity, capacity x {hash, key slot, value slot}
+//   optional  0 when empty, otherwise offset of the value slot
+//   struct    field count, field slots in serialize() order
+//
+// Readers only ever touch the bytes they ask for, so a FlatView over a mapped
+// file gives O(1) access to element i or a hashed key lookup.
+
+inline constexpr uint32_t flat_magic = 0x314c464b; // "KFL1"
+inline constexpr uint32_t flat_version = 1;
+inline constexpr size_t flat_header_size = 16;
+
+enum class FlatKind {
+  FLAT_TRIVIAL,
+  FLAT_STRING,
+  FLAT_SEQUENCE,
+  FLAT_MAP,
+  FLAT_OPTIONAL,
+  FLAT_STRUCT,
+};
+
+template <typename Type> struct is_flat_string : std::false_type {};
+template <> struct is_flat_string<std::string> : std::true_type {};
+template <> struct is_flat_string<std::string_view> : std::true_type {};
+
+template <typename Type> struct is_flat_sequence : std::false_type {};
+template <typename Type, typename Allocator>
+struct is_flat_sequence<std::vector<Type, Allocator>> : std::true_type {};
+template <typename Type, typename Allocator>
+struct is_flat_sequence<DynamicArray<Type, Allocator>> : std::true_type {};
+template <typename Type, typename Allocator>
+struct is_flat_sequence<BasicArray<Type, Allocator>> : std::true_type {};
+template <typename Type>
+struct is_flat_sequence<Span<Type>> : std::true_type {};
+
+template <typename Type> struct is_flat_map : std::false_type {};
+template <typename Key, typename Value, typename Compare, typename Allocator>
+struct is_flat_map<std::map<Key, Value, Compare, Allocator>>
+    : std::true_type {};
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Allocator>
+struct is_flat_map<std::unordered_map<Key, Value, Hash, Equal, Allocator>>
+    : std::true_type {};
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Allocator>
+struct is_flat_map<HashMap<Key, Value, Hash, Equal, Allocator>>
+    : std::true_type {};
+
+template <typename Type> struct is_flat_optional : std::false_type {};
+template <typename Type>
+struct is_flat_optional<std::optional<Type>> : std::true_type {};
+
+struct FlatFieldDetector {
+  template <typename... Types> void operator()(const Types &...) {}
+};
+
+template <typename Type, typename = void>
+struct has_flat_fields : std::false_type {};
+template <typename Type>
+struct has_flat_fields<Type,
+                       std::void_t<decltype(std::declval<Type &>().serialize(
+                           std::declval<FlatFieldDetector &>()))>>
+    : std::true_type {};
+
+template <typename Type> constexpr FlatKind flatKindOf() {
+  if constexpr (is_flat_string<Type>::value) {
+    return FlatKind::FLAT_STRING;
+  } else if constexpr (is_flat_sequence<Type>::value) {
+    return FlatKind::FLAT_SEQUENCE;
+  } else if constexpr (is_flat_map<Type>::value) {
+    return FlatKind::FLAT_MAP;
+  } else if constexpr (is_flat_optional<Type>::value) {
+    return FlatKind::FLAT_OPTIONAL;
+  } else if constexpr (std::is_trivial_v<Type>) {
+    static_assert(alignof(Type) <= 8, "flat values are 8 byte aligned");
+    return FlatKind::FLAT_TRIVIAL;
+  } else {
+    static_assert(has_flat_fields<Type>::value,
+                  "type has no flat representation");
+    return FlatKind::FLAT_STRUCT;
+  }
+}
+
+// Sequences of trivial elements are stored as one contiguous array.
+template <typename Type> constexpr bool isFlatBulkSequence() {
+  using ElementType = std::remove_cv_t<typename Type::value_type>;
+  return std::is_trivial_v<ElementType> &&
+         is_contiguous_container<const Type>::value;
+}
+
+inline uint64_t flatHash(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ull;
+  value ^= value >> 33;
+  return value;
+}
+
+inline uint64_t flatHash(std::string_view string) {
+  uint64_t hash = 0x9e3779b97f4a7c15ull ^ string.size();
+  size_t index = 0;
+  for (; index + 8 <= string.size(); index += 8) {
+    uint64_t word;
+    std::memcpy(&word, string.data() + index, 8);
+    hash = flatHash(hash ^ word);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, string.data() + index, string.size() - index);
+  return flatHash(hash ^ tail);
+}
+
+template <typename Key> uint64_t flatKeyHash(const Key &key) {
+  uint64_t hash;
+  if constexpr (is_flat_string<Key>::value ||
+                std::is_convertible_v<const Key &, std::string_view>) {
+    hash = flatHash(std::string_view(key));
+  } else {
+    static_assert(std::is_trivial_v<Key> && sizeof(Key) <= 8,
+                  "flat map keys must be strings or small trivial values");
+    uint64_t slot = 0;
+    std::memcpy(&slot, &key, sizeof(key));
+    hash = flatHash(slot);
+  }
+  return hash ? hash : 1;
+}
+
+template <typename Sink> class FlatBuilder {
+private:
+  Sink &sink;
+  std::vector<uint64_t> slots;
+
+  std::byte *base() { return current - sink.tell(current); }
+
+  uint64_t append(const void *data, size_t length) {
+    size_t padding = (0 - sink.tell(current)) & 7;
+    if ((size_t)(end - current) < padding + length) {
+      sink.grow(current, end, padding + length);
+    }
+    std::memset(current, 0, padding);
+    current += padding;
+    uint64_t offset = sink.tell(current);
+    if (length) {
+      std::memcpy(current, data, length);
+    }
+    current += length;
+    return offset;
+  }
+
+  uint64_t append_slots(size_t mark) {
+    uint64_t count = slots.size() - mark;
+    uint64_t offset = append(&count, sizeof(count));
+    append(slots.data() + mark, count * sizeof(uint64_t));
+    slots.resize(mark);
+    return offset;
+  }
+
+  struct FieldWriter {
+    FlatBuilder &builder;
+    template <typename Type> void operator()(const Type &value) {
+      uint64_t slot = builder.slot(value);
+      builder.slots.push_back(slot);
+    }
+    template <typename... Types> void operator()(const Types &...values) {
+      ((*this)(values), ...);
+    }
+  };
+
+public:
+  std::byte *current = nullptr;
+  std::byte *end = nullptr;
+
+  FlatBuilder(Sink &sink, std::byte *start) : sink(sink), current(start) {
+    end = start;
+    std::byte header[flat_header_size] = {};
+    append(header, sizeof(header));
+  }
+
+  template <typename Type> uint64_t slot(const Type &value) {
+    constexpr FlatKind kind = flatKindOf<Type>();
+    if constexpr (kind == FlatKind::FLAT_TRIVIAL) {
+      if constexpr (sizeof(Type) <= sizeof(uint64_t)) {
+        uint64_t slot = 0;
+        std::memcpy(&slot, &value, sizeof(value));
+        return slot;
+      } else {
+        return append(&value, sizeof(value));
+      }
+    } else if constexpr (kind == FlatKind::FLAT_STRING) {
+      uint64_t length = value.size();
+      uint64_t offset = append(&length, sizeof(length));
+      append(value.data(), length);
+      return offset;
+    } else if constexpr (kind == FlatKind::FLAT_SEQUENCE) {
+      if constexpr (isFlatBulkSequence<Type>()) {
+        uint64_t count = value.size();
+        uint64_t offset = append(&count, sizeof(count));
+        append(container_data(value),
+               count * sizeof(typename Type::value_type));
+        return offset;
+      } else {
+        size_t mark = slots.size();
+        for (auto &item : value) {
+          uint64_t item_slot = slot(item);
+          slots.push_back(item_slot);
+        }
+        return append_slots(mark);
+      }
+    } else if constexpr (kind == FlatKind::FLAT_MAP) {
+      size_t mark = slots.size();
+      for (auto &entry : value) {
+        uint64_t hash = flatKeyHash(entry.first);
+        uint64_t key_slot = slot(entry.first);
+        uint64_t value_slot = slot(entry.second);
+        slots.push_back(hash);
+        slots.push_back(key_slot);
+        slots.push_back(value_slot);
+      }
+      uint64_t count = (slots.size() - mark) / 3;
+      uint64_t capacity = 0;
+      if (count) {
+        capacity = uint64_t(1) << (64 - __builtin_clzll(count * 2 - 1));
+      }
+      uint64_t header[2] = {count, capacity};
+      uint64_t offset = append(header, sizeof(header));
+      size_t table_size = capacity * 3 * sizeof(uint64_t);
+      if ((size_t)(end - current) < table_size) {
+        sink.grow(current, end, table_size);
+      }
+      uint64_t *table = (uint64_t *)current;
+      std::memset(table, 0, table_size);
+      for (size_t entry = mark; entry != slots.size(); entry += 3) {
+        uint64_t index = slots[entry] & (capacity - 1);
+        while (table[index * 3]) {
+          index = (index + 1) & (capacity - 1);
+        }
+        std::memcpy(table + index * 3, slots.data() + entry,
+                    3 * sizeof(uint64_t));
+      }
+      current += table_size;
+      slots.resize(mark);
+      return offset;
+    } else if constexpr (kind == FlatKind::FLAT_OPTIONAL) {
+      if (!value) {
+        return 0;
+      }
+      uint64_t value_slot = slot(*value);
+      return append(&value_slot, sizeof(value_slot));
+    } else {
+      size_t mark = slots.size();
+      FieldWriter writer{*this};
+      const_cast<Type &>(value).serialize(writer);
+      return append_slots(mark);
+    }
+  }
+
+  void finish(uint64_t root_slot) {
+    std::byte *header = base();
+    std::memcpy(header, &flat_magic, sizeof(flat_magic));
+    std::memcpy(header + 4, &flat_version, sizeof(flat_version));
+    std::memcpy(header + 8, &root_slot, sizeof(root_slot));
+  }
+};
+
+struct FlatData {
+  const std::byte *data = nullptr;
+  size_t size = 0;
+
+  void check(uint64_t offset, uint64_t length) const {
+    if (offset > size || length > size - offset) {
+      throw DataFormatError("FlatView: offset out of range");
+    }
+  }
+
+  uint64_t load(uint64_t offset) const {
+    check(offset, sizeof(uint64_t));
+    uint64_t value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+  }
+};
+
+template <typename Type, FlatKind Kind = flatKindOf<Type>()> class FlatView;
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_TRIVIAL> {
+private:
+  FlatData buffer;
+  uint64_t slot = 0;
+
+public:
+  FlatView(FlatData buffer, uint64_t slot) : buffer(buffer), slot(slot) {}
+
+  Type get() const {
+    Type result;
+    if constexpr (sizeof(Type) <= sizeof(uint64_t)) {
+      std::memcpy(&result, &slot, sizeof(result));
+    } else {
+      buffer.check(slot, sizeof(Type));
+      std::memcpy(&result, buffer.data + slot, sizeof(result));
+    }
+    return result;
+  }
+
+  operator Type() const { return get(); }
+};
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_STRING> {
+private:
+  FlatData buffer;
+  uint64_t slot = 0;
+
+public:
+  FlatView(FlatData buffer, uint64_t slot) : buffer(buffer), slot(slot) {}
+
+  size_t size() const { return buffer.load(slot); }
+
+  std::string_view get() const {
+    uint64_t length = buffer.load(slot);
+    buffer.check(slot + sizeof(uint64_t), length);
+    return {(const char *)buffer.data + slot + sizeof(uint64_t), length};
+  }
+
+  operator std::string_view() const { return get(); }
+};
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_SEQUENCE> {
+private:
+  using ElementType = std::remove_cv_t<typename Type::value_type>;
+  static constexpr bool is_bulk = isFlatBulkSequence<Type>();
+
+  FlatData buffer;
+  uint64_t slot = 0;
+  uint64_t count = 0;
+
+public:
+  FlatView(FlatData buffer, uint64_t slot)
+      : buffer(buffer), slot(slot), count(buffer.load(slot)) {
+    size_t element_size = is_bulk ? sizeof(ElementType) : sizeof(uint64_t);
+    // load() has checked that the count word itself is in bounds.
+    if (count > (buffer.size - slot - sizeof(uint64_t)) / element_size) {
+      throw DataFormatError("FlatView: sequence exceeds buffer");
+    }
+  }
+
+  size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  auto operator[](size_t index) const {
+    if (index >= count) {
+      throw std::out_of_range("FlatView: index out of range");
+    }
+    uint64_t elements = slot + sizeof(uint64_t);
+    if constexpr (is_bulk) {
+      ElementType result;
+      std::memcpy(&result,
+                  buffer.data + elements + index * sizeof(ElementType),
+                  sizeof(result));
+      return result;
+    } else {
+      return FlatView<ElementType>(
+          buffer, buffer.load(elements + index * sizeof(uint64_t)));
+    }
+  }
+
+  Span<const ElementType> span() const {
+    static_assert(is_bulk, "only trivial sequences are contiguous");
+    return borrow_span<const ElementType>(
+        buffer.data + slot + sizeof(uint64_t), count);
+  }
+};
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_MAP> {
+private:
+  using KeyType = typename Type::key_type;
+  using ValueType = typename Type::mapped_type;
+
+  FlatData buffer;
+  uint64_t slot = 0;
+
+  template <typename Key>
+  bool key_equals(uint64_t key_slot, const Key &key) const {
+    if constexpr (is_flat_string<KeyType>::value) {
+      return FlatView<KeyType>(buffer, key_slot).get() ==
+             std::string_view(key);
+    } else {
+      KeyType stored = FlatView<KeyType>(buffer, key_slot).get();
+      return stored == key;
+    }
+  }
+
+public:
+  FlatView(FlatData buffer, uint64_t slot) : buffer(buffer), slot(slot) {}
+
+  size_t size() const { return buffer.load(slot); }
+
+  bool empty() const { return size() == 0; }
+
+  template <typename Key>
+  std::optional<FlatView<ValueType>> find(const Key &key) const {
+    uint64_t capacity = buffer.load(slot + sizeof(uint64_t));
+    if (!capacity) {
+      return std::nullopt;
+    }
+    uint64_t table = slot + 2 * sizeof(uint64_t);
+    constexpr uint64_t bucket_size = 3 * sizeof(uint64_t);
+    if (capacity > (buffer.size - table) / bucket_size ||
+        (capacity & (capacity - 1))) {
+      throw DataFormatError("FlatView: corrupt map table");
+    }
+    uint64_t hash;
+    if constexpr (is_flat_string<KeyType>::value) {
+      hash = flatKeyHash(std::string_view(key));
+    } else {
+      hash = flatKeyHash(KeyType(key));
+    }
+    uint64_t index = hash & (capacity - 1);
+    for (uint64_t probe = 0; probe != capacity; ++probe) {
+      uint64_t bucket = table + index * bucket_size;
+      uint64_t bucket_hash = buffer.load(bucket);
+      if (!bucket_hash) {
+        break;
+      }
+      if (bucket_hash == hash &&
+          key_equals(buffer.load(bucket + sizeof(uint64_t)), key)) {
+        return FlatView<ValueType>(buffer,
+                                   buffer.load(bucket + 2 * sizeof(uint64_t)));
+      }
+      index = (index + 1) & (capacity - 1);
+    }
+    return std::nullopt;
+  }
+
+  template <typename Key> bool contains(const Key &key) const {
+    return find(key).has_value();
+  }
+
+  template <typename Key> FlatView<ValueType> at(const Key &key) const {
+    auto result = find(key);
+    if (!result) {
+      throw std::out_of_range("FlatView: key not found");
+    }
+    return *result;
+  }
+};
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_OPTIONAL> {
+private:
+  using ValueType = typename Type::value_type;
+
+  FlatData buffer;
+  uint64_t slot = 0;
+
+public:
+  FlatView(FlatData buffer, uint64_t slot) : buffer(buffer), slot(slot) {}
+
+  bool has_value() const { return slot != 0; }
+
+  explicit operator bool() const { return has_value(); }
+
+  FlatView<ValueType> value() const {
+    if (!slot) {
+      throw std::bad_optional_access();
+    }
+    return FlatView<ValueType>(buffer, buffer.load(slot));
+  }
+};
+
+template <typename Type> struct FlatStructLayout {
+  struct Recorder {
+    const std::byte *object;
+    std::vector<size_t> &offsets;
+    template <typename... Types> void operator()(const Types &...values) {
+      (offsets.push_back((const std::byte *)&values - object), ...);
+    }
+  };
+
+  static const Type &prototype() {
+    static const Type object{};
+    return object;
+  }
+
+  static const std::vector<size_t> &member_offsets() {
+    static const std::vector<size_t> offsets = [] {
+      std::vector<size_t> result;
+      Recorder recorder{(const std::byte *)&prototype(), result};
+      const_cast<Type &>(prototype()).serialize(recorder);
+      return result;
+    }();
+    return offsets;
+  }
+
+  template <typename FieldType>
+  static size_t index_of(FieldType Type::*member) {
+    const Type &object = prototype();
+    size_t offset =
+        (const std::byte *)&(object.*member) - (const std::byte *)&object;
+    const std::vector<size_t> &offsets = member_offsets();
+    for (size_t index = 0; index != offsets.size(); ++index) {
+      if (offsets[index] == offset) {
+        return index;
+      }
+    }
+    throw std::invalid_argument("FlatView: member is not serialized");
+  }
+};
+
+template <typename Type> class FlatView<Type, FlatKind::FLAT_STRUCT> {
+private:
+  FlatData buffer;
+  uint64_t slot = 0;
+  uint64_t count = 0;
+
+public:
+  FlatView(FlatData buffer, uint64_t slot)
+      : buffer(buffer), slot(slot), count(buffer.load(slot)) {}
+
+  size_t field_count() const { return count; }
+
+  bool has_field(size_t index) const { return index < count; }
+
+  template <size_t Index, typename FieldType>
+  FlatView<FieldType> field() const {
+    if (Index >= count) {
+      throw std::out_of_range("FlatView: field not present");
+    }
+    return FlatView<FieldType>(
+        buffer, buffer.load(slot + sizeof(uint64_t) * (Index + 1)));
+  }
+
+  template <typename FieldType>
+  FlatView<FieldType> field(FieldType Type::*member) const {
+    size_t index = FlatStructLayout<Type>::index_of(member);
+    if (index >= count) {
+      throw std::out_of_range("FlatView: field not present");
+    }
+    return FlatView<FieldType>(
+        buffer, buffer.load(slot + sizeof(uint64_t) * (index + 1)));
+  }
+};
+
+template <typename Output, typename Type>
+void flat_serialize_to(Output &output, const Type &value) {
+  static_assert(sizeof(*container_data(output)) == sizeof(std::byte));
+  using Sink = ContainerSerializeSink<Output>;
+  output.resize(0);
+  Sink sink{output};
+  FlatBuilder<Sink> builder(sink, sink.data());
+  builder.finish(builder.slot(value));
+  sink.finish(builder.current);
+}
+
+template <typename Type>
+[[gnu::warn_unused_result]] BufferHandle
+flat_serialize_to_buffer(const Type &value) {
+  MemoryBlockSerializeSink sink;
+  FlatBuilder<MemoryBlockSerializeSink> builder(sink, nullptr);
+  builder.finish(builder.slot(value));
+  return sink.finish(builder.current);
+}
+
+template <typename Type> FlatView<Type> flat_root(std::string_view data) {
+  FlatData buffer{(const std::byte *)data.data(), data.size()};
+  buffer.check(0, flat_header_size);
+  uint32_t magic;
+  uint32_t version;
+  std::memcpy(&magic, buffer.data, sizeof(magic));
+  std::memcpy(&version, buffer.data + 4, sizeof(version));
+  if (magic != flat_magic || version != flat_version) {
+    throw DataFormatError("flat_root: not a flat buffer");
+  }
+  return FlatView<Type>(buffer, buffer.load(8));
+}
+
+template <typename Type> FlatView<Type> flat_root(Buffer *buffer) {
+  return flat_root<Type>(
+      std::string_view{(const char *)buffer->get_data(), buffer->get_size()});
+}
+
+template <typename Type> FlatView<Type> flat_root(const BufferSlice &slice) {
+  return flat_root<Type>(slice.view());
+}
+
+template <typename Output, typename Type>
+void flatSerializeTo(Output &output, const Type &value) {
+  flat_serialize_to(output, value);
+}
+template <typename Type>
+BufferHandle flatSerializeToBuffer(const Type &value) {
+  return flat_serialize_to_buffer(value);
+}
+template <typename Type> FlatView<Type> flatRoot(std::string_view data) {
+  return flat_root<Type>(data);
+}
+template <typename Type> FlatView<Type> flatRoot(Buffer *buffer) {
+  return flat_root<Type>(buffer);
+}
+template <typename Type> FlatView<Type> flatRoot(const BufferSlice &slice) {
+  return flat_root<Type>(slice);
+}
+
+} // namespace turbokit
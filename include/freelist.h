@@ -2,22 +2,21 @@
 
 #include "sync.h"
 
+#include <mutex>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 namespace turbokit {
 
-template <typename ElementType> struct ThreadLocalPool {
-  ElementType *first_element = nullptr;
-  size_t element_count = 0;
-  static ThreadLocalPool &get_instance() {
-    thread_local ThreadLocalPool pool;
-    return pool;
-  }
+struct DefaultFreeListTag {};
+
+template <typename ElementType> struct FreeListLink {
+  static auto &get(ElementType *element) { return element->next; }
 };
 
-template <typename ElementType> struct SharedPool {
+template <typename ElementType, typename Tag = DefaultFreeListTag>
+struct SharedPool {
   SpinMutex synchronization_lock;
   std::vector<std::pair<ElementType *, size_t>> available_elements;
   static SharedPool &get_instance() {
@@ -26,7 +25,33 @@ template <typename ElementType> struct SharedPool {
   }
 };
 
-template <typename ElementType> struct MemoryPool {
+template <typename ElementType, typename Tag = DefaultFreeListTag>
+struct ThreadLocalPool {
+  ElementType *first_element = nullptr;
+  size_t element_count = 0;
+  static ThreadLocalPool &get_instance() {
+    thread_local ThreadLocalPool pool;
+    return pool;
+  }
+  ~ThreadLocalPool() {
+    if (first_element) {
+      auto &shared_pool = SharedPool<ElementType, Tag>::get_instance();
+      std::lock_guard lock(shared_pool.synchronization_lock);
+      shared_pool.available_elements.emplace_back(first_element,
+                                                  element_count);
+    }
+  }
+};
+
+template <typename ElementType, typename Tag = DefaultFreeListTag>
+struct MemoryPool {
+  using LocalPool = ThreadLocalPool<ElementType, Tag>;
+  using GlobalPool = SharedPool<ElementType, Tag>;
+
+  static auto &link(ElementType *element) {
+    return FreeListLink<ElementType>::get(element);
+  }
+
   template <typename StorageType> static auto read_value(StorageType &storage) {
     if constexpr (std::is_scalar_v<StorageType>) {
       return storage;
@@ -46,8 +71,8 @@ template <typename ElementType> struct MemoryPool {
 
   [[gnu::always_inline]] static void add_element(ElementType *element,
                                                  size_t max_local_elements) {
-    auto &local_pool = ThreadLocalPool<ElementType>::get_instance();
-    if (local_pool.element_count == max_local_elements) {
+    auto &local_pool = LocalPool::get_instance();
+    if (local_pool.element_count >= max_local_elements) {
       [[unlikely]];
       transfer_to_shared_pool(local_pool, max_local_elements / 8u);
     }
@@ -55,16 +80,16 @@ template <typename ElementType> struct MemoryPool {
     ++local_pool.element_count;
     ElementType *previous_first =
         std::exchange(local_pool.first_element, element);
-    write_value(element->next, previous_first);
+    write_value(link(element), previous_first);
   }
 
   [[gnu::always_inline]] static ElementType *remove_element() {
-    auto &local_pool = ThreadLocalPool<ElementType>::get_instance();
+    auto &local_pool = LocalPool::get_instance();
     ElementType *result = local_pool.first_element;
     if (result) {
       [[likely]];
       --local_pool.element_count;
-      local_pool.first_element = (ElementType *)read_value(result->next);
+      local_pool.first_element = (ElementType *)read_value(link(result));
       return result;
     }
     [[unlikely]];
@@ -72,8 +97,8 @@ template <typename ElementType> struct MemoryPool {
   }
 
   [[gnu::noinline]] static ElementType *
-  remove_from_shared_pool(ThreadLocalPool<ElementType> &local_pool) {
-    auto &shared_pool = SharedPool<ElementType>::get_instance();
+  remove_from_shared_pool(LocalPool &local_pool) {
+    auto &shared_pool = GlobalPool::get_instance();
     std::unique_lock lock(shared_pool.synchronization_lock);
     if (shared_pool.available_elements.empty()) {
       [[unlikely]];
@@ -84,36 +109,48 @@ template <typename ElementType> struct MemoryPool {
     std::tie(result, remaining_count) = shared_pool.available_elements.back();
     shared_pool.available_elements.pop_back();
     lock.unlock();
-    local_pool.first_element = (ElementType *)read_value(result->next);
+    local_pool.first_element = (ElementType *)read_value(link(result));
     local_pool.element_count = remaining_count - 1;
     return result;
   }
 
   [[gnu::noinline]] static void
-  transfer_to_shared_pool(ThreadLocalPool<ElementType> &local_pool,
-                          size_t elements_to_retain) {
+  transfer_to_shared_pool(LocalPool &local_pool, size_t elements_to_retain) {
+    if (!local_pool.element_count) {
+      return;
+    }
+    auto &shared_pool = GlobalPool::get_instance();
+    if (!elements_to_retain) {
+      std::lock_guard lock(shared_pool.synchronization_lock);
+      shared_pool.available_elements.emplace_back(
+          std::exchange(local_pool.first_element, nullptr),
+          std::exchange(local_pool.element_count, 0));
+      return;
+    }
     ElementType *current = local_pool.first_element;
     size_t new_count = 1;
     while (new_count < elements_to_retain) {
-      ElementType *next_element = (ElementType *)read_value(current->next);
+      ElementType *next_element = (ElementType *)read_value(link(current));
       current = next_element;
       ++new_count;
     }
     size_t original_count = local_pool.element_count;
     local_pool.element_count = new_count;
-    ElementType *next_element = (ElementType *)read_value(current->next);
-    write_value(current->next, nullptr);
-    auto &shared_pool = SharedPool<ElementType>::get_instance();
+    ElementType *next_element = (ElementType *)read_value(link(current));
+    write_value(link(current), nullptr);
     std::lock_guard lock(shared_pool.synchronization_lock);
     shared_pool.available_elements.emplace_back(next_element,
                                                 original_count - new_count);
   }
 };
 
-template <typename T> using FreeListTlsStorage = ThreadLocalPool<T>;
+template <typename T, typename Tag = DefaultFreeListTag>
+using FreeListTlsStorage = ThreadLocalPool<T, Tag>;
 
-template <typename T> using FreeListGlobalStorage = SharedPool<T>;
+template <typename T, typename Tag = DefaultFreeListTag>
+using FreeListGlobalStorage = SharedPool<T, Tag>;
 
-template <typename T> using FreeList = MemoryPool<T>;
+template <typename T, typename Tag = DefaultFreeListTag>
+using FreeList = MemoryPool<T, Tag>;
 
 } // namespace turbokit
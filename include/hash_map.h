@@ -47,6 +47,9 @@ private:
   CollisionEntry *collision_table = nullptr;
 
 public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+
   struct iterator {
   private:
   public:
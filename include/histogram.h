@@ -0,0 +1,328 @@
+#pragma once
+
+#include "clock.h"
+#include "hash_map.h"
+#include "stopwatch.h"
+#include "sync.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace turbokit {
+
+template <int SubBucketBits> struct HistogramLayout {
+  static_assert(SubBucketBits >= 2 && SubBucketBits <= 16);
+  static constexpr size_t sub_bucket_count = size_t(1) << SubBucketBits;
+  static constexpr size_t half_sub_bucket_count = sub_bucket_count / 2;
+  static constexpr size_t bucket_count =
+      (64 - SubBucketBits + 1) * half_sub_bucket_count;
+
+  static size_t index_of(int64_t value) {
+    uint64_t magnitude = value > 0 ? (uint64_t)value : 0;
+    if (magnitude < sub_bucket_count) {
+      return magnitude;
+    }
+    int exponent = 63 - __builtin_clzll(magnitude) - SubBucketBits + 1;
+    return exponent * half_sub_bucket_count + (magnitude >> exponent);
+  }
+
+  static int64_t lowest_value_at(size_t index) {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+    int exponent = index / half_sub_bucket_count - 1;
+    uint64_t mantissa = index - exponent * half_sub_bucket_count;
+    return mantissa << exponent;
+  }
+
+  static int64_t highest_value_at(size_t index) {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+    int exponent = index / half_sub_bucket_count - 1;
+    uint64_t mantissa = index - exponent * half_sub_bucket_count;
+    return ((mantissa + 1) << exponent) - 1;
+  }
+};
+
+struct LatencyPercentiles {
+  int64_t p50 = 0;
+  int64_t p90 = 0;
+  int64_t p99 = 0;
+  int64_t p999 = 0;
+  int64_t p9999 = 0;
+};
+
+template <int SubBucketBits> struct HistogramSnapshot {
+  using Layout = HistogramLayout<SubBucketBits>;
+  std::vector<uint64_t> counts = std::vector<uint64_t>(Layout::bucket_count);
+  uint64_t total_count = 0;
+  int64_t min_value = std::numeric_limits<int64_t>::max();
+  int64_t max_value = 0;
+  int64_t total_value = 0;
+
+  void add(const HistogramSnapshot &other) {
+    for (size_t i = 0; i != Layout::bucket_count; ++i) {
+      counts[i] += other.counts[i];
+    }
+    total_count += other.total_count;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+    total_value += other.total_value;
+  }
+
+  int64_t value_at_percentile(double percentile) const {
+    if (total_count == 0) {
+      return 0;
+    }
+    uint64_t target = (uint64_t)std::ceil(
+        std::clamp(percentile, 0.0, 100.0) / 100.0 * total_count);
+    target = std::max<uint64_t>(target, 1);
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i != Layout::bucket_count; ++i) {
+      accumulated += counts[i];
+      if (accumulated >= target) {
+        return std::clamp(Layout::highest_value_at(i), min_value, max_value);
+      }
+    }
+    return max_value;
+  }
+
+  LatencyPercentiles percentiles() const {
+    LatencyPercentiles result;
+    result.p50 = value_at_percentile(50.0);
+    result.p90 = value_at_percentile(90.0);
+    result.p99 = value_at_percentile(99.0);
+    result.p999 = value_at_percentile(99.9);
+    result.p9999 = value_at_percentile(99.99);
+    return result;
+  }
+
+  double mean() const {
+    return total_count ? (double)total_value / total_count : 0.0;
+  }
+
+  int64_t min() const { return total_count ? min_value : 0; }
+  int64_t max() const { return max_value; }
+  uint64_t count() const { return total_count; }
+};
+
+inline std::atomic_uint64_t histogramIdCounter = 1;
+
+// Dense per-thread index that histograms use to find the thread's shard
+// without locking. Indices of exited threads are handed to new threads, which
+// then take over the exited thread's shards.
+class HistogramThreadSlots {
+  SpinMutex mutex;
+  std::vector<uint32_t> free_slots;
+  uint32_t next_slot = 0;
+
+public:
+  uint32_t acquire() {
+    std::lock_guard lock(mutex);
+    if (free_slots.empty()) {
+      return next_slot++;
+    }
+    uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  }
+
+  void release(uint32_t slot) {
+    std::lock_guard lock(mutex);
+    free_slots.push_back(slot);
+  }
+};
+
+inline HistogramThreadSlots histogramThreadSlots;
+
+struct HistogramThreadSlot {
+  uint32_t index = histogramThreadSlots.acquire();
+  HistogramThreadSlot() = default;
+  HistogramThreadSlot(const HistogramThreadSlot &) = delete;
+  HistogramThreadSlot &operator=(const HistogramThreadSlot &) = delete;
+  ~HistogramThreadSlot() { histogramThreadSlots.release(index); }
+};
+
+template <int SubBucketBits = 7> class BasicLatencyHistogram {
+public:
+  using Layout = HistogramLayout<SubBucketBits>;
+  using Snapshot = HistogramSnapshot<SubBucketBits>;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic_uint64_t counts[Layout::bucket_count] = {};
+    std::atomic_uint64_t total_count = 0;
+    std::atomic_int64_t min_value = std::numeric_limits<int64_t>::max();
+    std::atomic_int64_t max_value = 0;
+    std::atomic_int64_t total_value = 0;
+  };
+
+  // Small direct-mapped per-thread cache of recently used shards. Its size
+  // does not depend on how many histograms a thread touches, and histogram
+  // ids are never reused, so entries for destroyed histograms only miss.
+  struct ShardCache {
+    static constexpr size_t entry_count = 8;
+    struct Entry {
+      uint64_t histogram_id = 0;
+      Shard *shard = nullptr;
+    };
+    Entry entries[entry_count];
+  };
+
+  // Shards indexed by HistogramThreadSlot, so a cache miss finds the thread's
+  // shard with two loads. Blocks are allocated on first use; slots past the
+  // table fall back to overflow_shards under the lock.
+  static constexpr size_t slots_per_block = 64;
+  static constexpr size_t block_count = 1024;
+  using ShardSlot = std::atomic<Shard *>;
+
+  uint64_t histogram_id = histogramIdCounter.fetch_add(1);
+  std::atomic<ShardSlot *> shard_blocks[block_count] = {};
+  SpinMutex shards_mutex;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<std::unique_ptr<ShardSlot[]>> blocks;
+  HashMap<uint32_t, Shard *> overflow_shards;
+
+  template <typename Type>
+  static void store_relaxed(std::atomic<Type> &target, Type value) {
+    target.store(value, std::memory_order_relaxed);
+  }
+
+  template <typename Type> static Type load_relaxed(std::atomic<Type> &source) {
+    return source.load(std::memory_order_relaxed);
+  }
+
+  Shard *find_shard(uint32_t slot) {
+    if (slot >= slots_per_block * block_count) {
+      std::lock_guard lock(shards_mutex);
+      auto i = overflow_shards.find(slot);
+      return i != overflow_shards.end() ? i->second : nullptr;
+    }
+    ShardSlot *block =
+        shard_blocks[slot / slots_per_block].load(std::memory_order_acquire);
+    if (!block) {
+      return nullptr;
+    }
+    return block[slot % slots_per_block].load(std::memory_order_acquire);
+  }
+
+  Shard *create_shard(uint32_t slot) {
+    std::lock_guard lock(shards_mutex);
+    shards.push_back(std::make_unique<Shard>());
+    Shard *shard = shards.back().get();
+    if (slot >= slots_per_block * block_count) {
+      overflow_shards[slot] = shard;
+      return shard;
+    }
+    auto &block_pointer = shard_blocks[slot / slots_per_block];
+    ShardSlot *block = block_pointer.load(std::memory_order_relaxed);
+    if (!block) {
+      blocks.push_back(std::make_unique<ShardSlot[]>(slots_per_block));
+      block = blocks.back().get();
+      block_pointer.store(block, std::memory_order_release);
+    }
+    block[slot % slots_per_block].store(shard, std::memory_order_release);
+    return shard;
+  }
+
+  [[gnu::noinline]] Shard &create_local_shard(ShardCache &cache) {
+    thread_local HistogramThreadSlot slot;
+    Shard *shard = find_shard(slot.index);
+    if (!shard) {
+      [[unlikely]];
+      shard = create_shard(slot.index);
+    }
+    auto &entry = cache.entries[histogram_id % ShardCache::entry_count];
+    entry.histogram_id = histogram_id;
+    entry.shard = shard;
+    return *shard;
+  }
+
+  Shard &local_shard() {
+    thread_local ShardCache cache;
+    auto &entry = cache.entries[histogram_id % ShardCache::entry_count];
+    if (entry.histogram_id == histogram_id) {
+      [[likely]];
+      return *entry.shard;
+    }
+    return create_local_shard(cache);
+  }
+
+public:
+  BasicLatencyHistogram() = default;
+  BasicLatencyHistogram(const BasicLatencyHistogram &) = delete;
+  BasicLatencyHistogram &operator=(const BasicLatencyHistogram &) = delete;
+
+  void record(int64_t value) {
+    Shard &shard = local_shard();
+    std::atomic_uint64_t &bucket = shard.counts[Layout::index_of(value)];
+    store_relaxed(bucket, load_relaxed(bucket) + 1);
+    store_relaxed(shard.total_count, load_relaxed(shard.total_count) + 1);
+    store_relaxed(shard.total_value, load_relaxed(shard.total_value) + value);
+    if (value < load_relaxed(shard.min_value)) {
+      [[unlikely]];
+      store_relaxed(shard.min_value, value);
+    }
+    if (value > load_relaxed(shard.max_value)) {
+      [[unlikely]];
+      store_relaxed(shard.max_value, value);
+    }
+  }
+
+  void record(std::chrono::nanoseconds duration) { record(duration.count()); }
+
+  void record_cycles(int64_t cycles) {
+    record(time_manager.cycles_to_nanoseconds(cycles));
+  }
+
+  void record(const CycleStopwatch &stopwatch) {
+    record(stopwatch.elapsed_nanoseconds());
+  }
+
+  Snapshot snapshot() {
+    Snapshot result;
+    std::lock_guard lock(shards_mutex);
+    for (auto &shard : shards) {
+      for (size_t i = 0; i != Layout::bucket_count; ++i) {
+        result.counts[i] += load_relaxed(shard->counts[i]);
+      }
+      result.total_count += load_relaxed(shard->total_count);
+      result.total_value += load_relaxed(shard->total_value);
+      result.min_value =
+          std::min(result.min_value, load_relaxed(shard->min_value));
+      result.max_value =
+          std::max(result.max_value, load_relaxed(shard->max_value));
+    }
+    return result;
+  }
+
+  LatencyPercentiles percentiles() { return snapshot().percentiles(); }
+
+  // Only exact while no thread is recording: owners update their shard with
+  // plain load-then-store, so a concurrent record() can write back a count
+  // read before the reset.
+  void reset() {
+    std::lock_guard lock(shards_mutex);
+    for (auto &shard : shards) {
+      for (auto &count : shard->counts) {
+        store_relaxed(count, uint64_t(0));
+      }
+      store_relaxed(shard->total_count, uint64_t(0));
+      store_relaxed(shard->total_value, int64_t(0));
+      store_relaxed(shard->min_value, std::numeric_limits<int64_t>::max());
+      store_relaxed(shard->max_value, int64_t(0));
+    }
+  }
+};
+
+using LatencyHistogram = BasicLatencyHistogram<>;
+
+} // namespace turbokit
@@ -1,8 +1,28 @@
 #pragma once
 
+#include "clock.h"
 #include "fmt/printf.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
 
 namespace turbokit {
 
@@ -51,23 +71,698 @@ template <typename... Args>
   fflush(primary_output);
 }
 
+template <typename Type> struct FlightArgument {
+  using stored_type = std::decay_t<Type>;
+  static constexpr bool is_string =
+      std::is_same_v<stored_type, const char *> ||
+      std::is_same_v<stored_type, char *> ||
+      std::is_same_v<stored_type, std::string> ||
+      std::is_same_v<stored_type, std::string_view>;
+  static constexpr bool is_recordable =
+      is_string || std::is_trivially_copyable_v<stored_type>;
+  static constexpr size_t fixed_size =
+      is_string ? sizeof(uint32_t) : sizeof(stored_type);
+  using decoded_type =
+      std::conditional_t<is_string, std::string_view, stored_type>;
+
+  static void encode(std::byte *&cursor, std::byte *&string_cursor,
+                     std::byte *end, const Type &value) {
+    if constexpr (is_string) {
+      std::string_view string;
+      if constexpr (std::is_array_v<Type>) {
+        string = value;
+      } else if constexpr (std::is_pointer_v<stored_type>) {
+        string = value ? std::string_view(value) : std::string_view("(null)");
+      } else {
+        string = value;
+      }
+      uint32_t length =
+          (uint32_t)std::min<size_t>(string.size(), end - string_cursor);
+      std::memcpy(cursor, &length, sizeof(length));
+      std::memcpy(string_cursor, string.data(), length);
+      string_cursor += length;
+    } else {
+      std::memcpy(cursor, (const void *)&value, sizeof(stored_type));
+    }
+    cursor += fixed_size;
+  }
+
+  static decoded_type decode(const std::byte *&cursor,
+                             const std::byte *&string_cursor) {
+    decoded_type result;
+    if constexpr (is_string) {
+      uint32_t length;
+      std::memcpy(&length, cursor, sizeof(length));
+      result = {(const char *)string_cursor, length};
+      string_cursor += length;
+    } else {
+      std::memcpy((void *)&result, cursor, sizeof(stored_type));
+    }
+    cursor += fixed_size;
+    return result;
+  }
+};
+
+// Fixed-capacity output for the flight recorder dump. Appends past the end
+// are dropped, so formatting never allocates.
+struct FlightText {
+  char *data;
+  size_t capacity;
+  size_t size = 0;
+
+  void append(char c) {
+    if (size != capacity) {
+      data[size++] = c;
+    }
+  }
+  void append(const char *text, size_t length) {
+    length = std::min(length, capacity - size);
+    std::memcpy(data + size, text, length);
+    size += length;
+  }
+  void append(std::string_view text) { append(text.data(), text.size()); }
+  void pad(char c, size_t count) {
+    count = std::min(count, capacity - size);
+    std::memset(data + size, c, count);
+    size += count;
+  }
+};
+
+struct FlightFormatSpec {
+  bool left = false;
+  bool plus = false;
+  bool space = false;
+  bool zero = false;
+  bool alternate = false;
+  size_t width = 0;
+  int precision = -1;
+  char conversion = 's';
+};
+
+// printf-style formatting for dump(), which may run in a signal handler and
+// so must not allocate or take locks. It covers the flags, width, precision
+// and conversions used by log formats; '*' widths are not supported.
+struct FlightFormatter {
+  // Appends literal text up to the next conversion and parses it into spec.
+  // Returns the rest of the format, or nullptr once it is exhausted.
+  static const char *next(FlightText &out, const char *format,
+                          FlightFormatSpec &spec) {
+    while (true) {
+      const char *percent = std::strchr(format, '%');
+      if (!percent) {
+        out.append(format, std::strlen(format));
+        return nullptr;
+      }
+      out.append(format, percent - format);
+      format = percent + 1;
+      if (*format == '%') {
+        out.append('%');
+        ++format;
+        continue;
+      }
+      spec = {};
+      for (;; ++format) {
+        if (*format == '-') {
+          spec.left = true;
+        } else if (*format == '+') {
+          spec.plus = true;
+        } else if (*format == ' ') {
+          spec.space = true;
+        } else if (*format == '0') {
+          spec.zero = true;
+        } else if (*format == '#') {
+          spec.alternate = true;
+        } else {
+          break;
+        }
+      }
+      for (; *format >= '0' && *format <= '9'; ++format) {
+        spec.width = std::min<size_t>(spec.width * 10 + (*format - '0'), 4096);
+      }
+      if (*format == '.') {
+        spec.precision = 0;
+        for (++format; *format >= '0' && *format <= '9'; ++format) {
+          spec.precision =
+              std::min(spec.precision * 10 + (*format - '0'), 4096);
+        }
+      }
+      while (*format && std::strchr("hlLqjzt", *format)) {
+        ++format;
+      }
+      if (!*format) {
+        return nullptr;
+      }
+      spec.conversion = *format++;
+      return format;
+    }
+  }
+
+  static void emit(FlightText &out, const FlightFormatSpec &spec,
+                   std::string_view prefix, std::string_view body,
+                   bool zero_pad) {
+    size_t length = prefix.size() + body.size();
+    size_t padding = spec.width > length ? spec.width - length : 0;
+    if (spec.left) {
+      out.append(prefix);
+      out.append(body);
+      out.pad(' ', padding);
+    } else if (spec.zero && zero_pad) {
+      out.append(prefix);
+      out.pad('0', padding);
+      out.append(body);
+    } else {
+      out.pad(' ', padding);
+      out.append(prefix);
+      out.append(body);
+    }
+  }
+
+  static char *digits(char *end, uint64_t value, unsigned base, bool upper) {
+    const char *symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    do {
+      *--end = symbols[value % base];
+      value /= base;
+    } while (value);
+    return end;
+  }
+
+  static void integer(FlightText &out, const FlightFormatSpec &spec,
+                      uint64_t magnitude, bool negative) {
+    unsigned base = 10;
+    const char *prefix = negative     ? "-"
+                         : spec.plus  ? "+"
+                         : spec.space ? " "
+                                      : "";
+    char conversion = spec.conversion;
+    if (conversion == 'x' || conversion == 'X' || conversion == 'p') {
+      base = 16;
+      if ((spec.alternate && magnitude) || conversion == 'p') {
+        prefix = conversion == 'X' ? "0X" : "0x";
+      }
+    } else if (conversion == 'o') {
+      base = 8;
+    }
+    char buffer[96];
+    char *end = buffer + sizeof(buffer);
+    char *begin = digits(end, magnitude, base, conversion == 'X');
+    if (spec.precision == 0 && magnitude == 0) {
+      begin = end;
+    }
+    while (end - begin < std::min(spec.precision, 64)) {
+      *--begin = '0';
+    }
+    if (base == 8 && spec.alternate && (begin == end || *begin != '0')) {
+      *--begin = '0';
+    }
+    emit(out, spec, prefix, {begin, size_t(end - begin)}, spec.precision < 0);
+  }
+
+  // Writes value with `precision` fractional digits, rounding ties to even.
+  // Values too large for 64-bit arithmetic return false.
+  static bool fixed(char *&cursor, double value, int precision) {
+    static constexpr uint64_t powers[] = {1,
+                                          10,
+                                          100,
+                                          1000,
+                                          10000,
+                                          100000,
+                                          1000000,
+                                          10000000,
+                                          100000000,
+                                          1000000000,
+                                          10000000000,
+                                          100000000000,
+                                          1000000000000,
+                                          10000000000000,
+                                          100000000000000,
+                                          1000000000000000,
+                                          10000000000000000,
+                                          100000000000000000};
+    if (value >= 1e18) {
+      return false;
+    }
+    precision = std::min(precision, 17);
+    uint64_t whole = (uint64_t)value;
+    double fraction = (value - (double)whole) * (double)powers[precision];
+    uint64_t scaled = (uint64_t)fraction;
+    double remainder = fraction - (double)scaled;
+    uint64_t last_digit = precision ? scaled : whole;
+    if (remainder > 0.5 || (remainder == 0.5 && (last_digit & 1))) {
+      ++scaled;
+    }
+    if (scaled >= powers[precision]) {
+      scaled -= powers[precision];
+      ++whole;
+    }
+    char buffer[24];
+    char *end = buffer + sizeof(buffer);
+    char *begin = digits(end, whole, 10, false);
+    std::memcpy(cursor, begin, end - begin);
+    cursor += end - begin;
+    if (precision) {
+      *cursor++ = '.';
+      begin = digits(end, scaled, 10, false);
+      for (int zeros = precision - int(end - begin); zeros > 0; --zeros) {
+        *cursor++ = '0';
+      }
+      std::memcpy(cursor, begin, end - begin);
+      cursor += end - begin;
+    }
+    return true;
+  }
+
+  static int decimal_exponent(double value) {
+    int exponent = 0;
+    if (value == 0) {
+      return 0;
+    }
+    for (; value >= 10; value /= 10) {
+      ++exponent;
+    }
+    for (; value < 1; value *= 10) {
+      --exponent;
+    }
+    return exponent;
+  }
+
+  // Writes value as d.ddde+XX and returns the exponent after rounding.
+  static int exponential(char *&cursor, double value, int precision,
+                         bool upper) {
+    precision = std::min(precision, 17);
+    int exponent = decimal_exponent(value);
+    double mantissa = value;
+    for (int n = exponent; n > 0; --n) {
+      mantissa /= 10;
+    }
+    for (int n = exponent; n < 0; ++n) {
+      mantissa *= 10;
+    }
+    char *begin = cursor;
+    fixed(cursor, mantissa, precision);
+    if (cursor - begin >= 2 && begin[0] == '1' && begin[1] == '0') {
+      // Rounding carried into a second integer digit.
+      ++exponent;
+      cursor = begin;
+      fixed(cursor, mantissa / 10, precision);
+    }
+    *cursor++ = upper ? 'E' : 'e';
+    *cursor++ = exponent < 0 ? '-' : '+';
+    char buffer[8];
+    char *end = buffer + sizeof(buffer);
+    char *digits_begin =
+        digits(end, exponent < 0 ? -exponent : exponent, 10, false);
+    if (end - digits_begin < 2) {
+      *cursor++ = '0';
+    }
+    std::memcpy(cursor, digits_begin, end - digits_begin);
+    cursor += end - digits_begin;
+    return exponent;
+  }
+
+  // Drops trailing fractional zeros (and a bare '.') before any exponent.
+  static void trim_zeros(char *begin, char *&end) {
+    char *exponent = begin;
+    while (exponent != end && *exponent != 'e' && *exponent != 'E') {
+      ++exponent;
+    }
+    if (!std::memchr(begin, '.', exponent - begin)) {
+      return;
+    }
+    char *trimmed = exponent;
+    while (trimmed[-1] == '0') {
+      --trimmed;
+    }
+    if (trimmed[-1] == '.') {
+      --trimmed;
+    }
+    std::memmove(trimmed, exponent, end - exponent);
+    end -= exponent - trimmed;
+  }
+
+  static void floating(FlightText &out, const FlightFormatSpec &spec,
+                       double value) {
+    bool negative = std::signbit(value);
+    const char *prefix = negative     ? "-"
+                         : spec.plus  ? "+"
+                         : spec.space ? " "
+                                      : "";
+    value = std::fabs(value);
+    char conversion = spec.conversion;
+    bool upper = conversion == 'F' || conversion == 'E' || conversion == 'G';
+    if (std::isnan(value)) {
+      emit(out, spec, prefix, upper ? "NAN" : "nan", false);
+      return;
+    }
+    if (std::isinf(value)) {
+      emit(out, spec, prefix, upper ? "INF" : "inf", false);
+      return;
+    }
+    int precision = spec.precision < 0 ? 6 : spec.precision;
+    char buffer[352];
+    char *cursor = buffer;
+    if (conversion == 'e' || conversion == 'E') {
+      exponential(cursor, value, precision, upper);
+    } else if (conversion == 'g' || conversion == 'G') {
+      precision = std::max(precision, 1);
+      int exponent = exponential(cursor, value, precision - 1, upper);
+      if (exponent >= -4 && exponent < precision) {
+        char *exponent_form = cursor;
+        cursor = buffer;
+        if (!fixed(cursor, value, precision - 1 - exponent)) {
+          cursor = exponent_form;
+        }
+      }
+      if (!spec.alternate) {
+        trim_zeros(buffer, cursor);
+      }
+    } else if (!fixed(cursor, value, precision)) {
+      // 17 significant digits, then zeros up to the decimal point.
+      char significant[32];
+      char *significant_end = significant;
+      int exponent = exponential(significant_end, value, 16, false);
+      *cursor++ = significant[0];
+      std::memcpy(cursor, significant + 2, 16);
+      cursor += 16;
+      for (int n = 16; n < exponent; ++n) {
+        *cursor++ = '0';
+      }
+      if (precision) {
+        *cursor++ = '.';
+      }
+      for (int n = std::min(precision, 17); n > 0; --n) {
+        *cursor++ = '0';
+      }
+    }
+    if (spec.alternate && !std::memchr(buffer, '.', cursor - buffer)) {
+      *cursor++ = '.';
+    }
+    emit(out, spec, prefix, {buffer, size_t(cursor - buffer)}, true);
+  }
+
+  static void string(FlightText &out, const FlightFormatSpec &spec,
+                     std::string_view string) {
+    if (spec.precision >= 0) {
+      string = string.substr(0, spec.precision);
+    }
+    emit(out, spec, "", string, false);
+  }
+
+  template <typename Type>
+  static void value(FlightText &out, const FlightFormatSpec &spec,
+                    const Type &value) {
+    char conversion = spec.conversion;
+    bool is_floating_conversion = std::strchr("fFeEgGaA", conversion);
+    if constexpr (std::is_convertible_v<const Type &, std::string_view>) {
+      if constexpr (std::is_pointer_v<Type>) {
+        string(out, spec, value ? std::string_view(value) : "(null)");
+      } else {
+        string(out, spec, value);
+      }
+    } else if constexpr (std::is_same_v<Type, bool>) {
+      if (conversion == 's') {
+        string(out, spec, value ? "true" : "false");
+      } else {
+        integer(out, spec, value, false);
+      }
+    } else if constexpr (std::is_enum_v<Type>) {
+      FlightFormatter::value(out, spec, std::underlying_type_t<Type>(value));
+    } else if constexpr (std::is_integral_v<Type>) {
+      bool is_negative = false;
+      if constexpr (std::is_signed_v<Type>) {
+        is_negative = value < 0 && !std::strchr("xXuo", conversion);
+      }
+      if (conversion == 'c') {
+        char c = (char)value;
+        emit(out, spec, "", {&c, 1}, false);
+      } else if (is_floating_conversion) {
+        floating(out, spec, (double)value);
+      } else if (is_negative) {
+        integer(out, spec, 0 - (uint64_t)value, true);
+      } else {
+        integer(out, spec, std::make_unsigned_t<Type>(value), false);
+      }
+    } else if constexpr (std::is_floating_point_v<Type>) {
+      if (is_floating_conversion) {
+        floating(out, spec, value);
+      } else {
+        FlightFormatSpec general = spec;
+        general.conversion = 'g';
+        floating(out, general, value);
+      }
+    } else if constexpr (std::is_pointer_v<Type>) {
+      FlightFormatSpec pointer = spec;
+      pointer.conversion = 'p';
+      integer(out, pointer, (uintptr_t)value, false);
+    } else {
+      emit(out, spec, "", "<?>", false);
+    }
+  }
+
+  template <typename... Values>
+  static void format(FlightText &out, const char *format,
+                     const Values &...values) {
+    FlightFormatSpec spec;
+    [[maybe_unused]] auto format_value = [&](const auto &value) {
+      if (format && (format = next(out, format, spec))) {
+        FlightFormatter::value(out, spec, value);
+      }
+    };
+    (format_value(values), ...);
+    while (format && (format = next(out, format, spec))) {
+    }
+  }
+};
+
+struct FlightRecordContent {
+  static constexpr size_t payload_capacity = 220;
+  int64_t timestamp;
+  void (*render)(const FlightRecordContent &content, FlightText &out);
+  MessageLevel level;
+  // Fixed-size arguments, then the NUL-terminated format, then the bytes of
+  // string arguments.
+  std::byte payload[payload_capacity];
+};
+
+struct alignas(64) FlightRecord {
+  std::atomic_uint64_t sequence;
+  FlightRecordContent content;
+};
+
+static_assert(sizeof(FlightRecord) == 256);
+
+template <typename... Args>
+void renderFlightRecord(const FlightRecordContent &content, FlightText &out) {
+  constexpr size_t fixed_size = (FlightArgument<Args>::fixed_size + ... + 0);
+  [[maybe_unused]] const std::byte *cursor = content.payload;
+  const char *format = (const char *)content.payload + fixed_size;
+  [[maybe_unused]] const std::byte *string_cursor =
+      content.payload + fixed_size + std::strlen(format) + 1;
+  std::tuple<typename FlightArgument<Args>::decoded_type...> values{
+      FlightArgument<Args>::decode(cursor, string_cursor)...};
+  std::apply(
+      [&](auto &...values) { FlightFormatter::format(out, format, values...); },
+      values);
+}
+
+// Records whose arguments could not be stored keep their format verbatim.
+inline void renderUnrecordedArguments(const FlightRecordContent &content,
+                                      FlightText &out) {
+  out.append((const char *)content.payload);
+  out.append(" [arguments not recorded]");
+}
+
+inline void writeAll(int fd, std::string_view text) noexcept {
+  while (!text.empty()) {
+    ssize_t written = ::write(fd, text.data(), text.size());
+    if (written <= 0) {
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    text.remove_prefix(written);
+  }
+}
+
+inline struct FlightRecorder {
+  static constexpr size_t record_count = 4096;
+  FlightRecord records[record_count];
+  alignas(64) std::atomic_uint64_t write_index = 0;
+  std::atomic_bool is_dumping = false;
+
+  // The format is copied along with the arguments, so it need not outlive
+  // the call. Records that do not fit keep only the format, truncated, so
+  // recording never formats or allocates.
+  template <typename... Args>
+  void record(MessageLevel level, const char *format, const Args &...args) {
+    constexpr size_t fixed_size = (FlightArgument<Args>::fixed_size + ... + 0);
+    if constexpr ((FlightArgument<Args>::is_recordable && ...) &&
+                  fixed_size < FlightRecordContent::payload_capacity) {
+      size_t format_size = std::strlen(format) + 1;
+      if (fixed_size + format_size <= FlightRecordContent::payload_capacity) {
+        [[likely]];
+        uint64_t index;
+        FlightRecord *slot = claim(index);
+        if (!slot) {
+          return;
+        }
+        FlightRecordContent &content = slot->content;
+        content.timestamp = time_manager.get_current_time();
+        content.render = &renderFlightRecord<Args...>;
+        content.level = level;
+        [[maybe_unused]] std::byte *cursor = content.payload;
+        std::memcpy(content.payload + fixed_size, format, format_size);
+        [[maybe_unused]] std::byte *string_cursor =
+            content.payload + fixed_size + format_size;
+        [[maybe_unused]] std::byte *end =
+            content.payload + FlightRecordContent::payload_capacity;
+        (FlightArgument<Args>::encode(cursor, string_cursor, end, args), ...);
+        publish(*slot, index);
+        return;
+      }
+    }
+    [[unlikely]];
+    record_format_only(level, format,
+                       sizeof...(Args) ? &renderUnrecordedArguments
+                                       : &renderFlightRecord<>);
+  }
+
+  // Claims the next slot for writing. A writer that lapped the ring may
+  // still be filling it, or a newer one may already own it; the record is
+  // then dropped rather than waiting.
+  FlightRecord *claim(uint64_t &index) {
+    index = write_index.fetch_add(1, std::memory_order_relaxed);
+    FlightRecord &slot = records[index % record_count];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) || sequence > index * 2 ||
+        !slot.sequence.compare_exchange_strong(sequence, index * 2 + 1,
+                                               std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return &slot;
+  }
+
+  void publish(FlightRecord &slot, uint64_t index) {
+    slot.sequence.store(index * 2 + 2, std::memory_order_release);
+  }
+
+  [[gnu::noinline]] void
+  record_format_only(MessageLevel level, const char *format,
+                     void (*render)(const FlightRecordContent &,
+                                    FlightText &)) {
+    uint64_t index;
+    FlightRecord *slot = claim(index);
+    if (!slot) {
+      return;
+    }
+    FlightRecordContent &content = slot->content;
+    content.timestamp = time_manager.get_current_time();
+    content.render = render;
+    content.level = level;
+    size_t format_size = std::min(std::strlen(format),
+                                  FlightRecordContent::payload_capacity - 1);
+    std::memcpy(content.payload, format, format_size);
+    content.payload[format_size] = std::byte{0};
+    publish(*slot, index);
+  }
+
+  // Async-signal-safe: formats into a stack buffer and writes with write(2).
+  [[gnu::cold]] void dump(int fd = STDERR_FILENO) noexcept {
+    if (is_dumping.exchange(true)) {
+      return;
+    }
+    uint64_t end_index = write_index.load(std::memory_order_acquire);
+    uint64_t begin_index =
+        end_index > record_count ? end_index - record_count : 0;
+    int64_t now = time_manager.get_current_time();
+    writeAll(fd, " -- TURBOKIT FLIGHT RECORDER --\n");
+    FlightRecordContent content;
+    char line[1024];
+    for (uint64_t index = begin_index; index != end_index; ++index) {
+      FlightRecord &slot = records[index % record_count];
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != index * 2 + 2) {
+        continue;
+      }
+      std::memcpy((void *)&content, (const void *)&slot.content,
+                  sizeof(content));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+        continue;
+      }
+      static constexpr const char *level_names[] = {"NONE", "ERROR", "INFO",
+                                                    "VERBOSE", "DEBUG"};
+      FlightText text{line, sizeof(line) - 1};
+      FlightFormatter::format(text, "[%+.3fms] %s: ",
+                              (content.timestamp - now) / 1e6,
+                              level_names[(int)content.level]);
+      content.render(content, text);
+      while (text.size && line[text.size - 1] == '\n') {
+        --text.size;
+      }
+      line[text.size++] = '\n';
+      writeAll(fd, {line, text.size});
+    }
+    writeAll(fd, " -- END OF FLIGHT RECORDER --\n");
+    is_dumping.store(false);
+  }
+} flightRecorder;
+
+inline constexpr int flightRecorderSignals[] = {SIGSEGV, SIGBUS, SIGILL,
+                                                SIGFPE, SIGABRT};
+// Handlers that were installed before ours, restored before re-raising so a
+// crash reporter or sanitizer runtime still sees the signal.
+inline struct sigaction
+    previousFlightRecorderActions[std::size(flightRecorderSignals)];
+
+inline void flightRecorderSignalHandler(int signal_number) {
+  flightRecorder.dump(STDERR_FILENO);
+  for (size_t i = 0; i != std::size(flightRecorderSignals); ++i) {
+    if (flightRecorderSignals[i] == signal_number) {
+      sigaction(signal_number, &previousFlightRecorderActions[i], nullptr);
+    }
+  }
+  raise(signal_number);
+}
+
+inline void installFlightRecorderSignalHandlers() {
+  struct sigaction action = {};
+  action.sa_handler = &flightRecorderSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESETHAND;
+  for (size_t i = 0; i != std::size(flightRecorderSignals); ++i) {
+    struct sigaction previous;
+    sigaction(flightRecorderSignals[i], &action, &previous);
+    // Installing twice must not make our own handler the "previous" one.
+    if (previous.sa_handler != &flightRecorderSignalHandler ||
+        (previous.sa_flags & SA_SIGINFO)) {
+      previousFlightRecorderActions[i] = previous;
+    }
+  }
+}
+
 inline struct MessageWriter {
   template <typename... Args> void error(const char *format, Args &&...args) {
+    flightRecorder.record(MSG_ERROR, format, args...);
     writeMessage(MSG_ERROR, format, std::forward<Args>(args)...);
   }
   template <typename... Args> void info(const char *format, Args &&...args) {
+    flightRecorder.record(MSG_INFO, format, args...);
     if (activeMessageLevel >= MSG_INFO) {
       [[unlikely]];
       writeMessage(MSG_INFO, format, std::forward<Args>(args)...);
     }
   }
   template <typename... Args> void verbose(const char *format, Args &&...args) {
+    flightRecorder.record(MSG_VERBOSE, format, args...);
     if (activeMessageLevel >= MSG_VERBOSE) {
       [[unlikely]];
       writeMessage(MSG_VERBOSE, format, std::forward<Args>(args)...);
     }
   }
   template <typename... Args> void debug(const char *format, Args &&...args) {
+    flightRecorder.record(MSG_DEBUG, format, args...);
     if (activeMessageLevel >= MSG_DEBUG) {
       [[unlikely]];
       writeMessage(MSG_DEBUG, format, std::forward<Args>(args)...);
@@ -75,11 +770,233 @@ inline struct MessageWriter {
   }
 } messageWriter;
 
+struct LogRateLimiter;
+
+// Writes the suppressed-message summaries that no later admitted message
+// carried, so the count at the end of a storm is still reported. Limiters
+// register on their first suppression; a thread started with the first
+// registration flushes them every report_interval.
+inline class LogSuppressionReporter {
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<LogRateLimiter *> limiters;
+  std::thread reporter;
+  bool stop_requested = false;
+
+  void run() {
+    std::unique_lock lock(mutex);
+    while (!stop_requested) {
+      condition.wait_for(lock, report_interval);
+      flush_locked();
+    }
+  }
+
+  void flush_locked();
+
+public:
+  static constexpr std::chrono::seconds report_interval{1};
+
+  LogSuppressionReporter() = default;
+  LogSuppressionReporter(const LogSuppressionReporter &) = delete;
+  LogSuppressionReporter &operator=(const LogSuppressionReporter &) = delete;
+  ~LogSuppressionReporter();
+
+  void add(LogRateLimiter *limiter) {
+    std::lock_guard lock(mutex);
+    limiters.push_back(limiter);
+    if (!reporter.joinable() && !stop_requested) {
+      reporter = std::thread([this] { run(); });
+    }
+  }
+
+  void remove(LogRateLimiter *limiter) {
+    std::lock_guard lock(mutex);
+    limiters.erase(std::remove(limiters.begin(), limiters.end(), limiter),
+                   limiters.end());
+  }
+
+  void flush() {
+    std::lock_guard lock(mutex);
+    flush_locked();
+  }
+} logSuppressionReporter;
+
+struct LogRateLimiter {
+  static constexpr int64_t max_interval =
+      std::numeric_limits<int64_t>::max() / 4;
+
+  // Nanoseconds between messages, or -1 when every message is dropped.
+  static int64_t emissionInterval(double messages_per_second) {
+    if (!(messages_per_second > 0)) {
+      return -1;
+    }
+    return (int64_t)std::min<double>(1e9 / messages_per_second, max_interval);
+  }
+
+  int64_t emission_interval;
+  int64_t burst_tolerance;
+  const char *file;
+  int line;
+  alignas(64) std::atomic_int64_t theoretical_arrival_time = 0;
+  std::atomic_uint64_t suppressed_count = 0;
+  std::atomic_bool is_registered = false;
+  MessageLevel suppressed_level = MSG_ERROR;
+
+  // A rate of zero or less (or NaN) drops every message; the drops are
+  // still counted and reported. Intervals are clamped so that arrival times
+  // cannot overflow for tiny rates.
+  LogRateLimiter(double messages_per_second, uint32_t burst,
+                 const char *file = "", int line = 0)
+      : emission_interval(emissionInterval(messages_per_second)),
+        burst_tolerance(
+            emission_interval < 0
+                ? 0
+                : (int64_t)std::min<double>(
+                      (double)emission_interval * (burst ? burst - 1 : 0),
+                      max_interval)),
+        file(file), line(line) {}
+  LogRateLimiter(const LogRateLimiter &) = delete;
+  LogRateLimiter &operator=(const LogRateLimiter &) = delete;
+  ~LogRateLimiter() {
+    if (is_registered.load()) {
+      logSuppressionReporter.remove(this);
+    }
+  }
+
+  bool try_acquire() {
+    if (emission_interval < 0) {
+      return false;
+    }
+    int64_t now = time_manager.get_current_time();
+    int64_t arrival_time =
+        theoretical_arrival_time.load(std::memory_order_relaxed);
+    // A failed exchange reloads arrival_time; retry while budget remains so
+    // contention alone never drops a message.
+    do {
+      if (arrival_time - now > burst_tolerance) {
+        return false;
+      }
+    } while (!theoretical_arrival_time.compare_exchange_weak(
+        arrival_time, std::max(arrival_time, now) + emission_interval,
+        std::memory_order_relaxed));
+    return true;
+  }
+
+  void suppress(MessageLevel level) {
+    suppressed_count.fetch_add(1, std::memory_order_relaxed);
+    if (!is_registered.load(std::memory_order_relaxed)) {
+      [[unlikely]];
+      if (!is_registered.exchange(true)) {
+        suppressed_level = level;
+        logSuppressionReporter.add(this);
+      }
+    }
+  }
+
+  void report_suppressed(MessageLevel level) {
+    uint64_t suppressed =
+        suppressed_count.exchange(0, std::memory_order_relaxed);
+    if (suppressed) {
+      writeMessage(level, "suppressed %llu messages from %s:%d",
+                   (unsigned long long)suppressed, file, line);
+    }
+  }
+};
+
+inline void LogSuppressionReporter::flush_locked() {
+  for (LogRateLimiter *limiter : limiters) {
+    limiter->report_suppressed(limiter->suppressed_level);
+  }
+}
+
+inline LogSuppressionReporter::~LogSuppressionReporter() {
+  std::thread finished_reporter;
+  {
+    std::lock_guard lock(mutex);
+    stop_requested = true;
+    finished_reporter = std::move(reporter);
+    // Limiters that outlive the reporter must not unregister from it.
+    for (LogRateLimiter *limiter : limiters) {
+      limiter->is_registered.store(false);
+    }
+    limiters.clear();
+  }
+  condition.notify_all();
+  if (finished_reporter.joinable()) {
+    finished_reporter.join();
+  }
+}
+
+// Writes pending suppressed-message summaries now instead of waiting for the
+// reporter thread.
+inline void flushSuppressedMessages() { logSuppressionReporter.flush(); }
+
+inline bool isMessageLevelEnabled(MessageLevel level) {
+  return level == MSG_ERROR || activeMessageLevel >= level;
+}
+
+template <typename... Args>
+bool writeRateLimited(LogRateLimiter &limiter, MessageLevel level,
+                      const char *format, Args &&...args) {
+  flightRecorder.record(level, format, args...);
+  if (!isMessageLevelEnabled(level)) {
+    return false;
+  }
+  if (!limiter.try_acquire()) {
+    limiter.suppress(level);
+    return false;
+  }
+  [[unlikely]];
+  limiter.report_suppressed(level);
+  writeMessage(level, format, std::forward<Args>(args)...);
+  return true;
+}
+
+// Writes one in `period` calls sharing `counter`; a period of 0 writes every
+// call.
+template <typename... Args>
+bool writeSampled(std::atomic_uint32_t &counter, uint32_t period,
+                  MessageLevel level, const char *format, Args &&...args) {
+  flightRecorder.record(level, format, args...);
+  if (!isMessageLevelEnabled(level) ||
+      counter.fetch_add(1, std::memory_order_relaxed) %
+              std::max<uint32_t>(period, 1) !=
+          0) {
+    return false;
+  }
+  [[unlikely]];
+  writeMessage(level, format, std::forward<Args>(args)...);
+  return true;
+}
+
+#define TURBOKIT_LOG_RATE_LIMITED(level, messages_per_second, burst, ...)      \
+  do {                                                                         \
+    static ::turbokit::LogRateLimiter turbokit_log_rate_limiter(               \
+        messages_per_second, burst, __FILE__, __LINE__);                       \
+    ::turbokit::writeRateLimited(turbokit_log_rate_limiter, level,             \
+                                 __VA_ARGS__);                                 \
+  } while (0)
+
+#define TURBOKIT_LOG_SAMPLED(level, period, ...)                               \
+  do {                                                                         \
+    static ::std::atomic_uint32_t turbokit_log_sample_counter = 0;             \
+    ::turbokit::writeSampled(turbokit_log_sample_counter, period, level,       \
+                             __VA_ARGS__);                                     \
+  } while (0)
+
+#define TURBOKIT_ERROR_RATE_LIMITED(messages_per_second, burst, ...)           \
+  TURBOKIT_LOG_RATE_LIMITED(::turbokit::MSG_ERROR, messages_per_second, burst, \
+                            __VA_ARGS__)
+
+#define TURBOKIT_ERROR_SAMPLED(period, ...)                                    \
+  TURBOKIT_LOG_SAMPLED(::turbokit::MSG_ERROR, period, __VA_ARGS__)
+
 template <typename... Args>
 [[noreturn]] [[gnu::cold]] void criticalError(const char *format,
                                               Args &&...args) {
   auto error_message = fmt::sprintf(format, std::forward<Args>(args)...);
   messageWriter.error(" -- TURBOKIT FATAL ERROR --\n%s\n", error_message);
+  flightRecorder.dump();
   std::quick_exit(1);
 }
 
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "logging.h"
+#include "stopwatch.h"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+namespace turbokit {
+
+struct PerfEventType {
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr size_t perf_counter_count = 4;
+
+constexpr std::array<PerfEventType, perf_counter_count> defaultPerfEvents = {{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+}};
+
+struct PerfCounterValues {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t cache_misses = 0;
+  uint64_t branch_misses = 0;
+
+  uint64_t &operator[](size_t index) {
+    uint64_t *values[] = {&cycles, &instructions, &cache_misses,
+                          &branch_misses};
+    return *values[index];
+  }
+
+  PerfCounterValues &operator+=(const PerfCounterValues &other) {
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cache_misses += other.cache_misses;
+    branch_misses += other.branch_misses;
+    return *this;
+  }
+
+  PerfCounterValues operator-(const PerfCounterValues &other) const {
+    PerfCounterValues result;
+    result.cycles = cycles - other.cycles;
+    result.instructions = instructions - other.instructions;
+    result.cache_misses = cache_misses - other.cache_misses;
+    result.branch_misses = branch_misses - other.branch_misses;
+    return result;
+  }
+
+  double instructions_per_cycle() const {
+    return cycles ? (double)instructions / cycles : 0.0;
+  }
+};
+
+inline std::atomic_bool perfUnavailableReported = false;
+
+class PerfCounters {
+  std::array<int, perf_counter_count> descriptors;
+  std::array<perf_event_mmap_page *, perf_counter_count> pages;
+  std::array<uint64_t, perf_counter_count> identifiers = {};
+  int group_descriptor = -1;
+  size_t open_count = 0;
+
+  static int openEvent(const PerfEventType &event, int group) {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = event.type;
+    attributes.config = event.config;
+    attributes.disabled = group == -1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                             PERF_FORMAT_TOTAL_TIME_ENABLED |
+                             PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0);
+  }
+
+  // Reads a counter in user space. Counters that have been multiplexed
+  // (time_running behind time_enabled) are left to read_group(), which
+  // scales them, so both paths report the same values.
+  static bool read_rdpmc(perf_event_mmap_page *page, uint64_t &value) {
+    uint32_t sequence;
+    uint64_t count;
+    do {
+      sequence = page->lock;
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+      uint32_t index = page->index;
+      uint16_t width = page->pmc_width;
+      if (!page->cap_user_rdpmc || index == 0 || width == 0 || width > 64 ||
+          page->time_running != page->time_enabled) {
+        return false;
+      }
+      int64_t offset = page->offset;
+      uint64_t raw = __rdpmc(index - 1);
+      raw <<= 64 - width;
+      count = offset + (int64_t(raw) >> (64 - width));
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    } while (page->lock != sequence);
+    value = count;
+    return true;
+  }
+
+public:
+  explicit PerfCounters(
+      const std::array<PerfEventType, perf_counter_count> &events =
+          defaultPerfEvents) {
+    descriptors.fill(-1);
+    pages.fill(nullptr);
+    int first_error = 0;
+    for (size_t i = 0; i != perf_counter_count; ++i) {
+      int descriptor = openEvent(events[i], group_descriptor);
+      if (descriptor < 0) {
+        first_error = first_error ? first_error : errno;
+        continue;
+      }
+      descriptors[i] = descriptor;
+      if (group_descriptor == -1) {
+        group_descriptor = descriptor;
+      }
+      ioctl(descriptor, PERF_EVENT_IOC_ID, &identifiers[i]);
+      void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED,
+                        descriptor, 0);
+      if (page != MAP_FAILED) {
+        pages[i] = (perf_event_mmap_page *)page;
+      }
+      ++open_count;
+    }
+    if (first_error && !perfUnavailableReported.exchange(true)) {
+      messageWriter.verbose("perf_event_open unavailable for %zu of %zu "
+                            "counters: %s",
+                            perf_counter_count - open_count,
+                            perf_counter_count, std::strerror(first_error));
+    }
+    if (group_descriptor != -1) {
+      ioctl(group_descriptor, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(group_descriptor, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+
+  ~PerfCounters() {
+    for (size_t i = 0; i != perf_counter_count; ++i) {
+      if (pages[i]) {
+        munmap(pages[i], sysconf(_SC_PAGESIZE));
+      }
+      if (descriptors[i] != -1) {
+        close(descriptors[i]);
+      }
+    }
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool is_available() const { return open_count != 0; }
+  bool is_available(size_t index) const { return descriptors[index] != -1; }
+
+  PerfCounterValues read() {
+    PerfCounterValues result;
+    if (!open_count) {
+      return result;
+    }
+    bool complete = true;
+    for (size_t i = 0; i != perf_counter_count && complete; ++i) {
+      if (descriptors[i] != -1) {
+        complete = pages[i] && read_rdpmc(pages[i], result[i]);
+      }
+    }
+    if (complete) {
+      [[likely]];
+      return result;
+    }
+    return read_group();
+  }
+
+  [[gnu::noinline]] PerfCounterValues read_group() {
+    PerfCounterValues result;
+    uint64_t buffer[3 + 2 * perf_counter_count];
+    ssize_t size = ::read(group_descriptor, buffer, sizeof(buffer));
+    if (size < (ssize_t)(3 * sizeof(uint64_t))) {
+      return result;
+    }
+    uint64_t value_count = buffer[0];
+    uint64_t time_enabled = buffer[1];
+    uint64_t time_running = buffer[2];
+    for (uint64_t j = 0; j != value_count && j != perf_counter_count; ++j) {
+      uint64_t value = buffer[3 + 2 * j];
+      uint64_t identifier = buffer[4 + 2 * j];
+      if (time_running && time_running < time_enabled) {
+        value = (uint64_t)((unsigned __int128)value * time_enabled /
+                           time_running);
+      }
+      for (size_t i = 0; i != perf_counter_count; ++i) {
+        if (descriptors[i] != -1 && identifiers[i] == identifier) {
+          result[i] = value;
+        }
+      }
+    }
+    return result;
+  }
+
+  static PerfCounters &local() {
+    thread_local PerfCounters counters;
+    return counters;
+  }
+};
+
+struct PerfStopwatch {
+  PerfCounters &counters;
+  CycleStopwatch stopwatch;
+  PerfCounterValues start_values;
+  PerfCounterValues total_values;
+
+  explicit PerfStopwatch(PerfCounters &counters = PerfCounters::local())
+      : counters(counters) {}
+
+  void start() {
+    start_values = counters.read();
+    stopwatch.start();
+  }
+
+  int64_t stop() {
+    int64_t cycles = stopwatch.stop();
+    total_values += counters.read() - start_values;
+    return cycles;
+  }
+
+  void reset() {
+    stopwatch.reset();
+    total_values = PerfCounterValues();
+  }
+
+  bool is_available() const { return counters.is_available(); }
+  const PerfCounterValues &values() const { return total_values; }
+  int64_t elapsed_nanoseconds() const {
+    return stopwatch.elapsed_nanoseconds();
+  }
+};
+
+class ScopedPerfTimer {
+  PerfStopwatch &stopwatch;
+
+public:
+  explicit ScopedPerfTimer(PerfStopwatch &stopwatch) : stopwatch(stopwatch) {
+    stopwatch.start();
+  }
+  ~ScopedPerfTimer() { stopwatch.stop(); }
+
+  ScopedPerfTimer(const ScopedPerfTimer &) = delete;
+  ScopedPerfTimer &operator=(const ScopedPerfTimer &) = delete;
+};
+
+} // namespace turbokit
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "buffer.h"
+#include "crc32c.h"
 #include "hash_map.h"
 #include "simple_vector.h"
+#include "span.h"
 #include "vector.h"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstring>
 #include <map>
@@ -33,6 +37,31 @@ struct DataFormatError : std::runtime_error {
   using std::runtime_error::runtime_error;
 };
 
+// Borrowed views (Span<T>, std::basic_string_view<T>) hand out references
+// into the input, so their elements must sit at an address aligned for the
+// element type. The format adds no padding, so a view of elements wider than
+// one byte throws DataFormatError whenever earlier fields leave it
+// misaligned, even on valid input; such fields are read into an owning
+// container instead.
+inline void check_borrow_alignment(const void *data, size_t alignment) {
+  if ((uintptr_t)data % alignment != 0) {
+    throw DataFormatError(
+        "borrowed view elements are not aligned in the input buffer");
+  }
+}
+
+template <typename Type> Span<Type> borrow_span(const void *data, size_t size) {
+  check_borrow_alignment(data, alignof(Type));
+  return Span<Type>((Type *)data, size);
+}
+
+template <typename Type>
+std::basic_string_view<Type>
+borrow_string_view(std::basic_string_view<Type> view) {
+  check_borrow_alignment(view.data(), alignof(Type));
+  return view;
+}
+
 template <typename Context, typename First, typename Second>
 void serialize(Context &context, const std::pair<First, Second> &pair) {
   context(pair.first, pair.second);
@@ -63,7 +92,7 @@ void serialize(Context &context, std::optional<Type> &optional) {
 
 template <typename Context, typename... Types>
 void serialize(Context &context, const std::variant<Types...> &variant) {
-  context(variant.index());
+  context(uint64_t(variant.index()));
   std::visit([&](auto &value) { context(value); }, variant);
 }
 
@@ -82,7 +111,7 @@ void deserialize_variant_helper(size_t variant_index, Context &context,
 
 template <typename Context, typename... Types>
 void serialize(Context &context, std::variant<Types...> &variant) {
-  size_t variant_index = context.template read<size_t>();
+  size_t variant_index = context.template read<uint64_t>();
   deserialize_variant_helper<0, Context, std::variant<Types...>, Types...>(
       variant_index, context, variant);
 }
@@ -100,11 +129,39 @@ void serialize(Context &context, std::tuple<Types...> &tuple) {
              tuple);
 }
 
+template <typename Container>
+auto container_data(Container &container) -> decltype(container.get_data()) {
+  return container.get_data();
+}
+
+template <typename Container>
+auto container_data(Container &container) -> decltype(container.data()) {
+  return container.data();
+}
+
+template <typename Container, typename = void>
+struct is_contiguous_container : std::false_type {};
+
+template <typename Container>
+struct is_contiguous_container<
+    Container,
+    std::void_t<decltype(container_data(std::declval<Container &>()))>>
+    : std::true_type {};
+
 template <typename Context, typename Container>
 void serialize_container(Context &context, const Container &container) {
-  context(container.size());
-  for (auto &item : container) {
-    context(item);
+  using ElementType = typename Container::value_type;
+  if constexpr (std::is_trivial_v<ElementType> &&
+                is_contiguous_container<const Container>::value &&
+                !serialize_detector<Context>::template has_serialize<
+                    ElementType>) {
+    context(std::basic_string_view<ElementType>(container_data(container),
+                                                container.size()));
+  } else {
+    context(uint64_t(container.size()));
+    for (auto &item : container) {
+      context(item);
+    }
   }
 }
 
@@ -112,15 +169,12 @@ template <typename Context, typename Container>
 void serialize_container(Context &context, Container &container) {
   using ElementType = typename Container::value_type;
   if constexpr (std::is_trivial_v<ElementType> &&
+                is_contiguous_container<Container>::value &&
                 !serialize_detector<Context>::template has_serialize<
                     ElementType>) {
-    std::basic_string_view<ElementType> view;
-    context(view);
-    container.resize(view.size());
-    std::memcpy(container.data(), view.data(),
-                sizeof(ElementType) * view.size());
+    context.read_elements(container);
   } else {
-    size_t count = context.template read<size_t>();
+    size_t count = context.template read<uint64_t>();
     container.resize(count);
     for (size_t i = 0; i != count; ++i) {
       context(container[i]);
@@ -158,9 +212,75 @@ void serialize(Context &context, SimpleVector<Type> &vector) {
   serialize_container(context, vector);
 }
 
+template <typename Context, typename Type>
+void serialize(Context &context, const Span<Type> &span) {
+  serialize_container(context, span);
+}
+
+// Readers that know the source slice borrow BufferSlice fields from it; any
+// other reader copies the bytes into a new block.
+template <typename Context>
+void serialize(Context &context, const BufferSlice &slice) {
+  context(slice.view());
+}
+
+template <typename Context>
+void serialize(Context &context, BufferSlice &slice) {
+  std::string_view bytes;
+  context(bytes);
+  BufferHandle block = makeBuffer(bytes.size());
+  std::memcpy(block->get_data(), bytes.data(), bytes.size());
+  slice = BufferSlice(std::move(block));
+}
+
+// Fixed size arrays carry no length prefix. C arrays and std::arrays of
+// trivial types are written in bulk from the caller's storage, never copied
+// by value, so large arrays do not land on the stack.
+template <typename Context, typename Type, size_t Size>
+void serialize(Context &context, const Type (&array)[Size]) {
+  if constexpr (std::is_trivial_v<Type> &&
+                !serialize_detector<Context>::template has_serialize<Type>) {
+    context.write_elements(array, Size);
+  } else {
+    for (auto &item : array) {
+      context(item);
+    }
+  }
+}
+
+template <typename Context, typename Type, size_t Size>
+void serialize(Context &context, Type (&array)[Size]) {
+  for (auto &item : array) {
+    context(item);
+  }
+}
+
+template <typename Type> struct is_std_array : std::false_type {};
+template <typename Type, size_t Size>
+struct is_std_array<std::array<Type, Size>> : std::true_type {};
+
+template <typename Context, typename Type, size_t Size>
+void serialize(Context &context, const std::array<Type, Size> &array) {
+  if constexpr (std::is_trivial_v<Type> &&
+                !serialize_detector<Context>::template has_serialize<Type>) {
+    context.write_elements(array.data(), Size);
+  } else {
+    for (auto &item : array) {
+      context(item);
+    }
+  }
+}
+
+template <typename Context, typename Type, size_t Size>
+void serialize(Context &context, std::array<Type, Size> &array) {
+  for (auto &item : array) {
+    context(item);
+  }
+}
+
 template <typename Context, typename MapType>
 void serialize_map(Context &context, const MapType &map) {
-  context(map.size());
+  context(uint64_t(map.size()));
   for (auto &entry : map) {
     context(entry.first, entry.second);
   }
@@ -169,7 +289,7 @@ void serialize_map(Context &context, const MapType &map) {
 template <typename Context, typename MapType>
 void serialize_map(Context &context, MapType &map) {
   map.clear();
-  size_t count = context.template read<size_t>();
+  size_t count = context.template read<uint64_t>();
   for (; count; --count) {
     auto key = context.template read<typename MapType::key_type>();
     map.emplace(std::move(key),
@@ -212,6 +332,59 @@ struct SizeOperation {};
 struct WriteOperation {};
 struct ReadOperation {};
 
+constexpr bool host_is_little_endian =
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+template <size_t Size>
+using unsigned_of_size = std::conditional_t<
+    Size == 1, uint8_t,
+    std::conditional_t<Size == 2, uint16_t,
+                       std::conditional_t<Size == 4, uint32_t, uint64_t>>>;
+
+template <typename Unsigned> Unsigned byte_swap(Unsigned value) {
+  if constexpr (sizeof(Unsigned) == 2) {
+    return __builtin_bswap16(value);
+  } else if constexpr (sizeof(Unsigned) == 4) {
+    return __builtin_bswap32(value);
+  } else if constexpr (sizeof(Unsigned) == 8) {
+    return __builtin_bswap64(value);
+  } else {
+    return value;
+  }
+}
+
+// Reverses the bytes of each element. A plain loop over fixed-width lanes,
+// which the compiler turns into vector byte shuffles at -O3.
+template <typename Type>
+void byte_swap_elements(void *__restrict destination,
+                        const void *__restrict source, size_t count) {
+  using Unsigned = unsigned_of_size<sizeof(Type)>;
+  static_assert(sizeof(Unsigned) == sizeof(Type));
+  for (size_t i = 0; i != count; ++i) {
+    Unsigned value;
+    std::memcpy(&value, (const std::byte *)source + i * sizeof(Type),
+                sizeof(Type));
+    value = byte_swap(value);
+    std::memcpy((std::byte *)destination + i * sizeof(Type), &value,
+                sizeof(Type));
+  }
+}
+
+template <typename Type>
+void store_little_endian(void *destination, const void *source,
+                         size_t count) {
+  if constexpr (host_is_little_endian || sizeof(Type) == 1) {
+    std::memcpy(destination, source, sizeof(Type) * count);
+  } else {
+    byte_swap_elements<Type>(destination, source, count);
+  }
+}
+
+template <typename Type>
+void load_little_endian(void *destination, const void *source, size_t count) {
+  store_little_endian<Type>(destination, source, count);
+}
+
 // This is not a cross platform serializer
 struct DataWriter {
   std::byte *write(SizeOperation, std::byte *destination,
@@ -232,16 +405,25 @@ struct DataWriter {
         write(Operation{}, destination, (void *)&value, sizeof(value));
     return destination;
   }
+  template <typename Operation, typename Type>
+  std::byte *write_elements(Operation, std::byte *destination,
+                            const Type *source, size_t count) {
+    return write(Operation{}, destination, source, sizeof(Type) * count);
+  }
+  template <typename Operation>
+  std::byte *write_length(Operation, std::byte *destination, size_t length) {
+    return write(Operation{}, destination, length);
+  }
   template <typename Operation>
   std::byte *write(Operation, std::byte *destination, std::string_view string) {
-    destination = write(Operation{}, destination, string.size());
+    destination = write_length(Operation{}, destination, string.size());
     destination = write(Operation{}, destination, string.data(), string.size());
     return destination;
   }
   template <typename Operation, typename Type>
   std::byte *write(Operation, std::byte *destination,
                    std::basic_string_view<Type> string) {
-    destination = write(Operation{}, destination, string.size());
+    destination = write_length(Operation{}, destination, string.size());
     destination = write(Operation{}, destination, string.data(),
                         sizeof(Type) * string.size());
     return destination;
@@ -262,7 +444,7 @@ struct DataReader {
   }
   template <typename Type> std::basic_string_view<Type> read_string_view() {
     size_t length = read<size_t>();
-    if (buffer.size() < sizeof(Type) * length) {
+    if (length > buffer.size() / sizeof(Type)) {
       end_of_data();
     }
     Type *data = (Type *)buffer.data();
@@ -290,7 +472,20 @@ struct DataReader {
   void read(std::string_view &result) { result = read_string(); }
   void read(std::string &result) { result = read_string(); }
   template <typename Type> void read(std::basic_string_view<Type> &result) {
-    result = read_string_view<Type>();
+    result = borrow_string_view(read_string_view<Type>());
+  }
+  template <typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  void read(Span<Type> &result) {
+    auto view = read_string_view<std::remove_const_t<Type>>();
+    result = borrow_span<Type>(view.data(), view.size());
+  }
+  template <typename Container> void read_elements(Container &container) {
+    using Type = typename Container::value_type;
+    auto view = read_string_view<Type>();
+    container.resize(view.size());
+    std::memcpy(container_data(container), view.data(),
+                sizeof(Type) * view.size());
   }
 
   template <typename Type> Type read() {
@@ -303,7 +498,366 @@ struct DataReader {
   bool empty() { return buffer.empty(); }
 };
 
-template <typename Operation> struct SerializeContext {
+template <typename Type> constexpr bool isCompactInteger() {
+  if constexpr (std::is_enum_v<Type>) {
+    return isCompactInteger<std::underlying_type_t<Type>>();
+  } else {
+    return std::is_integral_v<Type> && sizeof(Type) > 1;
+  }
+}
+
+// Opt-in compact format: integers wider than a byte and all lengths are
+// LEB128 varints, signed values zigzag encoded. Everything else matches
+// DataWriter.
+struct CompactDataWriter {
+  static size_t varint_size(uint64_t value) {
+    return 1 + (63 - __builtin_clzll(value | 1)) / 7;
+  }
+  std::byte *write_varint(SizeOperation, std::byte *destination,
+                          uint64_t value) {
+    return write(SizeOperation{}, destination, nullptr, varint_size(value));
+  }
+  std::byte *write_varint(WriteOperation, std::byte *destination,
+                          uint64_t value) {
+    while (value >= 0x80) {
+      *destination++ = std::byte(value | 0x80);
+      value >>= 7;
+    }
+    *destination++ = std::byte(value);
+    return destination;
+  }
+  template <typename Operation>
+  std::byte *write(Operation, std::byte *destination, const void *source,
+                   size_t length) {
+    return DataWriter{}.write(Operation{}, destination, source, length);
+  }
+  template <typename Operation, typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  std::byte *write(Operation, std::byte *destination, Type value) {
+    if constexpr (std::is_enum_v<Type>) {
+      return write(Operation{}, destination,
+                   (std::underlying_type_t<Type>)value);
+    } else if constexpr (isCompactInteger<Type>() && std::is_signed_v<Type>) {
+      int64_t extended = value;
+      uint64_t zigzag = ((uint64_t)extended << 1) ^ (uint64_t)(extended >> 63);
+      return write_varint(Operation{}, destination, zigzag);
+    } else if constexpr (isCompactInteger<Type>()) {
+      return write_varint(Operation{}, destination, value);
+    } else {
+      return write(Operation{}, destination, (void *)&value, sizeof(value));
+    }
+  }
+  template <typename Operation, typename Type>
+  std::byte *write_elements(Operation, std::byte *destination,
+                            const Type *source, size_t count) {
+    return write(Operation{}, destination, source, sizeof(Type) * count);
+  }
+  template <typename Operation>
+  std::byte *write_length(Operation, std::byte *destination, size_t length) {
+    return write_varint(Operation{}, destination, length);
+  }
+  template <typename Operation, typename Type>
+  std::byte *write(Operation, std::byte *destination,
+                   std::basic_string_view<Type> string) {
+    destination = write_length(Operation{}, destination, string.size());
+    return write(Operation{}, destination, string.data(),
+                 sizeof(Type) * string.size());
+  }
+  template <typename Operation>
+  std::byte *write(Operation, std::byte *destination, std::string_view string) {
+    return write<Operation, char>(Operation{}, destination, string);
+  }
+};
+
+struct CompactDataReader : DataReader {
+  using DataReader::DataReader;
+
+  // Decodes varints of up to 8 bytes (values below 2^56) from one unaligned
+  // load: the first clear continuation bit gives the length, and the 7-bit
+  // groups are packed together with three mask-and-shift steps.
+  [[gnu::always_inline]] uint64_t read_varint() {
+    if (buffer.size() >= sizeof(uint64_t)) {
+      [[likely]];
+      uint64_t word;
+      std::memcpy(&word, buffer.data(), sizeof(word));
+      uint64_t terminators = ~word & 0x8080808080808080ull;
+      if (terminators) {
+        [[likely]];
+        int last_bit = __builtin_ctzll(terminators);
+        if (last_bit > 7 && !((word >> (last_bit - 7)) & 0xff)) {
+          [[unlikely]];
+          return read_varint_slow();
+        }
+        uint64_t value =
+            word & (~uint64_t(0) >> (63 - last_bit)) & 0x7f7f7f7f7f7f7f7full;
+        value = ((value & 0x7f007f007f007f00ull) >> 1) |
+                (value & 0x007f007f007f007full);
+        value = ((value & 0x3fff00003fff0000ull) >> 2) |
+                (value & 0x00003fff00003fffull);
+        value = ((value & 0x0fffffff00000000ull) >> 4) |
+                (value & 0x000000000fffffffull);
+        advance(last_bit / 8 + 1);
+        return value;
+      }
+    }
+    return read_varint_slow();
+  }
+  // Only the canonical (shortest) encoding of each value is accepted.
+  uint64_t read_varint_slow() {
+    uint64_t value = 0;
+    for (size_t i = 0; i != 10; ++i) {
+      if (i == buffer.size()) {
+        end_of_data();
+      }
+      uint8_t byte = (uint8_t)buffer[i];
+      if (i == 9 && byte > 1) {
+        throw DataFormatError("CompactDataReader: varint overflows 64 bits");
+      }
+      value |= uint64_t(byte & 0x7f) << (7 * i);
+      if (!(byte & 0x80)) {
+        if (i && !byte) {
+          throw DataFormatError("CompactDataReader: varint is not canonical");
+        }
+        advance(i + 1);
+        return value;
+      }
+    }
+    throw DataFormatError("CompactDataReader: varint is too long");
+  }
+  size_t read_length(size_t element_size) {
+    uint64_t length = read_varint();
+    if (buffer.size() / element_size < length) {
+      end_of_data();
+    }
+    return length;
+  }
+  template <typename Type> std::basic_string_view<Type> read_string_view() {
+    size_t length = read_length(sizeof(Type));
+    Type *data = (Type *)buffer.data();
+    advance(sizeof(Type) * length);
+    return {data, length};
+  }
+  std::string_view read_string() { return read_string_view<char>(); }
+  template <typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  void read(Type &result) {
+    if constexpr (std::is_enum_v<Type>) {
+      std::underlying_type_t<Type> value;
+      read(value);
+      result = (Type)value;
+    } else if constexpr (isCompactInteger<Type>()) {
+      uint64_t value = read_varint();
+      if constexpr (std::is_signed_v<Type>) {
+        value = (value >> 1) ^ (0 - (value & 1));
+        if ((int64_t)value != (int64_t)(Type)value) {
+          throw DataFormatError("CompactDataReader: integer out of range");
+        }
+      } else if (value != (uint64_t)(Type)value) {
+        throw DataFormatError("CompactDataReader: integer out of range");
+      }
+      result = (Type)value;
+    } else {
+      DataReader::read(result);
+    }
+  }
+  void read(std::string_view &result) { result = read_string(); }
+  void read(std::string &result) { result = read_string(); }
+  template <typename Type> void read(std::basic_string_view<Type> &result) {
+    result = borrow_string_view(read_string_view<Type>());
+  }
+  template <typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  void read(Span<Type> &result) {
+    auto view = read_string_view<std::remove_const_t<Type>>();
+    result = borrow_span<Type>(view.data(), view.size());
+  }
+  template <typename Container> void read_elements(Container &container) {
+    using Type = typename Container::value_type;
+    auto view = read_string_view<Type>();
+    container.resize(view.size());
+    std::memcpy(container_data(container), view.data(),
+                sizeof(Type) * view.size());
+  }
+  template <typename Type> Type read() {
+    Type result;
+    read(result);
+    return result;
+  }
+  std::string_view read() { return read_string(); }
+};
+
+template <typename Type> constexpr bool isPortableScalar() {
+  return std::is_enum_v<Type> || std::is_integral_v<Type> ||
+         std::is_same_v<Type, float> || std::is_same_v<Type, double>;
+}
+
+// Wire representation of a scalar in the portable format. long and unsigned
+// long change width between platforms, so they always travel as 64 bits.
+// Other types keep their own width, so portable fields must use the
+// fixed-width <cstdint> types. size_t, ptrdiff_t and intptr_t fields are not
+// portable: they are unsigned long (8 bytes) on LP64 but unsigned int
+// (4 bytes) on ILP32 peers. Only lengths are always 64 bits.
+template <typename Type> auto portable_value(Type value) {
+  if constexpr (std::is_enum_v<Type>) {
+    return portable_value((std::underlying_type_t<Type>)value);
+  } else if constexpr (std::is_same_v<Type, long>) {
+    return (int64_t)value;
+  } else if constexpr (std::is_same_v<Type, unsigned long>) {
+    return (uint64_t)value;
+  } else {
+    return value;
+  }
+}
+
+template <typename Type>
+using portable_type = decltype(portable_value(std::declval<Type>()));
+
+// Portable format: scalars are fixed-width little-endian, every length is a
+// 64-bit count and trivial aggregates need a serialize method. On
+// little-endian hosts scalar arrays are still a single memcpy; elsewhere
+// they are byte swapped in bulk.
+struct PortableDataWriter {
+  template <typename Operation>
+  std::byte *write(Operation, std::byte *destination, const void *source,
+                   size_t length) {
+    return DataWriter{}.write(Operation{}, destination, source, length);
+  }
+  template <typename Operation, typename Type,
+            std::enable_if_t<isPortableScalar<Type>()> * = nullptr>
+  std::byte *write_elements(Operation, std::byte *destination,
+                            const Type *source, size_t count) {
+    using Wire = portable_type<Type>;
+    if constexpr (std::is_same_v<Operation, SizeOperation>) {
+      return write(Operation{}, destination, nullptr, sizeof(Wire) * count);
+    } else if constexpr (sizeof(Wire) == sizeof(Type)) {
+      store_little_endian<Wire>(destination, source, count);
+    } else {
+      for (size_t i = 0; i != count; ++i) {
+        Wire value = portable_value(source[i]);
+        store_little_endian<Wire>(destination + i * sizeof(Wire), &value, 1);
+      }
+    }
+    return destination + sizeof(Wire) * count;
+  }
+  template <typename Operation, typename Type,
+            std::enable_if_t<isPortableScalar<Type>()> * = nullptr>
+  std::byte *write(Operation, std::byte *destination, Type value) {
+    return write_elements(Operation{}, destination, &value, 1);
+  }
+  template <typename Operation>
+  std::byte *write_length(Operation, std::byte *destination, size_t length) {
+    return write(Operation{}, destination, uint64_t(length));
+  }
+  template <typename Operation, typename Type,
+            std::enable_if_t<isPortableScalar<Type>()> * = nullptr>
+  std::byte *write(Operation, std::byte *destination,
+                   std::basic_string_view<Type> string) {
+    destination = write_length(Operation{}, destination, string.size());
+    return write_elements(Operation{}, destination, string.data(),
+                          string.size());
+  }
+  template <typename Operation>
+  std::byte *write(Operation, std::byte *destination, std::string_view string) {
+    return write<Operation, char>(Operation{}, destination, string);
+  }
+};
+
+struct PortableDataReader : DataReader {
+  using DataReader::DataReader;
+
+  size_t read_length(size_t element_size) {
+    uint64_t length = read<uint64_t>();
+    if (buffer.size() / element_size < length) {
+      end_of_data();
+    }
+    return length;
+  }
+  template <typename Type> void load_elements(Type *destination, size_t count) {
+    using Wire = portable_type<Type>;
+    if (buffer.size() / sizeof(Wire) < count) {
+      end_of_data();
+    }
+    if constexpr (sizeof(Wire) == sizeof(Type) && !std::is_same_v<Type, bool>) {
+      load_little_endian<Wire>(destination, buffer.data(), count);
+    } else {
+      for (size_t i = 0; i != count; ++i) {
+        Wire value;
+        load_little_endian<Wire>(&value, buffer.data() + i * sizeof(Wire), 1);
+        if constexpr (std::is_same_v<Type, bool>) {
+          destination[i] = value != 0;
+        } else {
+          if ((Wire)(Type)value != value) {
+            throw DataFormatError("PortableDataReader: integer out of range");
+          }
+          destination[i] = (Type)value;
+        }
+      }
+    }
+    advance(sizeof(Wire) * count);
+  }
+  template <typename Type,
+            std::enable_if_t<isPortableScalar<Type>()> * = nullptr>
+  void read(Type &result) {
+    load_elements(&result, 1);
+  }
+  // Borrowed views point at the wire bytes, which only match the host
+  // representation for bytes or on little-endian hosts.
+  template <typename Type> std::basic_string_view<Type> read_string_view() {
+    static_assert(host_is_little_endian || sizeof(Type) == 1,
+                  "portable views of wide elements need a little-endian host");
+    static_assert(sizeof(portable_type<Type>) == sizeof(Type));
+    size_t length = read_length(sizeof(Type));
+    Type *data = (Type *)buffer.data();
+    advance(sizeof(Type) * length);
+    return {data, length};
+  }
+  std::string_view read_string() { return read_string_view<char>(); }
+  void read(std::string_view &result) { result = read_string(); }
+  void read(std::string &result) { result = read_string(); }
+  template <typename Type> void read(std::basic_string_view<Type> &result) {
+    result = borrow_string_view(read_string_view<Type>());
+  }
+  template <typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  void read(Span<Type> &result) {
+    auto view = read_string_view<std::remove_const_t<Type>>();
+    result = borrow_span<Type>(view.data(), view.size());
+  }
+  template <typename Container> void read_elements(Container &container) {
+    using Type = typename Container::value_type;
+    container.resize(read_length(sizeof(portable_type<Type>)));
+    load_elements(container_data(container), container.size());
+  }
+  template <typename Type> Type read() {
+    Type result;
+    read(result);
+    return result;
+  }
+  std::string_view read() { return read_string(); }
+};
+
+// Deserializes BufferSlice fields as sub-slices of the source, so they keep
+// the underlying block alive without copying.
+struct BufferSliceReader : DataReader {
+  const BufferSlice &source;
+  BufferSliceReader(const BufferSlice &source)
+      : DataReader(source.view()), source(source) {}
+  using DataReader::read;
+  void read(BufferSlice &result) {
+    std::string_view bytes = read_string();
+    result = source.slice(bytes.data() - (const char *)source.get_data(),
+                          bytes.size());
+  }
+  template <typename Type> Type read() {
+    Type result;
+    read(result);
+    return result;
+  }
+};
+
+template <typename Operation, typename Writer = DataWriter>
+struct SerializeContext {
+  using writer_type = Writer;
   std::byte *start = nullptr;
   std::byte *current = nullptr;
   template <typename Type> static std::false_type detect_serialize_f(...);
@@ -315,7 +869,7 @@ template <typename Operation> struct SerializeContext {
       decltype(detect_serialize_f<Type>(0))::value;
   template <typename Type> static std::false_type detect_builtin_write_f(...);
   template <typename Type,
-            typename = decltype(std::declval<DataWriter>().write(
+            typename = decltype(std::declval<Writer>().write(
                 WriteOperation{}, (std::byte *)nullptr, std::declval<Type>()))>
   static std::true_type detect_builtin_write_f(int);
   template <typename Type>
@@ -326,8 +880,10 @@ template <typename Operation> struct SerializeContext {
       value.serialize(*this);
     } else if constexpr (has_serialize<Type>) {
       const_cast<Type &>(value).serialize(*this);
+    } else if constexpr (std::is_array_v<Type> || is_std_array<Type>::value) {
+      serialize(*this, value);
     } else if constexpr (has_builtin_write<const Type>) {
-      current = DataWriter{}.write(Operation{}, current, value);
+      current = Writer{}.write(Operation{}, current, value);
     } else {
       serialize(*this, value);
     }
@@ -337,26 +893,210 @@ template <typename Operation> struct SerializeContext {
   }
 
   void write(const void *data, size_t length) {
-    current =
-        DataWriter{}.write(Operation{}, current, (std::byte *)data, length);
+    current = Writer{}.write(Operation{}, current, (std::byte *)data, length);
+  }
+
+  template <typename Type> void write_elements(const Type *data, size_t count) {
+    current = Writer{}.write_elements(Operation{}, current, data, count);
   }
 
   size_t tell() const { return current - start; }
+
+  void patch(size_t position, const void *data, size_t length) {
+    if constexpr (std::is_same_v<Operation, WriteOperation>) {
+      std::memcpy(start + position, data, length);
+    }
+  }
 };
 
-struct DeserializeContext {
-  DeserializeContext(DataReader &reader) : reader(reader) {}
-  DataReader &reader;
+template <typename Type> struct is_basic_string_view : std::false_type {};
+template <typename Type>
+struct is_basic_string_view<std::basic_string_view<Type>> : std::true_type {};
 
+template <typename Sink, typename = void>
+struct has_chunk_size : std::false_type {};
+template <typename Sink>
+struct has_chunk_size<Sink,
+                      std::void_t<decltype(std::declval<Sink &>().chunk_size)>>
+    : std::true_type {};
+
+// Single pass writer: grows the destination as leaves are written instead of
+// measuring the whole object graph first. Sinks with a chunk_size receive
+// strings and bulk arrays larger than that in pieces, so a single leaf
+// never needs more than chunk_size bytes of contiguous space.
+template <typename Sink, typename Writer = DataWriter>
+struct GrowableSerializeContext {
+  using writer_type = Writer;
+  Sink &sink;
+  std::byte *current = nullptr;
+  std::byte *end = nullptr;
   template <typename Type> static std::false_type detect_serialize_f(...);
   template <typename Type, typename = decltype(std::declval<Type>().serialize(
-                               std::declval<DeserializeContext &>()))>
+                               std::declval<GrowableSerializeContext &>()))>
+  static std::true_type detect_serialize_f(int);
+  template <typename Type>
+  static const bool has_serialize =
+      decltype(detect_serialize_f<Type>(0))::value;
+  template <typename Type>
+  static const bool has_builtin_write = SerializeContext<
+      WriteOperation, Writer>::template has_builtin_write<Type>;
+
+  [[gnu::always_inline]] void reserve(size_t length) {
+    if ((size_t)(end - current) < length) {
+      [[unlikely]];
+      sink.grow(current, end, length);
+    }
+  }
+
+  template <typename Type> void operator()(const Type &value) {
+    if constexpr (has_serialize<const Type>) {
+      value.serialize(*this);
+    } else if constexpr (has_serialize<Type>) {
+      const_cast<Type &>(value).serialize(*this);
+    } else if constexpr (std::is_array_v<Type> || is_std_array<Type>::value) {
+      serialize(*this, value);
+    } else if constexpr (has_builtin_write<const Type>) {
+      size_t size = Writer{}.write(SizeOperation{}, nullptr, value) -
+                    (std::byte *)nullptr;
+      if constexpr (has_chunk_size<Sink>::value &&
+                    (is_basic_string_view<Type>::value ||
+                     (std::is_convertible_v<const Type &, std::string_view> &&
+                      !std::is_pointer_v<Type>))) {
+        if (size > sink.chunk_size) {
+          if constexpr (is_basic_string_view<Type>::value) {
+            write_chunked(value);
+          } else {
+            write_chunked(std::string_view(value));
+          }
+          return;
+        }
+      }
+      reserve(size);
+      current = Writer{}.write(WriteOperation{}, current, value);
+    } else {
+      serialize(*this, value);
+    }
+  }
+  template <typename... Types> void operator()(const Types &...values) {
+    ((*this)(std::forward<const Types &>(values)), ...);
+  }
+
+  template <typename Element>
+  void write_chunked(std::basic_string_view<Element> view) {
+    reserve(Writer{}.write_length(SizeOperation{}, nullptr, view.size()) -
+            (std::byte *)nullptr);
+    current = Writer{}.write_length(WriteOperation{}, current, view.size());
+    size_t step = std::max<size_t>(sink.chunk_size / sizeof(Element), 1);
+    for (size_t offset = 0; offset < view.size(); offset += step) {
+      write_elements(view.data() + offset,
+                     std::min(step, view.size() - offset));
+    }
+  }
+
+  void write(const void *data, size_t length) {
+    reserve(length);
+    current =
+        Writer{}.write(WriteOperation{}, current, (std::byte *)data, length);
+  }
+
+  template <typename Type> void write_elements(const Type *data, size_t count) {
+    reserve(Writer{}.write_elements(SizeOperation{}, nullptr, data, count) -
+            (std::byte *)nullptr);
+    current = Writer{}.write_elements(WriteOperation{}, current, data, count);
+  }
+
+  size_t tell() const { return sink.tell(current); }
+
+  // Only sinks that keep their output addressable can be patched.
+  template <typename SinkType = Sink>
+  auto patch(size_t position, const void *data, size_t length)
+      -> decltype(std::declval<SinkType &>().patch(current, position, data,
+                                                   length)) {
+    sink.patch(current, position, data, length);
+  }
+};
+
+template <typename Output> struct ContainerSerializeSink {
+  static constexpr size_t minimum_capacity = 64;
+  Output &output;
+
+  std::byte *data() { return (std::byte *)container_data(output); }
+
+  template <typename Type>
+  static auto resize_of(Type &output, size_t size, int)
+      -> decltype(output.resize_for_overwrite(size)) {
+    output.resize_for_overwrite(size);
+  }
+  template <typename Type>
+  static void resize_of(Type &output, size_t size, long) {
+    output.resize(size);
+  }
+
+  void grow(std::byte *&current, std::byte *&end, size_t needed) {
+    size_t used = current - data();
+    size_t size =
+        std::max({output.size() * 2, used + needed, minimum_capacity});
+    resize_of(output, size, 0);
+    current = data() + used;
+    end = data() + size;
+  }
+
+  void finish(std::byte *current) { output.resize(current - data()); }
+
+  size_t tell(const std::byte *current) { return current - data(); }
+
+  void patch(std::byte *, size_t position, const void *source, size_t length) {
+    std::memcpy(data() + position, source, length);
+  }
+};
+
+struct MemoryBlockSerializeSink {
+  static constexpr size_t minimum_capacity = 64;
+  UniqueMemoryBlock block;
+
+  void grow(std::byte *&current, std::byte *&end, size_t needed) {
+    size_t used = tell(current);
+    size_t size = std::max({used * 2, used + needed, minimum_capacity});
+    size = size_t(1) << (64 - __builtin_clzll(size - 1));
+    UniqueMemoryBlock grown = createMemoryBlock(size);
+    if (used) {
+      std::memcpy(grown->get_data(), block->get_data(), used);
+    }
+    block = std::move(grown);
+    current = block->get_data() + used;
+    end = block->get_data() + size;
+  }
+
+  UniqueMemoryBlock finish(std::byte *current) {
+    if (!block) {
+      return createMemoryBlock(0);
+    }
+    block->capacity = tell(current);
+    return std::move(block);
+  }
+
+  size_t tell(const std::byte *current) {
+    return block ? current - block->get_data() : 0;
+  }
+
+  void patch(std::byte *, size_t position, const void *source, size_t length) {
+    std::memcpy(block->get_data() + position, source, length);
+  }
+};
+
+template <typename Reader> struct BasicDeserializeContext {
+  BasicDeserializeContext(Reader &reader) : reader(reader) {}
+  Reader &reader;
+
+  template <typename Type> static std::false_type detect_serialize_f(...);
+  template <typename Type, typename = decltype(std::declval<Type>().serialize(
+                               std::declval<BasicDeserializeContext &>()))>
   static std::true_type detect_serialize_f(int);
   template <typename Type>
   static const bool has_serialize =
       decltype(detect_serialize_f<Type>(0))::value;
   template <typename Type> static std::false_type detect_builtin_read_f(...);
-  template <typename Type, typename = decltype(std::declval<DataReader>().read(
+  template <typename Type, typename = decltype(std::declval<Reader>().read(
                                std::declval<Type &>()))>
   static std::true_type detect_builtin_read_f(int);
   template <typename Type>
@@ -376,6 +1116,10 @@ struct DeserializeContext {
     ((*this)(values), ...);
   }
 
+  template <typename Container> void read_elements(Container &container) {
+    reader.read_elements(container);
+  }
+
   const char *consume(size_t count) {
     const char *result = reader.buffer.data();
     reader.advance(count);
@@ -388,7 +1132,7 @@ struct DeserializeContext {
       result.serialize(*this);
       return result;
     } else if constexpr (has_builtin_read<Type>) {
-      return reader.read<Type>();
+      return reader.template read<Type>();
     } else {
       Type result;
       serialize(*this, result);
@@ -397,6 +1141,117 @@ struct DeserializeContext {
   }
 };
 
+using DeserializeContext = BasicDeserializeContext<DataReader>;
+
+template <typename Context>
+struct is_deserialize_context : std::false_type {};
+template <typename Reader>
+struct is_deserialize_context<BasicDeserializeContext<Reader>>
+    : std::true_type {};
+
+template <typename Context, typename = void>
+struct has_patch : std::false_type {};
+template <typename Context>
+struct has_patch<Context, std::void_t<decltype(std::declval<Context &>().patch(
+                              size_t(), nullptr, size_t()))>>
+    : std::true_type {};
+
+// Readers that pull from a stream rather than holding the whole input
+// expose their position and skip forward instead of slicing a buffer.
+template <typename Reader, typename = void>
+struct is_stream_reader : std::false_type {};
+template <typename Reader>
+struct is_stream_reader<
+    Reader, std::void_t<decltype(std::declval<Reader &>().skip(uint64_t()))>>
+    : std::true_type {};
+
+template <typename Context>
+struct is_stream_deserialize_context : std::false_type {};
+template <typename Reader>
+struct is_stream_deserialize_context<BasicDeserializeContext<Reader>>
+    : is_stream_reader<Reader> {};
+
+template <typename Context, typename = void>
+struct has_writer_type : std::false_type {};
+template <typename Context>
+struct has_writer_type<Context, std::void_t<typename Context::writer_type>>
+    : std::true_type {};
+
+// Versioned envelope: version, field count and body length (fixed width
+// little-endian in every format) followed by the fields. Readers read the
+// fields they know, leave missing ones untouched and skip unknown trailing
+// fields by length. Returns the version that was written or read. Byte
+// streams that cannot back-patch the length measure the fields first;
+// contexts that are not byte streams (the flat builder) see plain fields.
+template <typename Context, typename... Fields>
+uint32_t serialize_versioned(Context &context, uint32_t version,
+                             Fields &...fields) {
+  constexpr size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+  if constexpr (is_stream_deserialize_context<Context>::value) {
+    auto &reader = context.reader;
+    std::byte bytes[header_size];
+    reader.read_bytes(bytes, header_size);
+    uint32_t header[2];
+    uint64_t length;
+    load_little_endian<uint32_t>(header, bytes, 2);
+    load_little_endian<uint64_t>(&length, bytes + sizeof(header), 1);
+    size_t present = std::min<size_t>(header[1], sizeof...(Fields));
+    size_t index = 0;
+    uint64_t start = reader.position();
+    ((index++ < present ? context(fields) : void()), ...);
+    uint64_t consumed = reader.position() - start;
+    if (consumed > length) {
+      throw DataFormatError("serialize_versioned: fields overrun envelope");
+    }
+    reader.skip(length - consumed);
+    return header[0];
+  } else if constexpr (is_deserialize_context<Context>::value) {
+    auto &reader = context.reader;
+    std::string_view outer = reader.buffer;
+    if (outer.size() < header_size) {
+      reader.end_of_data();
+    }
+    uint32_t header[2];
+    uint64_t length;
+    load_little_endian<uint32_t>(header, outer.data(), 2);
+    load_little_endian<uint64_t>(&length, outer.data() + sizeof(header), 1);
+    if (outer.size() - header_size < length) {
+      reader.end_of_data();
+    }
+    size_t present = std::min<size_t>(header[1], sizeof...(Fields));
+    size_t index = 0;
+    reader.buffer = outer.substr(header_size, length);
+    ((index++ < present ? context(fields) : void()), ...);
+    reader.buffer = outer.substr(header_size + length);
+    return header[0];
+  } else if constexpr (has_patch<Context>::value) {
+    uint32_t header[2] = {version, (uint32_t)sizeof...(Fields)};
+    std::byte bytes[header_size] = {};
+    store_little_endian<uint32_t>(bytes, header, 2);
+    context.write(bytes, header_size);
+    size_t length_position = context.tell() - sizeof(uint64_t);
+    context(fields...);
+    uint64_t length = context.tell() - length_position - sizeof(uint64_t);
+    store_little_endian<uint64_t>(bytes, &length, 1);
+    context.patch(length_position, bytes, sizeof(uint64_t));
+    return version;
+  } else if constexpr (has_writer_type<Context>::value) {
+    SerializeContext<SizeOperation, typename Context::writer_type> measure{};
+    measure(fields...);
+    uint32_t header[2] = {version, (uint32_t)sizeof...(Fields)};
+    uint64_t length = measure.current - (std::byte *)nullptr;
+    std::byte bytes[header_size];
+    store_little_endian<uint32_t>(bytes, header, 2);
+    store_little_endian<uint64_t>(bytes + sizeof(header), &length, 1);
+    context.write(bytes, header_size);
+    context(fields...);
+    return version;
+  } else {
+    context(fields...);
+    return version;
+  }
+}
+
 template <typename Output, typename... Types>
 void serialize_to(Output &output, const Types &...values) {
   static_assert(sizeof(*output.data()) == sizeof(std::byte));
@@ -422,6 +1277,70 @@ serialize_to_buffer(const Types &...values) {
   return handle;
 }
 
+template <typename Output, typename... Types>
+void serialize_to_growable(Output &output, const Types &...values) {
+  static_assert(sizeof(*container_data(output)) == sizeof(std::byte));
+  output.resize(0);
+  ContainerSerializeSink<Output> sink{output};
+  GrowableSerializeContext<ContainerSerializeSink<Output>> context{
+      sink, sink.data(), sink.data()};
+  (context(values), ...);
+  sink.finish(context.current);
+}
+
+template <typename... Types>
+[[gnu::warn_unused_result]] BufferHandle
+serialize_to_growable_buffer(const Types &...values) {
+  MemoryBlockSerializeSink sink;
+  GrowableSerializeContext<MemoryBlockSerializeSink> context{sink};
+  (context(values), ...);
+  return sink.finish(context.current);
+}
+
+template <typename Output, typename... Types>
+void serialize_to_compact(Output &output, const Types &...values) {
+  static_assert(sizeof(*container_data(output)) == sizeof(std::byte));
+  using Sink = ContainerSerializeSink<Output>;
+  output.resize(0);
+  Sink sink{output};
+  GrowableSerializeContext<Sink, CompactDataWriter> context{sink, sink.data(),
+                                                            sink.data()};
+  (context(values), ...);
+  sink.finish(context.current);
+}
+
+template <typename... Types>
+[[gnu::warn_unused_result]] BufferHandle
+serialize_to_compact_buffer(const Types &...values) {
+  MemoryBlockSerializeSink sink;
+  GrowableSerializeContext<MemoryBlockSerializeSink, CompactDataWriter>
+      context{sink};
+  (context(values), ...);
+  return sink.finish(context.current);
+}
+
+template <typename Output, typename... Types>
+void serialize_to_portable(Output &output, const Types &...values) {
+  static_assert(sizeof(*container_data(output)) == sizeof(std::byte));
+  using Sink = ContainerSerializeSink<Output>;
+  output.resize(0);
+  Sink sink{output};
+  GrowableSerializeContext<Sink, PortableDataWriter> context{sink, sink.data(),
+                                                             sink.data()};
+  (context(values), ...);
+  sink.finish(context.current);
+}
+
+template <typename... Types>
+[[gnu::warn_unused_result]] BufferHandle
+serialize_to_portable_buffer(const Types &...values) {
+  MemoryBlockSerializeSink sink;
+  GrowableSerializeContext<MemoryBlockSerializeSink, PortableDataWriter>
+      context{sink};
+  (context(values), ...);
+  return sink.finish(context.current);
+}
+
 template <typename... Types>
 void serialize_to_string_view(std::string_view buffer, const Types &...values) {
   SerializeContext<SizeOperation> context{};
@@ -495,6 +1414,173 @@ std::string_view deserialize_buffer_part(Buffer *buffer, Types &...results) {
   return reader.buffer;
 }
 
+template <typename... Types>
+void deserialize_compact_buffer(std::string_view data, Types &...results) {
+  CompactDataReader reader(data);
+  BasicDeserializeContext<CompactDataReader> context(reader);
+  context(results...);
+  if (reader.buffer.size() != 0) {
+    throw DataFormatError(
+        "deserialize_compact_buffer: " + std::to_string(reader.buffer.size()) +
+        " trailing bytes");
+  }
+}
+
+template <typename... Types>
+void deserialize_compact_buffer(Buffer *buffer, Types &...results) {
+  deserialize_compact_buffer(
+      std::string_view{(const char *)buffer->get_data(), buffer->get_size()},
+      results...);
+}
+
+template <typename... Types>
+void deserialize_compact_buffer(const BufferSlice &slice, Types &...results) {
+  deserialize_compact_buffer(slice.view(), results...);
+}
+
+template <typename... Types>
+void deserialize_portable_buffer(std::string_view data, Types &...results) {
+  PortableDataReader reader(data);
+  BasicDeserializeContext<PortableDataReader> context(reader);
+  context(results...);
+  if (reader.buffer.size() != 0) {
+    throw DataFormatError(
+        "deserialize_portable_buffer: " +
+        std::to_string(reader.buffer.size()) + " trailing bytes");
+  }
+}
+
+template <typename... Types>
+void deserialize_portable_buffer(Buffer *buffer, Types &...results) {
+  deserialize_portable_buffer(
+      std::string_view{(const char *)buffer->get_data(), buffer->get_size()},
+      results...);
+}
+
+template <typename... Types>
+void deserialize_portable_buffer(const BufferSlice &slice, Types &...results) {
+  deserialize_portable_buffer(slice.view(), results...);
+}
+
+template <typename... Types>
+void deserialize_buffer(const BufferSlice &slice, Types &...results) {
+  BufferSliceReader reader(slice);
+  BasicDeserializeContext<BufferSliceReader> context(reader);
+  context(results...);
+  if (reader.buffer.size() != 0) {
+    throw DataFormatError(
+        "deserialize_buffer: " + std::to_string(reader.buffer.size()) +
+        " trailing bytes");
+  }
+}
+
+template <typename... Types>
+BufferSlice deserialize_buffer_part(const BufferSlice &slice,
+                                    Types &...results) {
+  BufferSliceReader reader(slice);
+  BasicDeserializeContext<BufferSliceReader> context(reader);
+  context(results...);
+  return slice.slice(slice.get_size() - reader.buffer.size());
+}
+
+// Checksummed frames: a little-endian header holding a magic number, the
+// CRC-32C of the payload and the payload length, followed by the payload.
+// Frames can be concatenated on a stream; each is verified before parsing.
+struct FrameHeader {
+  static constexpr uint32_t frame_magic = 0x3152464b;
+  static constexpr size_t size = 16;
+  uint32_t checksum = 0;
+  uint64_t length = 0;
+
+  void write(std::byte *destination) const {
+    uint32_t words[2] = {frame_magic, checksum};
+    store_little_endian<uint32_t>(destination, words, 2);
+    store_little_endian<uint64_t>(destination + 8, &length, 1);
+  }
+  static FrameHeader read(std::string_view data) {
+    if (data.size() < size) {
+      throw DataFormatError("FrameHeader: truncated frame header");
+    }
+    uint32_t words[2];
+    FrameHeader header;
+    load_little_endian<uint32_t>(words, data.data(), 2);
+    load_little_endian<uint64_t>(&header.length, data.data() + 8, 1);
+    if (words[0] != frame_magic) {
+      throw DataFormatError("FrameHeader: bad magic");
+    }
+    header.checksum = words[1];
+    return header;
+  }
+};
+
+// Returns the payload of the frame at the start of data after checking its
+// length and checksum.
+inline std::string_view verify_frame(std::string_view data) {
+  FrameHeader header = FrameHeader::read(data);
+  if (data.size() - FrameHeader::size < header.length) {
+    throw DataFormatError("verify_frame: truncated frame payload");
+  }
+  std::string_view payload = data.substr(FrameHeader::size, header.length);
+  if (crc32c(payload.data(), payload.size()) != header.checksum) {
+    throw DataFormatError("verify_frame: checksum mismatch");
+  }
+  return payload;
+}
+
+template <typename... Types>
+[[gnu::warn_unused_result]] BufferHandle
+serialize_to_framed_buffer(const Types &...values) {
+  SerializeContext<SizeOperation> context{};
+  (context(values), ...);
+  size_t size = context.current - (std::byte *)nullptr;
+  BufferHandle handle = makeBuffer(FrameHeader::size + size);
+  std::byte *payload = handle->get_data() + FrameHeader::size;
+  SerializeContext<WriteOperation> context2{payload, payload};
+  (context2(values), ...);
+  FrameHeader header;
+  header.checksum = crc32c(payload, size);
+  header.length = size;
+  header.write(handle->get_data());
+  return handle;
+}
+
+template <typename... Types>
+std::string_view deserialize_framed_buffer_part(std::string_view data,
+                                                Types &...results) {
+  std::string_view payload = verify_frame(data);
+  deserialize_buffer(payload, results...);
+  return data.substr(FrameHeader::size + payload.size());
+}
+
+template <typename... Types>
+void deserialize_framed_buffer(std::string_view data, Types &...results) {
+  std::string_view rest = deserialize_framed_buffer_part(data, results...);
+  if (rest.size() != 0) {
+    throw DataFormatError("deserialize_framed_buffer: " +
+                          std::to_string(rest.size()) + " trailing bytes");
+  }
+}
+
+template <typename... Types>
+void deserialize_framed_buffer(Buffer *buffer, Types &...results) {
+  deserialize_framed_buffer(
+      std::string_view{(const char *)buffer->get_data(), buffer->get_size()},
+      results...);
+}
+
+template <typename... Types>
+void deserialize_framed_buffer(const BufferSlice &slice, Types &...results) {
+  std::string_view payload = verify_frame(slice.view());
+  if (slice.get_size() != FrameHeader::size + payload.size()) {
+    throw DataFormatError(
+        "deserialize_framed_buffer: " +
+        std::to_string(slice.get_size() - FrameHeader::size - payload.size()) +
+        " trailing bytes");
+  }
+  deserialize_buffer(slice.slice(FrameHeader::size, payload.size()),
+                     results...);
+}
+
 template <typename Type> struct SerializeFunction {
   const Type &function;
   SerializeFunction(const Type &function) : function(function) {}
@@ -516,6 +1602,83 @@ template <typename... Types>
 BufferHandle serializeToBuffer(const Types &...values) {
   return serialize_to_buffer(values...);
 }
+template <typename Output, typename... Types>
+void serializeToGrowable(Output &output, const Types &...values) {
+  serialize_to_growable(output, values...);
+}
+template <typename... Types>
+BufferHandle serializeToGrowableBuffer(const Types &...values) {
+  return serialize_to_growable_buffer(values...);
+}
+template <typename Output, typename... Types>
+void serializeToCompact(Output &output, const Types &...values) {
+  serialize_to_compact(output, values...);
+}
+template <typename... Types>
+BufferHandle serializeToCompactBuffer(const Types &...values) {
+  return serialize_to_compact_buffer(values...);
+}
+template <typename... Types>
+void deserializeCompactBuffer(std::string_view data, Types &...results) {
+  deserialize_compact_buffer(data, results...);
+}
+template <typename... Types>
+void deserializeCompactBuffer(Buffer *buffer, Types &...results) {
+  deserialize_compact_buffer(buffer, results...);
+}
+template <typename... Types>
+void deserializeCompactBuffer(const BufferSlice &slice, Types &...results) {
+  deserialize_compact_buffer(slice, results...);
+}
+template <typename... Types>
+BufferHandle serializeToFramedBuffer(const Types &...values) {
+  return serialize_to_framed_buffer(values...);
+}
+template <typename... Types>
+void deserializeFramedBuffer(std::string_view data, Types &...results) {
+  deserialize_framed_buffer(data, results...);
+}
+template <typename... Types>
+void deserializeFramedBuffer(Buffer *buffer, Types &...results) {
+  deserialize_framed_buffer(buffer, results...);
+}
+template <typename... Types>
+void deserializeFramedBuffer(const BufferSlice &slice, Types &...results) {
+  deserialize_framed_buffer(slice, results...);
+}
+template <typename... Types>
+std::string_view deserializeFramedBufferPart(std::string_view data,
+                                             Types &...results) {
+  return deserialize_framed_buffer_part(data, results...);
+}
+inline std::string_view verifyFrame(std::string_view data) {
+  return verify_frame(data);
+}
+template <typename Output, typename... Types>
+void serializeToPortable(Output &output, const Types &...values) {
+  serialize_to_portable(output, values...);
+}
+template <typename... Types>
+BufferHandle serializeToPortableBuffer(const Types &...values) {
+  return serialize_to_portable_buffer(values...);
+}
+template <typename... Types>
+void deserializePortableBuffer(std::string_view data, Types &...results) {
+  deserialize_portable_buffer(data, results...);
+}
+template <typename... Types>
+void deserializePortableBuffer(Buffer *buffer, Types &...results) {
+  deserialize_portable_buffer(buffer, results...);
+}
+template <typename... Types>
+void deserializePortableBuffer(const BufferSlice &slice, Types &...results) {
+  deserialize_portable_buffer(slice, results...);
+}
+template <typename Context, typename... Fields>
+uint32_t serializeVersioned(Context &context, uint32_t version,
+                            Fields &...fields) {
+  return serialize_versioned(context, version, fields...);
+}
 template <typename... Types>
 void serializeToStringView(std::string_view buffer, const Types &...values) {
   serialize_to_string_view(buffer, values...);
@@ -550,5 +1713,13 @@ template <typename... Types>
 std::string_view deserializeBufferPart(Buffer *buffer, Types &...results) {
   return deserialize_buffer_part(buffer, results...);
 }
+template <typename... Types>
+void deserializeBuffer(const BufferSlice &slice, Types &...results) {
+  deserialize_buffer(slice, results...);
+}
+template <typename... Types>
+BufferSlice deserializeBufferPart(const BufferSlice &slice, Types &...results) {
+  return deserialize_buffer_part(slice, results...);
+}
 
 } // namespace turbokit
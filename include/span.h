@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace turbokit {
+
+// Non-owning view of contiguous elements. Spans produced by deserialization
+// point straight into the input buffer; readers reject input that would
+// leave the elements misaligned.
+template <typename ElementType> struct Span {
+  ElementType *elements = nullptr;
+  size_t count = 0;
+  using value_type = std::remove_cv_t<ElementType>;
+  Span() = default;
+  Span(ElementType *elements, size_t count)
+      : elements(elements), count(count) {}
+  template <size_t Size>
+  Span(ElementType (&array)[Size]) : elements(array), count(Size) {}
+  template <typename OtherType,
+            std::enable_if_t<std::is_convertible_v<OtherType (*)[],
+                                                   ElementType (*)[]>> * =
+                nullptr>
+  Span(const Span<OtherType> &other)
+      : elements(other.elements), count(other.count) {}
+  ElementType &get_at(size_t position) const {
+    if (position >= count) {
+      throw std::out_of_range("Span::get_at out of range");
+    }
+    return elements[position];
+  }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  ElementType *get_data() const { return elements; }
+  ElementType *begin() const { return elements; }
+  ElementType *end() const { return elements + count; }
+  ElementType &operator[](size_t position) const { return elements[position]; }
+  Span subspan(size_t offset, size_t length) const {
+    if (offset > count || length > count - offset) {
+      throw std::out_of_range("Span::subspan out of range");
+    }
+    return Span(elements + offset, length);
+  }
+  Span subspan(size_t offset) const {
+    if (offset > count) {
+      throw std::out_of_range("Span::subspan out of range");
+    }
+    return Span(elements + offset, count - offset);
+  }
+};
+
+} // namespace turbokit
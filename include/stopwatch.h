@@ -0,0 +1,93 @@
+#pragma once
+
+#include "clock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <x86intrin.h>
+
+namespace turbokit {
+
+[[gnu::always_inline]] inline int64_t readCyclesBegin() {
+  _mm_lfence();
+  int64_t cycles = __rdtsc();
+  _mm_lfence();
+  return cycles;
+}
+
+[[gnu::always_inline]] inline int64_t readCyclesEnd() {
+  unsigned int processor_id;
+  int64_t cycles = __rdtscp(&processor_id);
+  _mm_lfence();
+  return cycles;
+}
+
+struct CycleStopwatch {
+  int64_t start_cycles = 0;
+  int64_t total_cycles = 0;
+  uint64_t interval_count = 0;
+
+  [[gnu::always_inline]] void start() { start_cycles = readCyclesBegin(); }
+
+  [[gnu::always_inline]] int64_t stop() {
+    int64_t cycles = readCyclesEnd() - start_cycles;
+    record_cycles(cycles);
+    return cycles;
+  }
+
+  void record_cycles(int64_t cycles) {
+    total_cycles += cycles;
+    ++interval_count;
+  }
+
+  void reset() {
+    total_cycles = 0;
+    interval_count = 0;
+  }
+
+  int64_t elapsed_cycles() const { return total_cycles; }
+
+  int64_t elapsed_nanoseconds() const {
+    return time_manager.cycles_to_nanoseconds(total_cycles);
+  }
+
+  std::chrono::nanoseconds elapsed() const {
+    return std::chrono::nanoseconds(elapsed_nanoseconds());
+  }
+
+  double average_nanoseconds() const {
+    return interval_count ? (double)elapsed_nanoseconds() / interval_count
+                          : 0.0;
+  }
+};
+
+template <typename Sink> class ScopedTimer {
+private:
+  Sink sink;
+  int64_t start_cycles;
+
+public:
+  explicit ScopedTimer(Sink &&sink)
+      : sink(std::forward<Sink>(sink)), start_cycles(readCyclesBegin()) {}
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  ~ScopedTimer() {
+    int64_t cycles = readCyclesEnd() - start_cycles;
+    if constexpr (std::is_invocable_v<Sink &, int64_t>) {
+      sink(cycles);
+    } else {
+      sink.record_cycles(cycles);
+    }
+  }
+};
+
+template <typename Sink> ScopedTimer(Sink &&) -> ScopedTimer<Sink>;
+
+using Stopwatch = CycleStopwatch;
+
+} // namespace turbokit
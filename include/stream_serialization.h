@@ -0,0 +1,321 @@
+#pragma once
+
+#include "buffer.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace turbokit {
+
+struct StreamIo {
+  static constexpr size_t default_window_size = 1 << 20;
+
+  [[noreturn]] static void fail(const char *operation, int error) {
+    throw std::runtime_error(std::string("Stream: ") + operation +
+                             " failed: " + std::strerror(error));
+  }
+
+  static void write_all(int fd, const std::byte *data, size_t length) {
+    while (length) {
+      ssize_t written = ::write(fd, data, length);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fail("write", errno);
+      }
+      data += written;
+      length -= written;
+    }
+  }
+
+  static size_t read_some(int fd, std::byte *data, size_t length) {
+    while (true) {
+      ssize_t result = ::read(fd, data, length);
+      if (result >= 0) {
+        return result;
+      }
+      if (errno != EINTR) {
+        fail("read", errno);
+      }
+    }
+  }
+};
+
+// Growable sink that serializes into a fixed window and writes it to a file
+// descriptor each time it fills. Strings and bulk arrays larger than the
+// window are written through in window-sized chunks, so memory use does not
+// depend on the size of the data. Output is byte-identical to
+// serialize_to_buffer.
+struct FileDescriptorSerializeSink {
+  int fd;
+  size_t chunk_size = StreamIo::default_window_size;
+  UniqueMemoryBlock window = {};
+  uint64_t flushed = 0;
+
+  void grow(std::byte *&current, std::byte *&end, size_t needed) {
+    flush(current);
+    size_t size = std::max(needed, chunk_size);
+    if (!window || window->get_size() < size) {
+      window = createMemoryBlock(size);
+    }
+    current = window->get_data();
+    end = current + size;
+  }
+
+  void flush(std::byte *&current) {
+    if (!window) {
+      return;
+    }
+    size_t length = current - window->get_data();
+    StreamIo::write_all(fd, window->get_data(), length);
+    flushed += length;
+    current = window->get_data();
+  }
+
+  uint64_t tell(const std::byte *current) {
+    return flushed + (window ? current - window->get_data() : 0);
+  }
+};
+
+class StreamWriter {
+public:
+  explicit StreamWriter(int fd,
+                        size_t window_size = StreamIo::default_window_size)
+      : sink{fd, window_size}, context{sink} {}
+  StreamWriter(const StreamWriter &) = delete;
+  StreamWriter &operator=(const StreamWriter &) = delete;
+
+  // Flushes what is left; errors can only be reported by calling flush()
+  // explicitly before destruction.
+  ~StreamWriter() {
+    try {
+      flush();
+    } catch (const std::exception &) {
+    }
+  }
+
+  template <typename... Types> void serialize(const Types &...values) {
+    context(values...);
+  }
+
+  void flush() { sink.flush(context.current); }
+
+  uint64_t tell() const { return context.tell(); }
+
+private:
+  FileDescriptorSerializeSink sink;
+  GrowableSerializeContext<FileDescriptorSerializeSink> context;
+};
+
+// Reader for the native format that pulls from a file descriptor through a
+// fixed window, refilling it on demand. Strings, BufferSlices and bulk
+// arrays are read straight into their destination, growing it as data
+// arrives rather than trusting the encoded length up front. Borrowed views
+// (std::string_view, Span) are not supported because the window is reused.
+class StreamReader {
+public:
+  explicit StreamReader(int fd,
+                        size_t window_size = StreamIo::default_window_size)
+      : fd(fd), window(createMemoryBlock(std::max<size_t>(window_size, 64))) {
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  StreamReader(const StreamReader &) = delete;
+  StreamReader &operator=(const StreamReader &) = delete;
+
+  [[noreturn]] void end_of_data() {
+    throw DataFormatError("StreamReader: reached end of data");
+  }
+
+  template <typename... Types> void deserialize(Types &...results) {
+    BasicDeserializeContext<StreamReader> context(*this);
+    context(results...);
+  }
+
+  template <typename Type,
+            std::enable_if_t<std::is_trivial_v<Type>> * = nullptr>
+  void read(Type &result) {
+    if (end - begin < sizeof(Type)) {
+      // May be larger than the whole window; read_bytes reads around it.
+      read_bytes(&result, sizeof(Type));
+      return;
+    }
+    std::memcpy(&result, window->get_data() + begin, sizeof(Type));
+    begin += sizeof(Type);
+  }
+  void read(std::string &result) {
+    size_t length = read<size_t>();
+    result.clear();
+    read_growing(length, 1, [&](size_t size) {
+      result.resize(size);
+      return (std::byte *)result.data();
+    });
+  }
+  // Reads straight into the slice's block, doubling it as data arrives up to
+  // the encoded length, so the block ends up exactly sized.
+  void read(BufferSlice &result) {
+    size_t length = read<size_t>();
+    BufferHandle block =
+        createMemoryBlock(std::min(length, window->get_size()));
+    size_t filled = 0;
+    read_growing(length, 1, [&](size_t size) {
+      if (block->get_size() < size) {
+        BufferHandle grown = createMemoryBlock(
+            std::min(length, std::max(size, 2 * block->get_size())));
+        std::memcpy(grown->get_data(), block->get_data(), filled);
+        block = std::move(grown);
+      }
+      filled = size;
+      return block->get_data();
+    });
+    result = BufferSlice(std::move(block));
+  }
+  template <typename Container> void read_elements(Container &container) {
+    using Type = typename Container::value_type;
+    size_t count = read<size_t>();
+    if (count > std::numeric_limits<size_t>::max() / sizeof(Type)) {
+      end_of_data();
+    }
+    container.resize(0);
+    read_growing(count * sizeof(Type), sizeof(Type), [&](size_t size) {
+      container.resize(size / sizeof(Type));
+      return (std::byte *)container_data(container);
+    });
+  }
+  template <typename Type> Type read() {
+    Type result;
+    read(result);
+    return result;
+  }
+
+  void read_bytes(void *destination, size_t length) {
+    std::byte *output = (std::byte *)destination;
+    size_t available = std::min(length, end - begin);
+    std::memcpy(output, window->get_data() + begin, available);
+    begin += available;
+    output += available;
+    length -= available;
+    if (length >= window->get_size()) {
+      consumed += begin;
+      begin = end = 0;
+      while (length) {
+        size_t bytes = StreamIo::read_some(fd, output, length);
+        if (!bytes) {
+          end_of_data();
+        }
+        consumed += bytes;
+        output += bytes;
+        length -= bytes;
+      }
+    } else if (length) {
+      ensure(length);
+      std::memcpy(output, window->get_data() + begin, length);
+      begin += length;
+    }
+  }
+
+  bool empty() { return begin == end && !refill(); }
+
+  uint64_t position() const { return consumed + begin; }
+
+  void skip(uint64_t length) {
+    size_t available = std::min<uint64_t>(length, end - begin);
+    begin += available;
+    length -= available;
+    if (!length) {
+      return;
+    }
+    consumed += begin;
+    begin = end = 0;
+    if (::lseek(fd, length, SEEK_CUR) >= 0) {
+      consumed += length;
+      return;
+    }
+    while (length) {
+      if (begin == end && !refill()) {
+        end_of_data();
+      }
+      size_t step = std::min<uint64_t>(length, end - begin);
+      begin += step;
+      length -= step;
+    }
+  }
+
+private:
+  // Moves unread bytes to the front of the window and reads once more.
+  size_t refill() {
+    std::byte *data = window->get_data();
+    std::memmove(data, data + begin, end - begin);
+    consumed += begin;
+    end -= begin;
+    begin = 0;
+    size_t bytes =
+        StreamIo::read_some(fd, data + end, window->get_size() - end);
+    end += bytes;
+    return bytes;
+  }
+
+  void ensure(size_t length) {
+    while (end - begin < length) {
+      if (!refill()) {
+        end_of_data();
+      }
+    }
+  }
+
+  // Reads length bytes into a destination that is resized a window at a
+  // time, so a corrupt length fails at end of data instead of allocating.
+  // Each step is a whole number of elements so the resize covers it.
+  template <typename Resize>
+  void read_growing(size_t length, size_t element_size, Resize resize) {
+    size_t step_size =
+        std::max<size_t>(window->get_size() / element_size, 1) * element_size;
+    size_t done = 0;
+    while (done != length) {
+      size_t step = std::min(length - done, step_size);
+      std::byte *data = resize(done + step);
+      read_bytes(data + done, step);
+      done += step;
+    }
+  }
+
+  int fd;
+  UniqueMemoryBlock window;
+  size_t begin = 0;
+  size_t end = 0;
+  uint64_t consumed = 0;
+};
+
+template <typename... Types>
+void serialize_to_fd(int fd, const Types &...values) {
+  StreamWriter writer(fd);
+  writer.serialize(values...);
+  writer.flush();
+}
+
+template <typename... Types>
+void deserialize_from_fd(int fd, Types &...results) {
+  StreamReader reader(fd);
+  reader.deserialize(results...);
+}
+
+template <typename... Types>
+void serializeToFd(int fd, const Types &...values) {
+  serialize_to_fd(fd, values...);
+}
+template <typename... Types>
+void deserializeFromFd(int fd, Types &...results) {
+  deserialize_from_fd(fd, results...);
+}
+
+} // namespace turbokit
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "clock.h"
+#include "intrusive_list.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace turbokit {
+
+struct TimerNode {
+  IntrusiveListLink<TimerNode> timer_link;
+  int64_t deadline_tick = 0;
+  uint16_t timer_slot = 0;
+
+  bool is_scheduled() const noexcept {
+    return timer_link.successor != nullptr;
+  }
+};
+
+template <size_t LevelCount = 6> class BasicTimerWheel {
+  static_assert(LevelCount >= 1 && LevelCount * 6 < 63);
+
+  static constexpr int slot_bits = 6;
+  static constexpr size_t slot_count = size_t(1) << slot_bits;
+  static constexpr uint16_t overflow_slot = LevelCount * slot_count;
+
+  using TimerList = IntrusiveList<TimerNode, &TimerNode::timer_link>;
+
+  struct Level {
+    uint64_t occupied = 0;
+    TimerList slots[slot_count];
+  };
+
+  Level levels[LevelCount];
+  TimerList overflow;
+  int64_t tick_nanoseconds;
+  int64_t current_tick;
+  int64_t deferred_tick;
+  size_t timer_count = 0;
+
+  void insert(TimerNode &timer, int64_t tick) {
+    uint64_t difference = (uint64_t)(tick ^ current_tick);
+    size_t level = difference < slot_count
+                       ? 0
+                       : (63 - __builtin_clzll(difference)) / slot_bits;
+    if (level >= LevelCount) {
+      timer.timer_slot = overflow_slot;
+      overflow.push_back(timer);
+      return;
+    }
+    size_t slot = (tick >> (level * slot_bits)) & (slot_count - 1);
+    timer.timer_slot = level * slot_count + slot;
+    levels[level].slots[slot].push_back(timer);
+    levels[level].occupied |= uint64_t(1) << slot;
+  }
+
+  void cascade(TimerList &list) {
+    TimerList pending = std::move(list);
+    while (!pending.empty()) {
+      TimerNode &timer = pending.front();
+      pending.pop_front();
+      insert(timer, std::max(timer.deadline_tick, current_tick));
+    }
+  }
+
+  std::optional<int64_t> next_event_tick() const {
+    std::optional<int64_t> result;
+    for (size_t level = 0; level != LevelCount; ++level) {
+      int shift = level * slot_bits;
+      uint64_t digit = (current_tick >> shift) & (slot_count - 1);
+      uint64_t candidates = levels[level].occupied & ~uint64_t(0) << digit;
+      if (!candidates) {
+        continue;
+      }
+      int64_t block_start =
+          current_tick & ~(((int64_t)1 << (shift + slot_bits)) - 1);
+      int64_t tick =
+          block_start + ((int64_t)__builtin_ctzll(candidates) << shift);
+      if (!result || tick < *result) {
+        result = tick;
+      }
+    }
+    if (!overflow.empty()) {
+      int top_shift = LevelCount * slot_bits;
+      int64_t tick = ((current_tick >> top_shift) + 1) << top_shift;
+      if (!result || tick < *result) {
+        result = tick;
+      }
+    }
+    return result;
+  }
+
+public:
+  explicit BasicTimerWheel(
+      std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+      int64_t start_time = time_manager.get_current_time())
+      : tick_nanoseconds(std::max<int64_t>(resolution.count(), 1)),
+        current_tick(start_time / tick_nanoseconds),
+        deferred_tick(current_tick) {}
+
+  BasicTimerWheel(const BasicTimerWheel &) = delete;
+  BasicTimerWheel &operator=(const BasicTimerWheel &) = delete;
+
+  void schedule(TimerNode &timer, int64_t deadline) {
+    if (timer.is_scheduled()) {
+      cancel(timer);
+    }
+    timer.deadline_tick = (deadline + tick_nanoseconds - 1) / tick_nanoseconds;
+    insert(timer, std::max({timer.deadline_tick, current_tick, deferred_tick}));
+    ++timer_count;
+  }
+
+  void schedule_after(TimerNode &timer, std::chrono::nanoseconds delay) {
+    schedule(timer, time_manager.get_current_time() + delay.count());
+  }
+
+  bool cancel(TimerNode &timer) {
+    if (!timer.is_scheduled()) {
+      return false;
+    }
+    TimerList::erase(timer);
+    --timer_count;
+    if (timer.timer_slot != overflow_slot) {
+      Level &level = levels[timer.timer_slot / slot_count];
+      size_t slot = timer.timer_slot % slot_count;
+      if (level.slots[slot].empty()) {
+        level.occupied &= ~(uint64_t(1) << slot);
+      }
+    }
+    return true;
+  }
+
+  template <typename Callback>
+  size_t advance(int64_t now, Callback &&callback) {
+    int64_t now_tick = now / tick_nanoseconds;
+    size_t expired_count = 0;
+    deferred_tick = now_tick + 1;
+    while (current_tick <= now_tick) {
+      std::optional<int64_t> event_tick = next_event_tick();
+      if (!event_tick || *event_tick > now_tick) {
+        current_tick = now_tick + 1;
+        break;
+      }
+      current_tick = *event_tick;
+      int top_shift = LevelCount * slot_bits;
+      if ((current_tick & (((int64_t)1 << top_shift) - 1)) == 0 &&
+          !overflow.empty()) {
+        cascade(overflow);
+      }
+      for (size_t level = LevelCount - 1; level != 0; --level) {
+        int shift = level * slot_bits;
+        if (current_tick & (((int64_t)1 << shift) - 1)) {
+          continue;
+        }
+        size_t slot = (current_tick >> shift) & (slot_count - 1);
+        if (levels[level].occupied & (uint64_t(1) << slot)) {
+          levels[level].occupied &= ~(uint64_t(1) << slot);
+          cascade(levels[level].slots[slot]);
+        }
+      }
+      size_t slot = current_tick & (slot_count - 1);
+      ++current_tick;
+      if (!(levels[0].occupied & (uint64_t(1) << slot))) {
+        continue;
+      }
+      levels[0].occupied &= ~(uint64_t(1) << slot);
+      TimerList expired = std::move(levels[0].slots[slot]);
+      while (!expired.empty()) {
+        TimerNode &timer = expired.front();
+        expired.pop_front();
+        --timer_count;
+        ++expired_count;
+        callback(timer);
+      }
+    }
+    return expired_count;
+  }
+
+  template <typename Callback> size_t advance(Callback &&callback) {
+    return advance(time_manager.get_current_time(),
+                   std::forward<Callback>(callback));
+  }
+
+  std::optional<int64_t> next_expiry_time() const {
+    std::optional<int64_t> tick = next_event_tick();
+    if (!tick) {
+      return std::nullopt;
+    }
+    return *tick * tick_nanoseconds;
+  }
+
+  int64_t resolution() const noexcept { return tick_nanoseconds; }
+  size_t size() const noexcept { return timer_count; }
+  bool empty() const noexcept { return timer_count == 0; }
+};
+
+using TimerWheel = BasicTimerWheel<>;
+
+} // namespace turbokit
@@ -0,0 +1,345 @@
+#pragma once
+
+#include "clock.h"
+#include "logging.h"
+#include "sync.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace turbokit {
+
+enum class TracePhase : uint8_t {
+  TRACE_BEGIN = 'B',
+  TRACE_END = 'E',
+};
+
+struct TraceEvent {
+  std::atomic<const char *> name = nullptr;
+  std::atomic_int64_t cycles = 0;
+  std::atomic<TracePhase> phase = TracePhase::TRACE_BEGIN;
+};
+
+// A thread that owned a buffer from event index `begin` on. A buffer passes
+// from exited threads to new ones, and earlier owners' events stay in the ring
+// under their own thread id until they are overwritten.
+struct TraceBufferOwner {
+  uint64_t begin = 0;
+  uint32_t thread_index = 0;
+  std::string thread_name;
+};
+
+struct TraceBuffer {
+  std::vector<TraceBufferOwner> owners;
+  size_t capacity = 0;
+  std::unique_ptr<TraceEvent[]> events;
+  std::atomic_uint64_t write_index = 0;
+  std::atomic_uint64_t cleared_index = 0;
+
+  TraceBuffer(uint32_t thread_index, size_t capacity)
+      : owners{{0, thread_index, {}}}, capacity(capacity),
+        events(std::make_unique<TraceEvent[]>(capacity)) {}
+
+  // Called with the registry lock held by the thread taking the buffer over.
+  void take_over(uint32_t thread_index) {
+    uint64_t end = write_index.load(std::memory_order_relaxed);
+    uint64_t oldest = std::max<uint64_t>(
+        cleared_index.load(std::memory_order_relaxed),
+        end > capacity ? end - capacity : 0);
+    if (owners.back().begin == end) {
+      owners.pop_back();
+    }
+    while (owners.size() > 1 && owners[1].begin <= oldest) {
+      owners.erase(owners.begin());
+    }
+    owners.push_back({end, thread_index, {}});
+  }
+
+  void record(const char *name, TracePhase phase, int64_t cycles) {
+    uint64_t index = write_index.load(std::memory_order_relaxed);
+    TraceEvent &event = events[index & (capacity - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.cycles.store(cycles, std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    write_index.store(index + 1, std::memory_order_release);
+  }
+};
+
+struct TraceThreadState {
+  TraceBuffer *buffer = nullptr;
+  uint32_t depth = 0;
+  uint32_t sample_counter = 0;
+  bool sampled = false;
+
+  TraceThreadState() = default;
+  TraceThreadState(const TraceThreadState &) = delete;
+  TraceThreadState &operator=(const TraceThreadState &) = delete;
+  ~TraceThreadState();
+};
+
+inline thread_local TraceThreadState traceThreadState;
+
+inline void appendJsonString(fmt::memory_buffer &output,
+                             std::string_view text) {
+  output.push_back('"');
+  for (char character : text) {
+    if (character == '"' || character == '\\') {
+      output.push_back('\\');
+      output.push_back(character);
+    } else if ((unsigned char)character < 0x20) {
+      fmt::format_to(std::back_inserter(output), "\\u{:04x}",
+                     (unsigned)character);
+    } else {
+      output.push_back(character);
+    }
+  }
+  output.push_back('"');
+}
+
+inline struct TraceRegistry {
+  static constexpr size_t default_buffer_capacity = 65536;
+
+  std::atomic_bool enabled = false;
+  std::atomic_uint32_t sample_period = 1;
+  size_t buffer_capacity = default_buffer_capacity;
+  SpinMutex buffers_mutex;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  // Buffers of exited threads, taken over by the next registering thread so
+  // that thread churn does not allocate a new ring per thread.
+  std::vector<TraceBuffer *> free_buffers;
+  uint32_t next_thread_index = 1;
+
+  void start(uint32_t period = 1) {
+    sample_period.store(std::max<uint32_t>(period, 1),
+                        std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_relaxed);
+  }
+
+  void stop() { enabled.store(false, std::memory_order_relaxed); }
+
+  void clear() {
+    std::lock_guard lock(buffers_mutex);
+    for (auto &buffer : buffers) {
+      buffer->cleared_index.store(
+          buffer->write_index.load(std::memory_order_acquire),
+          std::memory_order_relaxed);
+      buffer->owners.erase(buffer->owners.begin(), buffer->owners.end() - 1);
+    }
+    // Exited threads have nothing left to export.
+    for (TraceBuffer *buffer : free_buffers) {
+      buffer->owners.back().thread_name.clear();
+    }
+  }
+
+  [[gnu::noinline]] TraceBuffer &register_thread(TraceThreadState &state) {
+    std::lock_guard lock(buffers_mutex);
+    size_t capacity = 1;
+    while (capacity < buffer_capacity) {
+      capacity *= 2;
+    }
+    uint32_t thread_index = next_thread_index++;
+    for (size_t i = free_buffers.size(); i != 0; --i) {
+      TraceBuffer *buffer = free_buffers[i - 1];
+      if (buffer->capacity == capacity) {
+        free_buffers.erase(free_buffers.begin() + (i - 1));
+        buffer->take_over(thread_index);
+        state.buffer = buffer;
+        return *buffer;
+      }
+    }
+    buffers.push_back(std::make_unique<TraceBuffer>(thread_index, capacity));
+    state.buffer = buffers.back().get();
+    return *state.buffer;
+  }
+
+  void release_thread(TraceThreadState &state) {
+    std::lock_guard lock(buffers_mutex);
+    free_buffers.push_back(state.buffer);
+    state.buffer = nullptr;
+  }
+
+  void record(const char *name, TracePhase phase) {
+    int64_t cycles = __rdtsc();
+    TraceThreadState &state = traceThreadState;
+    TraceBuffer *buffer = state.buffer;
+    if (!buffer) {
+      [[unlikely]];
+      buffer = &register_thread(state);
+    }
+    buffer->record(name, phase, cycles);
+  }
+
+  void set_thread_name(std::string_view name) {
+    TraceThreadState &state = traceThreadState;
+    TraceBuffer &buffer = state.buffer ? *state.buffer : register_thread(state);
+    std::lock_guard lock(buffers_mutex);
+    buffer.owners.back().thread_name = name;
+  }
+
+  std::string export_chrome_json() {
+    int64_t anchor_time = time_manager.get_current_time();
+    int64_t anchor_cycles = __rdtsc();
+    int process_id = getpid();
+    fmt::memory_buffer output;
+    fmt::format_to(std::back_inserter(output), "{{\"traceEvents\":[");
+    bool first = true;
+    auto separator = [&] {
+      if (!first) {
+        output.push_back(',');
+      }
+      first = false;
+    };
+
+    std::lock_guard lock(buffers_mutex);
+    for (auto &buffer : buffers) {
+      for (auto &owner : buffer->owners) {
+        if (!owner.thread_name.empty()) {
+          separator();
+          fmt::format_to(
+              std::back_inserter(output),
+              "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},"
+              "\"tid\":{},\"args\":{{\"name\":",
+              process_id, owner.thread_index);
+          appendJsonString(output, owner.thread_name);
+          fmt::format_to(std::back_inserter(output), "}}}}");
+        }
+      }
+
+      uint64_t end = buffer->write_index.load(std::memory_order_acquire);
+      uint64_t begin = std::max<uint64_t>(
+          buffer->cleared_index.load(std::memory_order_relaxed),
+          end > buffer->capacity ? end - buffer->capacity : 0);
+      uint64_t event_count = end - begin;
+      std::vector<const char *> names(event_count);
+      std::vector<int64_t> cycles(event_count);
+      std::vector<TracePhase> phases(event_count);
+      for (uint64_t i = 0; i != event_count; ++i) {
+        TraceEvent &event =
+            buffer->events[(begin + i) & (buffer->capacity - 1)];
+        names[i] = event.name.load(std::memory_order_relaxed);
+        cycles[i] = event.cycles.load(std::memory_order_relaxed);
+        phases[i] = event.phase.load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t overwritten_end =
+          buffer->write_index.load(std::memory_order_relaxed);
+      uint64_t first_valid =
+          overwritten_end > buffer->capacity
+              ? std::max(begin, overwritten_end - buffer->capacity)
+              : begin;
+
+      int64_t depth = 0;
+      size_t owner = 0;
+      for (uint64_t i = first_valid - begin; i != event_count; ++i) {
+        while (owner + 1 != buffer->owners.size() &&
+               buffer->owners[owner + 1].begin <= begin + i) {
+          ++owner;
+          depth = 0;
+        }
+        if (phases[i] == TracePhase::TRACE_END) {
+          if (depth == 0) {
+            continue;
+          }
+          --depth;
+        } else {
+          ++depth;
+        }
+        int64_t timestamp =
+            anchor_time +
+            time_manager.cycles_to_nanoseconds(cycles[i] - anchor_cycles);
+        separator();
+        fmt::format_to(std::back_inserter(output), "{{\"name\":");
+        appendJsonString(output, names[i] ? names[i] : "");
+        fmt::format_to(std::back_inserter(output),
+                       ",\"ph\":\"{}\",\"ts\":{}.{:03},\"pid\":{},\"tid\":{}}}",
+                       (char)phases[i], timestamp / 1000, timestamp % 1000,
+                       process_id, buffer->owners[owner].thread_index);
+      }
+    }
+    fmt::format_to(std::back_inserter(output),
+                   "],\"displayTimeUnit\":\"ns\"}}\n");
+    return fmt::to_string(output);
+  }
+
+  bool write_chrome_trace(const char *path) {
+    std::string json = export_chrome_json();
+    FILE *file = std::fopen(path, "w");
+    if (!file) {
+      messageWriter.error("Failed to open trace file %s: %s", path,
+                          std::strerror(errno));
+      return false;
+    }
+    bool success = std::fwrite(json.data(), 1, json.size(), file) ==
+                   json.size();
+    success = std::fclose(file) == 0 && success;
+    if (!success) {
+      messageWriter.error("Failed to write trace file %s: %s", path,
+                          std::strerror(errno));
+    }
+    return success;
+  }
+} traceRegistry;
+
+inline TraceThreadState::~TraceThreadState() {
+  if (buffer) {
+    traceRegistry.release_thread(*this);
+  }
+}
+
+class TraceScope {
+  const char *name;
+  bool is_recording;
+
+public:
+  explicit TraceScope(const char *name) : name(name) {
+    TraceThreadState &state = traceThreadState;
+    if (state.depth++ == 0) {
+      state.sampled =
+          traceRegistry.enabled.load(std::memory_order_relaxed) &&
+          state.sample_counter++ %
+                  traceRegistry.sample_period.load(std::memory_order_relaxed) ==
+              0;
+    }
+    is_recording = state.sampled;
+    if (is_recording) {
+      [[unlikely]];
+      traceRegistry.record(name, TracePhase::TRACE_BEGIN);
+    }
+  }
+
+  ~TraceScope() {
+    --traceThreadState.depth;
+    if (is_recording) {
+      [[unlikely]];
+      traceRegistry.record(name, TracePhase::TRACE_END);
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+};
+
+#define TURBOKIT_TRACE_CONCAT_IMPL(a, b) a##b
+#define TURBOKIT_TRACE_CONCAT(a, b) TURBOKIT_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef TURBOKIT_DISABLE_TRACING
+#define TURBOKIT_TRACE_SCOPE(name)                                             \
+  do {                                                                         \
+  } while (0)
+#else
+#define TURBOKIT_TRACE_SCOPE(name)                                             \
+  ::turbokit::TraceScope TURBOKIT_TRACE_CONCAT(turbokit_trace_scope_,          \
+                                               __LINE__)(name)
+#endif
+
+} // namespace turbokit
@@ -20,9 +20,9 @@ private:
   ElementType *current_end = nullptr;
   size_t element_count = 0;
 
+public:
   using value_type = ElementType;
 
-public:
   DynamicArray() = default;
 
   DynamicArray(const DynamicArray &other) { *this = other; }
@@ -221,6 +221,15 @@ public:
     element_count = new_size;
   }
 
+  // Sets the size without initializing new elements; the caller overwrites
+  // them before reading.
+  void resize_for_overwrite(size_t new_size) {
+    static_assert(std::is_trivial_v<ElementType>);
+    reserve(new_size);
+    current_end = current_start + new_size;
+    element_count = new_size;
+  }
+
   bool is_empty() const { return current_start == current_end; }
 
   size_t get_capacity() { return memory_limit - current_start; }
@@ -1,6 +1,10 @@
 #include "buffer.h"
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace turbokit;
@@ -13,7 +17,7 @@ protected:
 
 TEST_F(BufferTest, BufferAllocation) {
   const size_t size = 1024;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
 
   EXPECT_NE(buffer, nullptr);
   EXPECT_EQ(buffer->get_size(), size);
@@ -24,7 +28,7 @@ TEST_F(BufferTest, BufferAllocation) {
 
 TEST_F(BufferTest, BufferDataAccess) {
   const size_t size = 100;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
 
   std::byte *data = buffer->get_data();
   EXPECT_NE(data, nullptr);
@@ -48,7 +52,7 @@ TEST_F(BufferTest, BufferHandleDefaultConstruction) {
 
 TEST_F(BufferTest, BufferHandleExplicitConstruction) {
   const size_t size = 512;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
 
   BufferHandle handle(buffer);
   EXPECT_TRUE(handle);
@@ -59,7 +63,7 @@ TEST_F(BufferTest, BufferHandleExplicitConstruction) {
 
 TEST_F(BufferTest, BufferHandleMoveConstruction) {
   const size_t size = 256;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   BufferHandle original(buffer);
 
   BufferHandle moved(std::move(original));
@@ -71,8 +75,8 @@ TEST_F(BufferTest, BufferHandleMoveAssignment) {
   const size_t size1 = 100;
   const size_t size2 = 200;
 
-  Buffer *buffer1 = createMemoryBlock(size1);
-  Buffer *buffer2 = createMemoryBlock(size2);
+  Buffer *buffer1 = MemoryBlock::create(size1);
+  Buffer *buffer2 = MemoryBlock::create(size2);
 
   BufferHandle handle1(buffer1);
   BufferHandle handle2(buffer2);
@@ -86,7 +90,7 @@ TEST_F(BufferTest, BufferHandleMoveAssignment) {
 
 TEST_F(BufferTest, BufferHandleRelease) {
   const size_t size = 128;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   BufferHandle handle(buffer);
 
   Buffer *released = handle.relinquish();
@@ -98,7 +102,7 @@ TEST_F(BufferTest, BufferHandleRelease) {
 
 TEST_F(BufferTest, SharedBufferHandleConstruction) {
   const size_t size = 256;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
 
   SharedBufferHandle handle(buffer);
@@ -108,7 +112,7 @@ TEST_F(BufferTest, SharedBufferHandleConstruction) {
 
 TEST_F(BufferTest, SharedBufferHandleCopyConstruction) {
   const size_t size = 128;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
 
   SharedBufferHandle handle1(buffer);
@@ -127,7 +131,7 @@ protected:
 
 TEST_F(SharedBufferHandleTest, SharedBufferHandleAssignment) {
   const size_t size = 64;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
 
   SharedBufferHandle handle1(buffer);
@@ -142,7 +146,7 @@ TEST_F(SharedBufferHandleTest, SharedBufferHandleAssignment) {
 
 TEST_F(BufferTest, SharedBufferHandleRefCounting) {
   const size_t size = 512;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
 
   {
@@ -177,7 +181,7 @@ TEST_F(BufferTest, MakeBufferFunction) {
 
 TEST_F(BufferTest, BufferAlignment) {
   const size_t size = 1024;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
 
   // Test that the buffer is properly aligned
   uintptr_t data_addr = reinterpret_cast<uintptr_t>(buffer->get_data());
@@ -194,7 +198,7 @@ TEST_F(BufferTest, BufferAlignment) {
 
 TEST_F(BufferTest, LargeBufferAllocation) {
   const size_t size = 1024 * 1024; // 1MB
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
 
   EXPECT_NE(buffer, nullptr);
   EXPECT_EQ(buffer->get_size(), size);
@@ -214,7 +218,7 @@ TEST_F(BufferTest, LargeBufferAllocation) {
 }
 
 TEST_F(BufferTest, ZeroSizeBuffer) {
-  Buffer *buffer = createMemoryBlock(0);
+  Buffer *buffer = MemoryBlock::create(0);
 
   EXPECT_NE(buffer, nullptr);
   EXPECT_EQ(buffer->get_size(), 0);
@@ -224,7 +228,7 @@ TEST_F(BufferTest, ZeroSizeBuffer) {
 
 TEST_F(BufferTest, BufferHandleOperatorBool) {
   const size_t size = 256;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   BufferHandle valid_handle(buffer);
   BufferHandle invalid_handle;
 
@@ -234,7 +238,7 @@ TEST_F(BufferTest, BufferHandleOperatorBool) {
 
 TEST_F(BufferTest, SharedBufferHandleOperatorBool) {
   const size_t size = 128;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
   SharedBufferHandle valid_handle(buffer);
   SharedBufferHandle invalid_handle;
@@ -245,7 +249,7 @@ TEST_F(BufferTest, SharedBufferHandleOperatorBool) {
 
 TEST_F(BufferTest, BufferHandleOperatorArrow) {
   const size_t size = 512;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   BufferHandle handle(buffer);
 
   EXPECT_EQ(handle->get_size(), size);
@@ -254,7 +258,7 @@ TEST_F(BufferTest, BufferHandleOperatorArrow) {
 
 TEST_F(BufferTest, SharedBufferHandleOperatorArrow) {
   const size_t size = 256;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
   SharedBufferHandle handle(buffer);
 
@@ -264,7 +268,7 @@ TEST_F(BufferTest, SharedBufferHandleOperatorArrow) {
 
 TEST_F(BufferTest, BufferHandleConversion) {
   const size_t size = 128;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   BufferHandle handle(buffer);
 
   Buffer *converted = handle;
@@ -273,7 +277,7 @@ TEST_F(BufferTest, BufferHandleConversion) {
 
 TEST_F(BufferTest, SharedBufferHandleConversion) {
   const size_t size = 64;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
   SharedBufferHandle handle(buffer);
 
@@ -296,12 +300,237 @@ TEST_F(BufferTest, MultipleBufferHandles) {
 
 TEST_F(BufferTest, SharedBufferHandleMultipleReferences) {
   const size_t size = 1024;
-  Buffer *buffer = createMemoryBlock(size);
+  Buffer *buffer = MemoryBlock::create(size);
   buffer->reference_count.store(0, std::memory_order_relaxed);
 
   SharedBufferHandle handle1(buffer);
-  SharedBufferHandle handle2(buffer);
-  SharedBufferHandle handle3(buffer);
+  SharedBufferHandle handle2(handle1);
+  SharedBufferHandle handle3(handle2);
 
   EXPECT_EQ(buffer->reference_count.load(), 3);
-}
\ No newline at end of file
+}
+
+TEST_F(BufferTest, PooledBlocksAreRecycled) {
+  Buffer *first = MemoryBlock::create(100);
+  EXPECT_EQ(first->get_size(), 100u);
+  Buffer::destroy(first);
+
+  Buffer *second = MemoryBlock::create(128);
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second->get_size(), 128u);
+  EXPECT_EQ(second->reference_count.load(), 0u);
+  Buffer::destroy(second);
+
+  Buffer *other_class = MemoryBlock::create(129);
+  EXPECT_NE(other_class, first);
+  Buffer::destroy(other_class);
+}
+
+TEST_F(BufferTest, SizeClasses) {
+  EXPECT_EQ(MemoryBlockSizeClasses::index_of(0), 0u);
+  EXPECT_EQ(MemoryBlockSizeClasses::index_of(64), 0u);
+  EXPECT_EQ(MemoryBlockSizeClasses::index_of(65), 1u);
+  EXPECT_EQ(MemoryBlockSizeClasses::index_of(4096), 6u);
+  EXPECT_EQ(
+      MemoryBlockSizeClasses::index_of(MemoryBlockSizeClasses::maximum_size),
+      MemoryBlockSizeClasses::count - 1);
+  for (size_t bytes : {1u, 63u, 64u, 65u, 1000u, 65536u}) {
+    size_t index = MemoryBlockSizeClasses::index_of(bytes);
+    EXPECT_GE(MemoryBlockSizeClasses::size_of(index), bytes);
+  }
+}
+
+TEST_F(BufferTest, LargeBlocksBypassPool) {
+  const size_t size = MemoryBlockSizeClasses::maximum_size + 1;
+  Buffer *buffer = MemoryBlock::create(size);
+  EXPECT_EQ(buffer->size_class, 0u);
+  buffer->get_data()[size - 1] = std::byte(1);
+  Buffer::destroy(buffer);
+}
+
+TEST_F(BufferTest, PooledBlocksMoveBetweenThreads) {
+  const size_t block_count = 20000;
+  std::vector<Buffer *> blocks(block_count);
+  std::thread producer([&] {
+    for (auto &block : blocks) {
+      block = MemoryBlock::create(1000);
+      std::memset(block->get_data(), 0xAB, 1000);
+    }
+  });
+  producer.join();
+
+  std::thread consumer([&] {
+    for (auto *block : blocks) {
+      EXPECT_EQ(block->get_data()[999], std::byte(0xAB));
+      Buffer::destroy(block);
+    }
+  });
+  consumer.join();
+
+  std::vector<Buffer *> reused(block_count);
+  for (auto &block : reused) {
+    block = MemoryBlock::create(1000);
+    EXPECT_EQ(block->get_size(), 1000u);
+  }
+  for (auto *block : reused) {
+    Buffer::destroy(block);
+  }
+}
+
+TEST_F(BufferTest, SharedBufferHandleCopyAssignmentReleasesPrevious) {
+  Buffer *first = MemoryBlock::create(64);
+  Buffer *second = MemoryBlock::create(64);
+  SharedBufferHandle handle1(first);
+  SharedBufferHandle handle2(second);
+  SharedBufferHandle observer(handle2);
+  EXPECT_EQ(second->reference_count.load(), 2);
+
+  handle2 = handle1;
+  EXPECT_EQ(first->reference_count.load(), 2);
+  EXPECT_EQ(second->reference_count.load(), 1);
+
+  handle2 = handle2;
+  EXPECT_EQ(first->reference_count.load(), 2);
+}
+
+TEST_F(BufferTest, BufferSliceSharesBlock) {
+  BufferSlice whole(makeBuffer(100));
+  ASSERT_TRUE(whole);
+  EXPECT_EQ(whole.get_size(), 100u);
+  for (size_t i = 0; i != 100; ++i) {
+    whole.get_data()[i] = std::byte(i);
+  }
+  EXPECT_EQ(whole.get_block()->reference_count.load(), 1);
+
+  BufferSlice part = whole.slice(10, 20);
+  EXPECT_EQ(whole.get_block()->reference_count.load(), 2);
+  EXPECT_EQ(part.get_size(), 20u);
+  EXPECT_EQ(part.get_offset(), 10u);
+  EXPECT_EQ(part.get_data()[0], std::byte(10));
+  EXPECT_EQ(part.get_data(), whole.get_data() + 10);
+
+  BufferSlice nested = part.slice(5);
+  EXPECT_EQ(nested.get_size(), 15u);
+  EXPECT_EQ(nested.get_data()[0], std::byte(15));
+  EXPECT_EQ(whole.get_block()->reference_count.load(), 3);
+
+  BufferSlice moved = std::move(nested).slice(1, 2);
+  EXPECT_EQ(moved.get_data()[0], std::byte(16));
+  EXPECT_EQ(whole.get_block()->reference_count.load(), 3);
+}
+
+TEST_F(BufferTest, BufferSliceOutlivesOriginal) {
+  BufferSlice part;
+  {
+    BufferSlice whole(makeBuffer(16));
+    std::memset(whole.get_data(), 7, 16);
+    part = whole.slice(8, 8);
+  }
+  EXPECT_EQ(part.get_block()->reference_count.load(), 1);
+  EXPECT_EQ(part.get_data()[7], std::byte(7));
+}
+
+TEST_F(BufferTest, BufferSliceBounds) {
+  BufferSlice whole(makeBuffer(32));
+  EXPECT_THROW(whole.slice(33), std::out_of_range);
+  EXPECT_THROW(whole.slice(16, 17), std::out_of_range);
+  EXPECT_NO_THROW(whole.slice(32));
+  EXPECT_TRUE(whole.slice(32).empty());
+
+  BufferSlice trimmed = whole;
+  trimmed.remove_prefix(4);
+  trimmed.remove_suffix(4);
+  EXPECT_EQ(trimmed.get_size(), 24u);
+  EXPECT_EQ(trimmed.get_data(), whole.get_data() + 4);
+  EXPECT_THROW(trimmed.remove_prefix(25), std::out_of_range);
+
+  EXPECT_THROW(BufferSlice(whole.get_block(), 30, 3), std::out_of_range);
+  BufferSlice empty;
+  EXPECT_FALSE(empty);
+  EXPECT_EQ(empty.get_size(), 0u);
+}
+
+TEST_F(BufferTest, BufferSlicesAcrossThreads) {
+  BufferSlice frame(makeBuffer(4000));
+  for (size_t i = 0; i != 4000; ++i) {
+    frame.get_data()[i] = std::byte(i / 1000);
+  }
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i != 4; ++i) {
+    workers.emplace_back([message = frame.slice(i * 1000, 1000), i] {
+      for (size_t j = 0; j != message.get_size(); ++j) {
+        EXPECT_EQ(message.get_data()[j], std::byte(i));
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(frame.get_block()->reference_count.load(), 1);
+}
+
+TEST_F(BufferTest, MappedAllocation) {
+  const size_t size = 3 * 1024 * 1024 + 5;
+  for (auto allocation : {ALLOCATE_MAPPED, ALLOCATE_HUGEPAGES}) {
+    UniqueMemoryBlock block = createMemoryBlock(size, allocation);
+    EXPECT_EQ(block->get_size(), size);
+    EXPECT_EQ(block->allocation, allocation);
+    EXPECT_EQ(block->size_class, 0u);
+    EXPECT_EQ((uintptr_t)block->get_data() % alignof(std::max_align_t), 0u);
+    std::memset(block->get_data(), 0xab, size);
+    EXPECT_EQ(block->get_data()[size - 1], std::byte(0xab));
+  }
+
+  UniqueMemoryBlock huge = createMemoryBlock(4096, ALLOCATE_HUGEPAGES);
+  EXPECT_EQ((uintptr_t)(MemoryBlock *)huge %
+                MemoryBlockMapping::huge_page_size,
+            0u);
+
+  SharedMemoryBlock shared(MemoryBlock::create(100, ALLOCATE_MAPPED));
+  BufferSlice slice(shared, 10, 20);
+  shared = nullptr;
+  EXPECT_EQ(slice.get_block()->reference_count.load(), 1);
+}
+
+TEST_F(BufferTest, HugeTlbAllocation) {
+  try {
+    UniqueMemoryBlock block = createMemoryBlock(1000, ALLOCATE_HUGETLB);
+    EXPECT_EQ(block->allocation, ALLOCATE_HUGETLB);
+    std::memset(block->get_data(), 1, 1000);
+  } catch (const std::runtime_error &) {
+    GTEST_SKIP() << "no huge pages reserved";
+  }
+}
+
+TEST_F(BufferTest, MappedFile) {
+  std::string path = ::testing::TempDir() + "turbokit_mapped_file.bin";
+  std::string contents(10000, '\0');
+  for (size_t i = 0; i != contents.size(); ++i) {
+    contents[i] = (char)(i * 7);
+  }
+  std::ofstream(path, std::ios::binary) << contents;
+
+  {
+    BufferSlice file(mapMemoryBlock(path));
+    EXPECT_EQ(file.get_block()->allocation, ALLOCATE_MAPPED_FILE);
+    EXPECT_EQ(file.view(), contents);
+    EXPECT_EQ((uintptr_t)file.get_data() % MemoryBlockMapping::page_size(),
+              0u);
+    file.get_data()[0] = std::byte(0xff);
+  }
+  {
+    UniqueMemoryBlock file = mapMemoryBlock(path, true);
+    EXPECT_EQ(file->get_data()[0], std::byte(contents[0]));
+    file->get_data()[1] = std::byte('x');
+  }
+  contents[1] = 'x';
+  std::ifstream input(path, std::ios::binary);
+  std::string stored((std::istreambuf_iterator<char>(input)),
+                     std::istreambuf_iterator<char>());
+  EXPECT_EQ(stored, contents);
+
+  std::ofstream(path, std::ios::binary | std::ios::trunc);
+  EXPECT_EQ(mapMemoryBlock(path)->get_size(), 0u);
+  std::remove(path.c_str());
+  EXPECT_THROW(mapMemoryBlock(path), std::runtime_error);
+}
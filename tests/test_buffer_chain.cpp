@@ -0,0 +1,198 @@
+#include "buffer_chain.h"
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace turbokit;
+
+class BufferChainTest : public ::testing::Test {
+protected:
+  static BufferSlice makeSlice(std::string_view text) {
+    UniqueMemoryBlock block = createMemoryBlock(text.size());
+    std::memcpy(block->get_data(), text.data(), text.size());
+    return BufferSlice(std::move(block));
+  }
+};
+
+TEST_F(BufferChainTest, AppendAndPrepend) {
+  BufferChain chain;
+  EXPECT_TRUE(chain.empty());
+  chain.append(makeSlice("body"));
+  chain.prepend(makeSlice("header:"));
+  chain.append(makeSlice(";trailer"));
+  chain.append(BufferSlice());
+
+  EXPECT_EQ(chain.size(), 19u);
+  EXPECT_EQ(chain.segment_count(), 3u);
+  EXPECT_EQ(chain.to_string(), "header:body;trailer");
+}
+
+TEST_F(BufferChainTest, AppendSharesBlocks) {
+  BufferSlice payload = makeSlice("shared payload");
+  BufferChain chain;
+  chain.append(payload.slice(7));
+  chain.append(payload.slice(0, 6));
+
+  EXPECT_EQ(payload.get_block()->reference_count.load(), 3u);
+  EXPECT_EQ(chain.to_string(), "payloadshared");
+  chain.clear();
+  EXPECT_EQ(payload.get_block()->reference_count.load(), 1u);
+}
+
+TEST_F(BufferChainTest, WriteGrowsTail) {
+  BufferChain chain;
+  std::string data(BufferChain::default_segment_size * 2 + 100, 'x');
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = (char)('a' + i % 26);
+  }
+  chain.write(data.data(), 10);
+  chain.write(data.data() + 10, data.size() - 10);
+
+  EXPECT_EQ(chain.size(), data.size());
+  EXPECT_EQ(chain.segment_count(), 3u);
+  EXPECT_EQ(chain.to_string(), data);
+}
+
+TEST_F(BufferChainTest, SegmentsAreRecycledThroughPool) {
+  const MemoryBlock *first_block = nullptr;
+  {
+    BufferChain chain;
+    chain.write("frame", 5);
+    chain.for_each_slice(
+        [&](const BufferSlice &slice) { first_block = slice.get_block(); });
+  }
+  const MemoryBlock *second_block = nullptr;
+  BufferChain chain;
+  chain.write("frame", 5);
+  chain.for_each_slice(
+      [&](const BufferSlice &slice) { second_block = slice.get_block(); });
+  EXPECT_EQ(second_block, first_block);
+  EXPECT_NE(second_block->size_class, 0u);
+}
+
+TEST_F(BufferChainTest, ReserveAndCommit) {
+  BufferChain chain;
+  auto [data, space] = chain.reserve_tail(5);
+  EXPECT_GE(space, 5u);
+  std::memcpy(data, "hello", 5);
+  chain.commit_tail(5);
+
+  auto [next, remaining] = chain.reserve_tail(1);
+  EXPECT_EQ(next, data + 5);
+  EXPECT_EQ(remaining, space - 5);
+  EXPECT_THROW(chain.commit_tail(remaining + 1), std::out_of_range);
+
+  EXPECT_EQ(chain.segment_count(), 1u);
+  EXPECT_EQ(chain.to_string(), "hello");
+}
+
+TEST_F(BufferChainTest, AppendedSliceIsNotWritable) {
+  BufferChain chain;
+  UniqueMemoryBlock block = createMemoryBlock(64);
+  std::memcpy(block->get_data(), "abc", 3);
+  SharedMemoryBlock shared(block.relinquish());
+  chain.append(BufferSlice(shared, 0, 3));
+  chain.write("def", 3);
+
+  EXPECT_EQ(chain.segment_count(), 2u);
+  EXPECT_EQ(std::memcmp(shared->get_data(), "abc", 3), 0);
+  EXPECT_EQ(chain.to_string(), "abcdef");
+}
+
+TEST_F(BufferChainTest, AppendSerialized) {
+  BufferChain chain;
+  chain.append_serialized(std::string("payload"), 42);
+  chain.prepend(makeSlice("frame"));
+
+  std::string text = chain.to_string();
+  ASSERT_GT(text.size(), 5u);
+  EXPECT_EQ(text.substr(0, 5), "frame");
+
+  BufferSlice body;
+  chain.for_each_slice([&](const BufferSlice &slice) { body = slice; });
+  std::string value;
+  int number = 0;
+  deserialize_buffer(body, value, number);
+  EXPECT_EQ(value, "payload");
+  EXPECT_EQ(number, 42);
+}
+
+TEST_F(BufferChainTest, SerializeSinkPatchesAcrossSegments) {
+  BufferChain chain;
+  BufferChainSerializeSink sink{chain};
+  std::byte *current = nullptr;
+  std::byte *end = nullptr;
+  sink.grow(current, end, 16);
+  size_t first_size = end - current;
+  std::memset(current, 'a', first_size);
+  current = end;
+  sink.grow(current, end, 16);
+  std::memset(current, 'b', 16);
+  current += 16;
+  sink.finish(current);
+
+  sink.patch(nullptr, first_size - 3, "PATCHED!", 8);
+  std::string text = chain.to_string();
+  ASSERT_EQ(text.size(), first_size + 16);
+  EXPECT_EQ(text.substr(first_size - 4, 10), "aPATCHED!b");
+}
+
+TEST_F(BufferChainTest, ExportIovecsAndConsume) {
+  BufferChain chain;
+  chain.append(makeSlice("one"));
+  chain.append(makeSlice("two"));
+  chain.append(makeSlice("three"));
+
+  iovec vectors[2];
+  ASSERT_EQ(chain.export_iovecs(vectors, 2), 2u);
+  EXPECT_EQ(std::string((char *)vectors[0].iov_base, vectors[0].iov_len),
+            "one");
+  EXPECT_EQ(std::string((char *)vectors[1].iov_base, vectors[1].iov_len),
+            "two");
+
+  chain.consume(4);
+  EXPECT_EQ(chain.segment_count(), 2u);
+  EXPECT_EQ(chain.to_string(), "wothree");
+  chain.consume(100);
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(chain.segment_count(), 0u);
+}
+
+TEST_F(BufferChainTest, WriteToFileDescriptor) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  BufferChain chain;
+  chain.append(makeSlice("world"));
+  chain.prepend(makeSlice("hello "));
+  chain.write("!", 1);
+
+  EXPECT_EQ(chain.write_to(fds[1]), 12);
+  EXPECT_TRUE(chain.empty());
+  char result[16] = {};
+  EXPECT_EQ(::read(fds[0], result, sizeof(result)), 12);
+  EXPECT_EQ(std::string(result), "hello world!");
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST_F(BufferChainTest, MoveAndSplice) {
+  BufferChain first;
+  first.append(makeSlice("abc"));
+  BufferChain second;
+  second.append(makeSlice("def"));
+  second.append(makeSlice("ghi"));
+
+  first.append(std::move(second));
+  EXPECT_TRUE(second.empty());
+  EXPECT_EQ(second.segment_count(), 0u);
+  EXPECT_EQ(first.segment_count(), 3u);
+
+  BufferChain moved(std::move(first));
+  EXPECT_TRUE(first.empty());
+  EXPECT_EQ(moved.to_string(), "abcdefghi");
+}
@@ -228,4 +228,113 @@ TEST_F(ClockTest, FastClockArithmetic) {
 
   auto sum = time1 + diff;
   EXPECT_EQ(sum, time2);
-}
\ No newline at end of file
+}
+
+static int64_t steadyNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+TEST_F(ClockTest, CalibratedFromFirstCallWhenFrequencyKnown) {
+  if (!hasReliableTsc() || detectTscFrequency() == 0) {
+    GTEST_SKIP() << "TSC frequency not reported by CPUID or the kernel";
+  }
+  Clock fresh_clock;
+  EXPECT_GT(fresh_clock.calibration.cycle_threshold.load(), 0);
+  EXPECT_GT(fresh_clock.calibration.cycle_multiplier.load(), 0u);
+  auto expected = steadyNanoseconds();
+  EXPECT_NEAR(fresh_clock.get_current_time(), expected, 1000000);
+}
+
+TEST_F(ClockTest, DetectedFrequencyIsPlausible) {
+  uint64_t frequency = detectTscFrequency();
+  if (frequency == 0) {
+    GTEST_SKIP() << "TSC frequency not reported by CPUID or the kernel";
+  }
+  EXPECT_GT(frequency, 100000000u);
+  EXPECT_LT(frequency, 10000000000u);
+}
+
+TEST_F(ClockTest, SteadyClockFallbackWhenTscUnreliable) {
+  Clock fallback_clock;
+  fallback_clock.use_steady_clock = true;
+  fallback_clock.publish_calibration(0, 0, 0, 0);
+  for (int i = 0; i != 10; ++i) {
+    auto expected = steadyNanoseconds();
+    EXPECT_NEAR(fallback_clock.get_current_time(), expected, 1000000);
+  }
+  EXPECT_EQ(fallback_clock.calibration.cycle_threshold.load(), 0);
+
+  // Cycle conversions measure the multiplier once and then reuse it.
+  int64_t first = fallback_clock.cycles_to_nanoseconds(1000000);
+  EXPECT_GT(first, 0);
+  auto start = steadyNanoseconds();
+  for (int i = 0; i != 100; ++i) {
+    EXPECT_EQ(fallback_clock.cycles_to_nanoseconds(1000000), first);
+  }
+  EXPECT_LT(steadyNanoseconds() - start, 10000000);
+}
+
+static int64_t systemNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+TEST_F(ClockTest, WallTimeTracksSystemClock) {
+  for (int i = 0; i != 20; ++i) {
+    auto expected = systemNanoseconds();
+    EXPECT_NEAR(time_manager.get_wall_time(), expected, 2000000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+TEST_F(ClockTest, WallTimeIsMonotonicAcrossCalibrations) {
+  int64_t previous = time_manager.get_wall_time();
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+  while (std::chrono::steady_clock::now() < end) {
+    int64_t current = time_manager.get_wall_time();
+    ASSERT_GE(current, previous);
+    previous = current;
+  }
+}
+
+TEST_F(ClockTest, WallTimeSlewsSmallOffsets) {
+  Clock wall_clock;
+  wall_clock.measure_cycle_multiplier();
+  auto &calibration = wall_clock.calibration;
+  int64_t offset = 200000;
+  calibration.base_wall_time.store(calibration.base_wall_time.load() + offset);
+  int64_t before = wall_clock.get_wall_time();
+  wall_clock.publish_calibration(
+      wall_clock.get_current_time(), __rdtsc(),
+      calibration.cycle_multiplier.load(), calibration.cycle_threshold.load());
+  EXPECT_GE(wall_clock.get_wall_time(), before);
+  EXPECT_LT(calibration.wall_cycle_multiplier.load(),
+            calibration.cycle_multiplier.load());
+  EXPECT_GT(wall_clock.get_wall_time() - systemNanoseconds(), offset / 2);
+}
+
+TEST_F(ClockTest, WallTimeStepsLargeOffsets) {
+  Clock wall_clock;
+  wall_clock.measure_cycle_multiplier();
+  auto &calibration = wall_clock.calibration;
+  calibration.base_wall_time.store(calibration.base_wall_time.load() +
+                                   100000000);
+  wall_clock.publish_calibration(
+      wall_clock.get_current_time(), __rdtsc(),
+      calibration.cycle_multiplier.load(), calibration.cycle_threshold.load());
+  EXPECT_NEAR(wall_clock.get_wall_time(), systemNanoseconds(), 1000000);
+}
+
+TEST_F(ClockTest, HighPerformanceSystemClockConversions) {
+  auto now = HighPerformanceSystemClock::now();
+  std::time_t seconds = HighPerformanceSystemClock::to_time_t(now);
+  EXPECT_NEAR((double)seconds, (double)std::time(nullptr), 2.0);
+  auto round_trip = HighPerformanceSystemClock::from_time_t(seconds);
+  EXPECT_LE(round_trip, now);
+  EXPECT_LT(now - round_trip, std::chrono::seconds(1));
+  EXPECT_NEAR(HighPerformanceSystemClock::unix_nanoseconds(),
+              systemNanoseconds(), 2000000);
+}
@@ -0,0 +1,88 @@
+#include "coarse_clock.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace turbokit;
+
+class CoarseClockTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(CoarseClockTest, InitializedOnConstruction) {
+  CoarseClock coarse;
+  EXPECT_GT(coarse.now(), 0);
+  EXPECT_GT(coarse.wall_now(), 0);
+  EXPECT_FALSE(coarse.is_running());
+}
+
+TEST_F(CoarseClockTest, ManualUpdateAdvances) {
+  CoarseClock coarse;
+  int64_t before = coarse.now();
+  EXPECT_EQ(coarse.now(), before);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  coarse.update();
+  EXPECT_GE(coarse.now() - before, 1000000);
+}
+
+TEST_F(CoarseClockTest, TickerTracksClock) {
+  CoarseClock coarse;
+  coarse.start(std::chrono::microseconds(100));
+  EXPECT_TRUE(coarse.is_running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  int64_t difference = time_manager.get_current_time() - coarse.now();
+  EXPECT_GE(difference, 0);
+  EXPECT_LT(difference, 10000000);
+
+  int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+  EXPECT_LT(std::abs(wall - coarse.wall_now()), 10000000);
+
+  coarse.stop();
+  EXPECT_FALSE(coarse.is_running());
+  int64_t stopped = coarse.now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_EQ(coarse.now(), stopped);
+}
+
+TEST_F(CoarseClockTest, RestartAfterStop) {
+  CoarseClock coarse;
+  coarse.start();
+  coarse.start();
+  coarse.stop();
+  coarse.start(std::chrono::microseconds(100));
+  int64_t before = coarse.now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_GT(coarse.now(), before);
+}
+
+TEST_F(CoarseClockTest, StartsOnFirstRead) {
+  CoarseClock coarse{CoarseClock::StartOnFirstRead{}};
+  EXPECT_FALSE(coarse.is_running());
+  int64_t before = coarse.now();
+  EXPECT_TRUE(coarse.is_running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_GT(coarse.now(), before);
+
+  CoarseClock stopped{CoarseClock::StartOnFirstRead{}};
+  stopped.stop();
+  stopped.now();
+  EXPECT_FALSE(stopped.is_running());
+}
+
+TEST_F(CoarseClockTest, ChronoAdapters) {
+  auto monotonic = CoarseMonotonicClock::now();
+  EXPECT_LE(monotonic, HighPerformanceClock::now());
+
+  auto wall = CoarseSystemClock::now();
+  auto difference = std::chrono::system_clock::now() - wall;
+  EXPECT_LT(std::chrono::abs(difference), std::chrono::seconds(1));
+
+  EXPECT_TRUE(coarse_clock.is_running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_GT(CoarseMonotonicClock::now(), monotonic);
+}
@@ -0,0 +1,185 @@
+#include "compression.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace turbokit;
+
+class CompressionTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+struct MarketState {
+  uint32_t version = 0;
+  std::vector<std::string> symbols;
+  std::vector<int64_t> prices;
+  BufferSlice blob;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 1, symbols, prices, blob);
+  }
+};
+
+static MarketState makeMarketState(size_t count) {
+  MarketState snapshot;
+  for (size_t i = 0; i != count; ++i) {
+    snapshot.symbols.push_back("SYM" + std::to_string(i % 100));
+    snapshot.prices.push_back(10000 + (int64_t)(i % 17));
+  }
+  snapshot.blob = BufferSlice(serializeToBuffer(std::string(5000, 'b')));
+  return snapshot;
+}
+
+TEST_F(CompressionTest, CodecRoundTrip) {
+  std::mt19937 random(3);
+  std::vector<std::string> inputs = {"", "a", "abcabcabcabcabcabc",
+                                     std::string(100000, 'z')};
+  std::string text;
+  for (size_t i = 0; i != 20000; ++i) {
+    text += "word" + std::to_string(random() % 300) + ' ';
+  }
+  inputs.push_back(text);
+  std::string noise(70000, '\0');
+  for (char &c : noise) {
+    c = (char)random();
+  }
+  inputs.push_back(noise);
+
+  for (const std::string &input : inputs) {
+    std::vector<uint8_t> compressed(LzCodec::bound(input.size()));
+    size_t size =
+        LzCodec::compress(input.data(), input.size(), compressed.data());
+    ASSERT_LE(size, compressed.size());
+    std::string output(input.size(), '\0');
+    EXPECT_EQ(LzCodec::decompress(compressed.data(), size, output.data(),
+                                  output.size()),
+              input.size());
+    EXPECT_EQ(output, input);
+  }
+
+  std::vector<uint8_t> compressed(LzCodec::bound(text.size()));
+  size_t size = LzCodec::compress(text.data(), text.size(), compressed.data());
+  EXPECT_LT(size, text.size() / 2);
+  std::string small(text.size() - 1, '\0');
+  EXPECT_THROW(LzCodec::decompress(compressed.data(), size, small.data(),
+                                   small.size()),
+               DataFormatError);
+}
+
+TEST_F(CompressionTest, CompressedBufferRoundTrip) {
+  MarketState snapshot = makeMarketState(100000);
+  BufferHandle raw = serializeToBuffer(snapshot);
+  BufferHandle compressed = serializeToCompressedBuffer(snapshot);
+  EXPECT_LT(compressed->get_size(), raw->get_size() / 4);
+
+  MarketState result;
+  deserializeCompressedBuffer(compressed, result);
+  EXPECT_EQ(result.symbols, snapshot.symbols);
+  EXPECT_EQ(result.prices, snapshot.prices);
+  EXPECT_EQ(result.blob.get_size(), snapshot.blob.get_size());
+
+  std::string empty_input;
+  BufferHandle empty = compressBuffer(empty_input);
+  EXPECT_EQ(decompressBuffer(std::string_view(
+                                 (const char *)empty->get_data(),
+                                 empty->get_size()))
+                ->get_size(),
+            0u);
+}
+
+TEST_F(CompressionTest, StreamingIntoBufferChain) {
+  MarketState snapshot = makeMarketState(200000);
+  BufferChain chain;
+  serializeToCompressedChain(chain, snapshot, std::string("end"));
+  std::string bytes = chain.to_string();
+
+  MarketState result;
+  std::string end;
+  deserializeCompressedBuffer(bytes, result, end);
+  EXPECT_EQ(result.symbols, snapshot.symbols);
+  EXPECT_EQ(result.prices, snapshot.prices);
+  EXPECT_EQ(result.version, 1u);
+  EXPECT_EQ(end, "end");
+
+  BufferHandle raw = decompressBuffer(bytes);
+  BufferHandle expected = serializeToBuffer(snapshot, std::string("end"));
+  ASSERT_EQ(raw->get_size(), expected->get_size());
+  EXPECT_EQ(std::memcmp(raw->get_data(), expected->get_data(),
+                        raw->get_size()),
+            0);
+}
+
+TEST_F(CompressionTest, StagingStaysWithinBlockSize) {
+  MarketState snapshot = makeMarketState(200000);
+  ASSERT_GT(snapshot.prices.size() * sizeof(int64_t),
+            CompressedStream::block_size);
+  BufferChain chain;
+  CompressingSerializeSink sink{chain};
+  GrowableSerializeContext<CompressingSerializeSink> context{sink};
+  context(snapshot);
+  sink.finish(context.current);
+  ASSERT_TRUE(sink.staging);
+  EXPECT_LE(sink.staging->get_size(), CompressedStream::block_size);
+}
+
+TEST_F(CompressionTest, ChainRetainsAboutTheCompressedSize) {
+  MarketState snapshot = makeMarketState(1000000);
+  BufferChain chain;
+  serializeToCompressedChain(chain, snapshot);
+  ASSERT_GT(chain.segment_count(), 1u);
+  size_t retained = 0;
+  const MemoryBlock *previous = nullptr;
+  chain.for_each_slice([&](const BufferSlice &slice) {
+    if (slice.get_block() != previous) {
+      previous = slice.get_block();
+      retained += previous->get_size();
+    }
+  });
+  EXPECT_LE(retained, chain.size() + BufferChain::default_segment_size);
+}
+
+TEST_F(CompressionTest, RejectsImplausibleBlockSizes) {
+  std::string zeros(CompressedStream::block_size, '\0');
+  BufferHandle compressed = compressBuffer(zeros);
+  std::string bytes((const char *)compressed->get_data(),
+                    compressed->get_size());
+  EXPECT_EQ(decompressBuffer(bytes)->get_size(), zeros.size());
+
+  // A header claiming a full block from one stored byte.
+  std::string hostile(bytes.data(), CompressedStream::magic_size);
+  uint32_t header[2] = {(uint32_t)CompressedStream::block_size, 1};
+  hostile.append((const char *)header, sizeof(header));
+  hostile += '\0';
+  EXPECT_THROW(CompressedStream::raw_size(hostile), DataFormatError);
+  EXPECT_THROW(decompressBuffer(hostile), DataFormatError);
+}
+
+TEST_F(CompressionTest, RejectsCorruptStreams) {
+  BufferHandle compressed = serializeToCompressedBuffer(makeMarketState(1000));
+  std::string bytes((const char *)compressed->get_data(),
+                    compressed->get_size());
+  MarketState result;
+  EXPECT_THROW(deserializeCompressedBuffer(bytes.substr(0, 2), result),
+               DataFormatError);
+  EXPECT_THROW(deserializeCompressedBuffer(bytes.substr(0, bytes.size() - 1),
+                                           result),
+               DataFormatError);
+  std::string bad_magic = bytes;
+  bad_magic[0] ^= 1;
+  EXPECT_THROW(deserializeCompressedBuffer(bad_magic, result),
+               DataFormatError);
+  std::mt19937 random(5);
+  for (size_t i = 0; i != 200; ++i) {
+    std::string corrupt = bytes;
+    corrupt[CompressedStream::magic_size + random() % (bytes.size() - 4)] ^=
+        (char)(1 + random() % 255);
+    try {
+      BufferHandle raw = decompressBuffer(corrupt);
+      EXPECT_LE(raw->get_size(), CompressedStream::block_size);
+    } catch (const DataFormatError &) {
+    }
+  }
+}
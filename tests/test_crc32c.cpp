@@ -0,0 +1,58 @@
+#include "crc32c.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace turbokit;
+
+class Crc32cTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(Crc32cTest, KnownValues) {
+  EXPECT_EQ(crc32c("", 0), 0u);
+  EXPECT_EQ(crc32c("123456789", 9), 0xe3069283u);
+  std::vector<uint8_t> zeros(32, 0);
+  EXPECT_EQ(crc32c(zeros.data(), zeros.size()), 0x8a9136aau);
+  std::vector<uint8_t> ones(32, 0xff);
+  EXPECT_EQ(crc32c(ones.data(), ones.size()), 0x62a8ab43u);
+  EXPECT_EQ(crc32c_software("123456789", 9), 0xe3069283u);
+}
+
+TEST_F(Crc32cTest, IncrementalMatchesWhole) {
+  std::string data(100000, '\0');
+  std::mt19937 random(7);
+  for (char &c : data) {
+    c = (char)random();
+  }
+  uint32_t whole = crc32c(data.data(), data.size());
+  for (size_t split : {0ul, 1ul, 7ul, 4096ul, 30000ul, 99999ul}) {
+    uint32_t crc = crc32c(data.data(), split);
+    crc = crc32c(data.data() + split, data.size() - split, crc);
+    EXPECT_EQ(crc, whole) << split;
+  }
+}
+
+TEST_F(Crc32cTest, HardwareMatchesSoftware) {
+  if (!crc32c_has_hardware()) {
+    GTEST_SKIP() << "no hardware crc32c";
+  }
+#if defined(__x86_64__)
+  std::vector<uint8_t> data(3 * 8192 * 2 + 3 * 256 + 100);
+  std::mt19937 random(11);
+  for (auto &byte : data) {
+    byte = (uint8_t)random();
+  }
+  for (size_t offset : {0, 1, 3, 8}) {
+    for (size_t length : {0ul, 5ul, 64ul, 767ul, 768ul, 1000ul, 24576ul,
+                          24577ul, data.size() - 8}) {
+      EXPECT_EQ(crc32c_hardware(data.data() + offset, length, 0x1234),
+                crc32c_software(data.data() + offset, length, 0x1234))
+          << offset << " " << length;
+    }
+  }
+#endif
+}
@@ -0,0 +1,198 @@
+#include "flat_serialization.h"
+#include <algorithm>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace turbokit;
+
+class FlatSerializationTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+struct Point {
+  double x;
+  double y;
+  double z;
+};
+
+struct Instrument {
+  uint64_t id = 0;
+  std::string symbol;
+  std::vector<double> prices;
+  std::optional<std::string> note;
+  std::map<std::string, int64_t> limits;
+
+  template <typename X> void serialize(X &x) {
+    x(id, symbol, prices, note, limits);
+  }
+};
+
+struct Universe {
+  std::vector<Instrument> instruments;
+  HashMap<uint64_t, uint32_t> index;
+  Point origin{};
+
+  template <typename X> void serialize(X &x) { x(instruments, index, origin); }
+};
+
+TEST_F(FlatSerializationTest, TrivialRoot) {
+  std::vector<std::byte> bytes;
+  flatSerializeTo(bytes, int32_t(-42));
+  EXPECT_EQ(flatRoot<int32_t>(std::string_view(
+                                  (const char *)bytes.data(), bytes.size()))
+                .get(),
+            -42);
+
+  BufferHandle point = flatSerializeToBuffer(Point{1, 2, 3});
+  Point result = flatRoot<Point>(point).get();
+  EXPECT_EQ(result.z, 3);
+}
+
+TEST_F(FlatSerializationTest, StringsAndSequences) {
+  std::vector<std::string> names{"alpha", "", "gamma"};
+  BufferHandle buffer = flatSerializeToBuffer(names);
+  auto view = flatRoot<std::vector<std::string>>(buffer);
+  ASSERT_EQ(view.size(), 3u);
+  EXPECT_EQ(view[0].get(), "alpha");
+  EXPECT_EQ(view[1].get(), "");
+  EXPECT_EQ(view[2].get(), "gamma");
+  EXPECT_THROW(view[3], std::out_of_range);
+
+  std::vector<float> samples(1000);
+  for (size_t i = 0; i != samples.size(); ++i) {
+    samples[i] = i * 0.25f;
+  }
+  BufferHandle sample_buffer = flatSerializeToBuffer(samples);
+  auto sample_view = flatRoot<std::vector<float>>(sample_buffer);
+  EXPECT_EQ(sample_view[999], 999 * 0.25f);
+  Span<const float> span = sample_view.span();
+  ASSERT_EQ(span.size(), 1000u);
+  EXPECT_EQ(span[10], 2.5f);
+  EXPECT_EQ((uintptr_t)span.get_data() % alignof(float), 0u);
+}
+
+TEST_F(FlatSerializationTest, SpanRejectsMisalignedElements) {
+  std::vector<std::byte> bytes;
+  flatSerializeTo(bytes, std::vector<double>{1.5, 2.5, 3.5});
+  // Copy the buffer one byte past an aligned address.
+  std::vector<double> storage(bytes.size() / sizeof(double) + 2);
+  char *shifted = (char *)storage.data() + 1;
+  std::memcpy(shifted, bytes.data(), bytes.size());
+  auto view = flatRoot<std::vector<double>>(
+      std::string_view(shifted, bytes.size()));
+  EXPECT_EQ(view[1], 2.5);
+  EXPECT_THROW(view.span(), DataFormatError);
+}
+
+TEST_F(FlatSerializationTest, NestedRandomAccess) {
+  Universe universe;
+  for (uint64_t i = 0; i != 200; ++i) {
+    Instrument instrument;
+    instrument.id = 1000 + i;
+    instrument.symbol = "SYM" + std::to_string(i);
+    instrument.prices.assign(i % 5, double(i));
+    if (i % 2) {
+      instrument.note = "odd";
+    }
+    instrument.limits["max"] = i * 10;
+    instrument.limits["min"] = -(int64_t)i;
+    universe.index.emplace(instrument.id, (uint32_t)i);
+    universe.instruments.push_back(std::move(instrument));
+  }
+  universe.origin = {4, 5, 6};
+
+  std::vector<std::byte> bytes;
+  flatSerializeTo(bytes, universe);
+  auto root = flatRoot<Universe>(
+      std::string_view((const char *)bytes.data(), bytes.size()));
+  EXPECT_EQ(root.field_count(), 3u);
+  EXPECT_EQ(root.field(&Universe::origin).get().y, 5);
+
+  auto instruments = root.field(&Universe::instruments);
+  ASSERT_EQ(instruments.size(), 200u);
+  auto index = root.field<1, HashMap<uint64_t, uint32_t>>();
+  EXPECT_EQ(index.size(), 200u);
+  EXPECT_FALSE(index.contains(uint64_t(5)));
+
+  for (uint64_t id : {1000, 1077, 1199}) {
+    auto position = index.find(id);
+    ASSERT_TRUE(position);
+    auto instrument = instruments[position->get()];
+    EXPECT_EQ(instrument.field(&Instrument::id).get(), id);
+    EXPECT_EQ(instrument.field(&Instrument::symbol).get(),
+              "SYM" + std::to_string(id - 1000));
+    auto prices = instrument.field(&Instrument::prices);
+    EXPECT_EQ(prices.size(), (id - 1000) % 5);
+    auto note = instrument.field(&Instrument::note);
+    EXPECT_EQ(note.has_value(), id % 2 == 1);
+    if (note) {
+      EXPECT_EQ(note.value().get(), "odd");
+    }
+    auto limits = instrument.field(&Instrument::limits);
+    EXPECT_EQ(limits.at("max").get(), (int64_t)(id - 1000) * 10);
+    EXPECT_EQ(limits.at(std::string("min")).get(), -(int64_t)(id - 1000));
+    EXPECT_FALSE(limits.find("mid"));
+  }
+}
+
+TEST_F(FlatSerializationTest, EmptyContainers) {
+  Instrument instrument;
+  BufferHandle buffer = flatSerializeToBuffer(instrument);
+  auto view = flatRoot<Instrument>(buffer);
+  EXPECT_EQ(view.field(&Instrument::symbol).get(), "");
+  EXPECT_TRUE(view.field(&Instrument::prices).empty());
+  EXPECT_FALSE(view.field(&Instrument::note));
+  EXPECT_THROW(view.field(&Instrument::note).value(),
+               std::bad_optional_access);
+  EXPECT_FALSE(view.field(&Instrument::limits).contains("max"));
+}
+
+TEST_F(FlatSerializationTest, RejectsCorruptInput) {
+  EXPECT_THROW(flatRoot<int>(std::string_view("short")), DataFormatError);
+  std::string garbage(32, 'x');
+  EXPECT_THROW(flatRoot<int>(garbage), DataFormatError);
+
+  std::vector<std::byte> bytes;
+  flatSerializeTo(bytes, std::string("truncated string"));
+  std::string_view truncated((const char *)bytes.data(), bytes.size() - 4);
+  EXPECT_THROW(flatRoot<std::string>(truncated).get(), DataFormatError);
+
+  // A count that only fits if the count word itself is ignored.
+  bytes.clear();
+  flatSerializeTo(bytes, std::vector<float>{1, 2});
+  const uint64_t original_count = 2;
+  const float first_element = 1;
+  std::byte pattern[sizeof(uint64_t) + sizeof(float)];
+  std::memcpy(pattern, &original_count, sizeof(uint64_t));
+  std::memcpy(pattern + sizeof(uint64_t), &first_element, sizeof(float));
+  auto found = std::search(bytes.begin(), bytes.end(), std::begin(pattern),
+                           std::end(pattern));
+  ASSERT_NE(found, bytes.end());
+  uint64_t corrupt_count = (bytes.end() - found) / sizeof(float);
+  std::memcpy(&*found, &corrupt_count, sizeof(uint64_t));
+  std::string_view corrupt((const char *)bytes.data(), bytes.size());
+  EXPECT_THROW(flatRoot<std::vector<float>>(corrupt), DataFormatError);
+}
+
+struct VersionedQuote {
+  uint32_t version = 0;
+  std::string symbol;
+  double bid = 0;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 3, symbol, bid);
+  }
+};
+
+TEST_F(FlatSerializationTest, VersionedStructsUsePlainFields) {
+  BufferHandle buffer = flatSerializeToBuffer(VersionedQuote{0, "IBM", 1.5});
+  auto root = flatRoot<VersionedQuote>(buffer);
+  EXPECT_EQ(root.field_count(), 2u);
+  EXPECT_EQ(root.field(&VersionedQuote::symbol).get(), "IBM");
+  EXPECT_EQ(root.field(&VersionedQuote::bid).get(), 1.5);
+}
@@ -0,0 +1,176 @@
+#include "histogram.h"
+#include "stopwatch.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace turbokit;
+
+class HistogramTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(HistogramTest, LayoutRoundTrip) {
+  using Layout = LatencyHistogram::Layout;
+  for (int64_t value : {0l, 1l, 127l, 128l, 129l, 1000l, 123456789l,
+                        std::numeric_limits<int64_t>::max()}) {
+    size_t index = Layout::index_of(value);
+    ASSERT_LT(index, Layout::bucket_count);
+    EXPECT_LE(Layout::lowest_value_at(index), value);
+    EXPECT_GE(Layout::highest_value_at(index), value);
+  }
+}
+
+TEST_F(HistogramTest, LayoutIsContiguousAndMonotonic) {
+  using Layout = LatencyHistogram::Layout;
+  for (size_t index = 1; index != Layout::bucket_count; ++index) {
+    EXPECT_EQ(Layout::lowest_value_at(index),
+              Layout::highest_value_at(index - 1) + 1);
+  }
+}
+
+TEST_F(HistogramTest, EmptyHistogram) {
+  LatencyHistogram histogram;
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count(), 0u);
+  EXPECT_EQ(snapshot.value_at_percentile(99.0), 0);
+  EXPECT_EQ(snapshot.min(), 0);
+}
+
+TEST_F(HistogramTest, PercentilesMatchSortedSamples) {
+  LatencyHistogram histogram;
+  std::mt19937_64 random(42);
+  std::lognormal_distribution<double> distribution(10.0, 1.0);
+  std::vector<int64_t> samples;
+  for (int i = 0; i != 100000; ++i) {
+    int64_t value = (int64_t)distribution(random);
+    samples.push_back(value);
+    histogram.record(value);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count(), samples.size());
+  EXPECT_EQ(snapshot.min(), samples.front());
+  EXPECT_EQ(snapshot.max(), samples.back());
+  for (double percentile : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+    size_t rank = (size_t)std::ceil(percentile / 100.0 * samples.size()) - 1;
+    double expected = samples[rank];
+    EXPECT_NEAR(snapshot.value_at_percentile(percentile), expected,
+                expected / 32 + 1)
+        << "p" << percentile;
+  }
+}
+
+TEST_F(HistogramTest, MergesPerThreadShards) {
+  LatencyHistogram histogram;
+  const int thread_count = 4;
+  const int samples_per_thread = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t != thread_count; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i != samples_per_thread; ++i) {
+        histogram.record(1000 * (t + 1));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count(), (uint64_t)thread_count * samples_per_thread);
+  EXPECT_EQ(snapshot.min(), 1000);
+  EXPECT_EQ(snapshot.max(), 4000);
+  auto percentiles = snapshot.percentiles();
+  EXPECT_NEAR(percentiles.p50, 2000, 2000 / 32);
+  EXPECT_NEAR(percentiles.p99, 4000, 4000 / 32);
+}
+
+TEST_F(HistogramTest, IndependentHistogramsOnSameThread) {
+  LatencyHistogram first;
+  LatencyHistogram second;
+  for (int i = 0; i != 10; ++i) {
+    first.record(100);
+    second.record(200);
+    second.record(300);
+  }
+  EXPECT_EQ(first.snapshot().count(), 10u);
+  EXPECT_EQ(second.snapshot().count(), 20u);
+}
+
+TEST_F(HistogramTest, ManyHistogramsShareBoundedThreadCache) {
+  // More histograms than the per-thread cache holds, so lookups keep
+  // evicting each other and fall back to each histogram's shard table.
+  std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+  for (int i = 0; i != 40; ++i) {
+    histograms.push_back(std::make_unique<LatencyHistogram>());
+  }
+  for (int round = 0; round != 3; ++round) {
+    for (auto &histogram : histograms) {
+      histogram->record(100 + round);
+    }
+  }
+  for (auto &histogram : histograms) {
+    auto snapshot = histogram->snapshot();
+    EXPECT_EQ(snapshot.count(), 3u);
+    EXPECT_EQ(snapshot.min(), 100);
+    EXPECT_EQ(snapshot.max(), 102);
+  }
+  histograms.clear();
+  LatencyHistogram fresh;
+  fresh.record(5);
+  EXPECT_EQ(fresh.snapshot().count(), 1u);
+}
+
+TEST_F(HistogramTest, ThreadsReuseShardsOfExitedThreads) {
+  LatencyHistogram histogram;
+  for (int t = 0; t != 8; ++t) {
+    std::thread([&] {
+      for (int i = 0; i != 100; ++i) {
+        histogram.record(10 + t);
+      }
+    }).join();
+  }
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count(), 800u);
+  EXPECT_EQ(snapshot.min(), 10);
+  EXPECT_EQ(snapshot.max(), 17);
+}
+
+TEST_F(HistogramTest, RecordsFromScopedTimer) {
+  LatencyHistogram histogram;
+  for (int i = 0; i != 100; ++i) {
+    ScopedTimer timer(histogram);
+  }
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count(), 100u);
+  EXPECT_LT(snapshot.percentiles().p50, 1000000);
+}
+
+TEST_F(HistogramTest, RecordsStopwatchAndClockValues) {
+  LatencyHistogram histogram;
+  CycleStopwatch stopwatch;
+  stopwatch.start();
+  stopwatch.stop();
+  histogram.record(stopwatch);
+
+  auto start = turbokit::clock.get_current_time();
+  histogram.record(turbokit::clock.get_current_time() - start);
+  EXPECT_EQ(histogram.snapshot().count(), 2u);
+}
+
+TEST_F(HistogramTest, Reset) {
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::microseconds(5));
+  EXPECT_EQ(histogram.snapshot().count(), 1u);
+  histogram.reset();
+  EXPECT_EQ(histogram.snapshot().count(), 0u);
+  histogram.record(42);
+  EXPECT_EQ(histogram.snapshot().max(), 42);
+}
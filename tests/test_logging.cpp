@@ -1,6 +1,10 @@
 #include "logging.h"
+#include <atomic>
+#include <cmath>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace turbokit;
 
@@ -59,4 +63,276 @@ TEST_F(LoggingTest, LogLevelComparison) {
 TEST_F(LoggingTest, LogMutexExists) {
   // Test that log mutex exists
   EXPECT_NE(&messageMutex, nullptr);
-}
\ No newline at end of file
+}
+
+static std::string dumpFlightRecorder() {
+  std::FILE *file = std::tmpfile();
+  flightRecorder.dump(fileno(file));
+  std::string result;
+  std::rewind(file);
+  char chunk[4096];
+  size_t length;
+  while ((length = std::fread(chunk, 1, sizeof(chunk), file)) != 0) {
+    result.append(chunk, length);
+  }
+  std::fclose(file);
+  return result;
+}
+
+TEST_F(LoggingTest, FlightRecorderCapturesSuppressedLevels) {
+  auto previous_level = activeMessageLevel;
+  activeMessageLevel = MSG_INFO;
+  std::string owned = "owned string";
+  messageWriter.debug("flight debug %d %s %s %.2f", 42, "literal", owned, 1.5);
+  activeMessageLevel = previous_level;
+
+  auto dump = dumpFlightRecorder();
+  EXPECT_NE(dump.find("DEBUG: flight debug 42 literal owned string 1.50"),
+            std::string::npos);
+}
+
+TEST_F(LoggingTest, FlightRecorderTruncatesLongStrings) {
+  std::string long_text(1000, 'x');
+  messageWriter.verbose("long %s %d", long_text, 7);
+
+  auto dump = dumpFlightRecorder();
+  EXPECT_NE(dump.find("VERBOSE: long xxxx"), std::string::npos);
+  EXPECT_EQ(dump.find(long_text), std::string::npos);
+}
+
+TEST_F(LoggingTest, FlightRecorderKeepsNewestRecords) {
+  for (size_t i = 0; i != FlightRecorder::record_count + 10; ++i) {
+    messageWriter.debug("ring entry %zu", i);
+  }
+
+  auto dump = dumpFlightRecorder();
+  EXPECT_EQ(dump.find("ring entry 0\n"), std::string::npos);
+  EXPECT_NE(dump.find(fmt::sprintf("ring entry %zu\n",
+                                   FlightRecorder::record_count + 9)),
+            std::string::npos);
+}
+
+template <typename... Args>
+static std::string formatFlightText(const char *format, const Args &...args) {
+  char buffer[256];
+  FlightText text{buffer, sizeof(buffer)};
+  FlightFormatter::format(text, format, args...);
+  return std::string(buffer, text.size);
+}
+
+TEST_F(LoggingTest, FlightFormatterMatchesPrintf) {
+  auto expect_same = [](const char *format, auto value) {
+    char expected[256];
+    if constexpr (std::is_arithmetic_v<decltype(value)> ||
+                  std::is_pointer_v<decltype(value)>) {
+      std::snprintf(expected, sizeof(expected), format, value);
+    } else {
+      std::snprintf(expected, sizeof(expected), "%s",
+                    fmt::sprintf(format, value).c_str());
+    }
+    EXPECT_EQ(formatFlightText(format, value), expected) << format;
+  };
+  for (const char *format : {"%d", "%5d", "%-5d|", "%05d", "%+d", "% d",
+                             "%.3d", "%x", "%#X", "%o", "%#o", "%u"}) {
+    expect_same(format, 42);
+    expect_same(format, -7);
+    expect_same(format, 0);
+  }
+  expect_same("%lld", (long long)INT64_MIN);
+  expect_same("%zu", ~size_t(0));
+  for (const char *format :
+       {"%f", "%.2f", "%10.3f|", "%-10.1f|", "%+.3f", "%08.2f", "%.0f",
+        "%#.0f", "%e", "%.3E", "%g", "%.3g", "%#g", "%G"}) {
+    for (double value : {0.0, 1.5, -2.25, 123456.789, 0.000123, 1e20,
+                         9.9999999, 1e-10}) {
+      expect_same(format, value);
+    }
+  }
+  expect_same("%s", "text");
+  expect_same("%.2s", "text");
+  expect_same("%-6s|", "text");
+  expect_same("%6s|", std::string_view("text"));
+  expect_same("%c", 'x');
+  EXPECT_EQ(formatFlightText("%s %d", true, false), "true 0");
+  EXPECT_EQ(formatFlightText("%d%% of %s", 50, "total"), "50% of total");
+  EXPECT_EQ(formatFlightText("missing %d %s", 1), "missing 1 ");
+}
+
+TEST_F(LoggingTest, FlightFormatterSingleDigitMantissaAfterWiderCall) {
+  // A previous conversion leaves digits on the stack where a one-digit
+  // mantissa ends; they must not be read as a rounding carry.
+  for (const char *format : {"%.0e", "%.1g", "%.0E"}) {
+    for (double value : {1.2, 1.0, 9.6, 0.12}) {
+      char expected[64];
+      std::snprintf(expected, sizeof(expected), format, value);
+      formatFlightText("%f", 10.5);
+      EXPECT_EQ(formatFlightText(format, value), expected) << format;
+    }
+  }
+}
+
+TEST_F(LoggingTest, FlightRecorderCopiesFormat) {
+  std::string format = "copied format %d";
+  messageWriter.debug(format.c_str(), 11);
+  format.assign(format.size(), '?');
+
+  auto dump = dumpFlightRecorder();
+  EXPECT_NE(dump.find("DEBUG: copied format 11\n"), std::string::npos);
+
+  std::string long_format(300, 'f');
+  messageWriter.debug(long_format.c_str());
+  EXPECT_NE(dumpFlightRecorder().find("DEBUG: " + long_format.substr(0, 200)),
+            std::string::npos);
+}
+
+TEST_F(LoggingTest, FlightRecorderKeepsFormatOfUnrecordableArguments) {
+  std::string long_format = std::string(300, 'g') + " %d";
+  messageWriter.debug(long_format.c_str(), 5);
+
+  auto dump = dumpFlightRecorder();
+  EXPECT_NE(dump.find("DEBUG: " + long_format.substr(0, 200)),
+            std::string::npos);
+  EXPECT_NE(dump.find(" [arguments not recorded]\n"), std::string::npos);
+}
+
+static void exitFromPreviousHandler(int) { _exit(42); }
+
+TEST_F(LoggingTest, FlightRecorderChainsToPreviousSignalHandler) {
+  EXPECT_EXIT(
+      {
+        std::signal(SIGABRT, &exitFromPreviousHandler);
+        installFlightRecorderSignalHandlers();
+        installFlightRecorderSignalHandlers();
+        messageWriter.debug("before the crash");
+        std::abort();
+      },
+      ::testing::ExitedWithCode(42), "FLIGHT RECORDER");
+}
+
+TEST_F(LoggingTest, RateLimiterAllowsBurstThenSuppresses) {
+  LogRateLimiter limiter(0.001, 3, __FILE__, __LINE__);
+  int written = 0;
+  for (int i = 0; i != 100; ++i) {
+    written += writeRateLimited(limiter, MSG_INFO, "rate limited %d", i);
+  }
+  EXPECT_EQ(written, 3);
+  EXPECT_EQ(limiter.suppressed_count.load(), 97u);
+}
+
+TEST_F(LoggingTest, RateLimiterRefillsOverTime) {
+  LogRateLimiter limiter(1000.0, 1);
+  EXPECT_TRUE(limiter.try_acquire());
+  EXPECT_FALSE(limiter.try_acquire());
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_TRUE(limiter.try_acquire());
+}
+
+TEST_F(LoggingTest, RateLimiterGrantsWholeBurstUnderContention) {
+  // Refills once per 1000 s, so exactly the burst is granted.
+  LogRateLimiter limiter(0.001, 20000);
+  std::atomic_int granted = 0;
+  std::atomic_bool start = false;
+  std::vector<std::thread> threads;
+  for (int t = 0; t != 8; ++t) {
+    threads.emplace_back([&] {
+      while (!start.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i != 5000; ++i) {
+        granted += limiter.try_acquire();
+      }
+    });
+  }
+  start = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(granted.load(), 20000);
+}
+
+TEST_F(LoggingTest, RateLimiterWithZeroRateDropsEverything) {
+  for (double rate : {0.0, -5.0, std::nan("")}) {
+    LogRateLimiter limiter(rate, 10);
+    EXPECT_FALSE(limiter.try_acquire()) << rate;
+    EXPECT_FALSE(writeRateLimited(limiter, MSG_ERROR, "dropped")) << rate;
+    EXPECT_EQ(limiter.suppressed_count.load(), 1u) << rate;
+    limiter.suppressed_count = 0;
+  }
+  LogRateLimiter tiny(1e-30, 1);
+  EXPECT_TRUE(tiny.try_acquire());
+  EXPECT_FALSE(tiny.try_acquire());
+}
+
+TEST_F(LoggingTest, RateLimiterIgnoresDisabledLevels) {
+  auto previous_level = activeMessageLevel;
+  activeMessageLevel = MSG_INFO;
+  LogRateLimiter limiter(0.001, 1);
+  EXPECT_FALSE(writeRateLimited(limiter, MSG_DEBUG, "disabled"));
+  EXPECT_EQ(limiter.suppressed_count.load(), 0u);
+  EXPECT_TRUE(limiter.try_acquire());
+  activeMessageLevel = previous_level;
+}
+
+TEST_F(LoggingTest, RateLimiterReportsSuppressedAfterStorm) {
+  LogRateLimiter limiter(0.001, 1, "storm.cpp", 12);
+  testing::internal::CaptureStdout();
+  for (int i = 0; i != 5; ++i) {
+    writeRateLimited(limiter, MSG_INFO, "storm %d", i);
+  }
+  flushSuppressedMessages();
+  std::string output = testing::internal::GetCapturedStdout();
+  EXPECT_NE(output.find("storm 0"), std::string::npos);
+  EXPECT_NE(output.find("suppressed 4 messages from storm.cpp:12"),
+            std::string::npos);
+  EXPECT_EQ(limiter.suppressed_count.load(), 0u);
+}
+
+TEST_F(LoggingTest, SampledWritesOneInN) {
+  std::atomic_uint32_t counter = 0;
+  int written = 0;
+  for (int i = 0; i != 100; ++i) {
+    written += writeSampled(counter, 10, MSG_INFO, "sampled %d", i);
+  }
+  EXPECT_EQ(written, 10);
+
+  testing::internal::CaptureStdout();
+  written = 0;
+  for (int i = 0; i != 3; ++i) {
+    written += writeSampled(counter, 0, MSG_INFO, "unsampled %d", i);
+  }
+  testing::internal::GetCapturedStdout();
+  EXPECT_EQ(written, 3);
+}
+
+static size_t countOccurrences(const std::string &text,
+                               const std::string &pattern) {
+  size_t count = 0;
+  for (size_t position = text.find(pattern); position != std::string::npos;
+       position = text.find(pattern, position + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+TEST_F(LoggingTest, RateLimitedMacros) {
+  testing::internal::CaptureStdout();
+  testing::internal::CaptureStderr();
+  for (int i = 0; i != 10; ++i) {
+    TURBOKIT_LOG_RATE_LIMITED(MSG_INFO, 0.001, 2, "macro rate limited %d", i);
+  }
+  // Both threads share the call site's sampling counter.
+  auto sample = [] {
+    for (int i = 0; i != 10; ++i) {
+      TURBOKIT_ERROR_SAMPLED(5, "macro sampled %d", i);
+    }
+  };
+  std::thread other(sample);
+  other.join();
+  sample();
+  flushSuppressedMessages();
+  std::string output = testing::internal::GetCapturedStdout();
+  std::string errors = testing::internal::GetCapturedStderr();
+  EXPECT_EQ(countOccurrences(output, "macro rate limited"), 2u);
+  EXPECT_EQ(countOccurrences(output, "suppressed 8 messages from"), 1u);
+  EXPECT_EQ(countOccurrences(errors, "macro sampled"), 4u);
+}
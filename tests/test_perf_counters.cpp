@@ -0,0 +1,81 @@
+#include "perf_counters.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace turbokit;
+
+class PerfCountersTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+static constexpr std::array<PerfEventType, perf_counter_count> softwareEvents =
+    {{
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    }};
+
+static uint64_t spin(int iterations) {
+  volatile uint64_t sum = 0;
+  for (int i = 0; i != iterations; ++i) {
+    sum = sum + i;
+  }
+  return sum;
+}
+
+TEST_F(PerfCountersTest, UnavailableCountersReadAsZero) {
+  PerfEventType invalid = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_MAX};
+  PerfCounters counters(std::array<PerfEventType, perf_counter_count>{
+      {invalid, invalid, invalid, invalid}});
+  EXPECT_FALSE(counters.is_available());
+  auto values = counters.read();
+  EXPECT_EQ(values.cycles, 0u);
+  EXPECT_EQ(values.instructions_per_cycle(), 0.0);
+}
+
+TEST_F(PerfCountersTest, GroupReadFallback) {
+  PerfCounters counters(softwareEvents);
+  if (!counters.is_available()) {
+    GTEST_SKIP() << "perf_event_open is not permitted";
+  }
+  auto before = counters.read();
+  spin(10000000);
+  std::vector<char> memory(16 << 20, 1);
+  auto difference = counters.read() - before;
+  EXPECT_GT(difference.cycles, 1000000u);
+  EXPECT_GT(difference.instructions, 1000000u);
+  EXPECT_GT(difference.cache_misses, 0u);
+}
+
+TEST_F(PerfCountersTest, HardwareCountersWhenAvailable) {
+  PerfCounters counters;
+  if (!counters.is_available(0) || !counters.is_available(1)) {
+    GTEST_SKIP() << "hardware counters are not available";
+  }
+  PerfStopwatch stopwatch(counters);
+  {
+    ScopedPerfTimer timer(stopwatch);
+    spin(1000000);
+  }
+  EXPECT_GT(stopwatch.values().instructions, 1000000u);
+  EXPECT_GT(stopwatch.values().instructions_per_cycle(), 0.0);
+}
+
+TEST_F(PerfCountersTest, PerfStopwatchAccumulates) {
+  PerfCounters counters(softwareEvents);
+  PerfStopwatch stopwatch(counters);
+  for (int i = 0; i != 3; ++i) {
+    ScopedPerfTimer timer(stopwatch);
+    spin(100000);
+  }
+  EXPECT_EQ(stopwatch.stopwatch.interval_count, 3u);
+  EXPECT_GT(stopwatch.elapsed_nanoseconds(), 0);
+  if (counters.is_available()) {
+    EXPECT_GT(stopwatch.values().cycles, 0u);
+  }
+  stopwatch.reset();
+  EXPECT_EQ(stopwatch.values().cycles, 0u);
+}
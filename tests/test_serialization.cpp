@@ -1,5 +1,10 @@
+#include "buffer_chain.h"
 #include "serialization.h"
 #include <gtest/gtest.h>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -203,4 +208,727 @@ TEST_F(SerializationTest, LargeData) {
   deserializeBuffer(buffer, result);
 
   EXPECT_EQ(result, data);
-}
\ No newline at end of file
+}
+TEST_F(SerializationTest, DeserializeFromBufferSlices) {
+  std::string frame;
+  std::vector<std::pair<int, std::string>> messages = {
+      {1, "first"}, {2, "second"}, {3, "third"}};
+  for (auto &message : messages) {
+    std::string part;
+    serializeTo(part, message);
+    frame += part;
+  }
+  auto handle = makeBuffer(frame.size());
+  std::memcpy(handle->get_data(), frame.data(), frame.size());
+  BufferSlice remaining(std::move(handle));
+
+  for (auto &expected : messages) {
+    std::pair<int, std::string_view> message;
+    BufferSlice rest = deserializeBufferPart(remaining, message);
+    EXPECT_EQ(message.first, expected.first);
+    EXPECT_EQ(message.second, expected.second);
+    EXPECT_GE((const std::byte *)message.second.data(), remaining.get_data());
+    EXPECT_LT((const std::byte *)message.second.data(), rest.get_data());
+    remaining = std::move(rest);
+  }
+  EXPECT_TRUE(remaining.empty());
+}
+
+TEST_F(SerializationTest, DeserializeWholeBufferSlice) {
+  BufferSlice slice(serializeToBuffer(42, std::string("slice")));
+  int number = 0;
+  std::string text;
+  deserializeBuffer(slice, number, text);
+  EXPECT_EQ(number, 42);
+  EXPECT_EQ(text, "slice");
+  EXPECT_THROW(deserializeBuffer(slice.slice(0, slice.get_size() - 1), number,
+                                 text),
+               DataFormatError);
+}
+
+TEST_F(SerializationTest, GrowableMatchesTwoPass) {
+  ComplexStruct value;
+  for (int i = 0; i != 500; ++i) {
+    value.data.emplace_back(i, std::string(i % 37, char('a' + i % 26)));
+  }
+  value.name = "growable";
+  std::variant<int, std::string> variant = std::string("tail");
+
+  std::vector<std::byte> expected;
+  serializeTo(expected, value, variant, 7);
+
+  std::vector<std::byte> bytes{std::byte(1)};
+  serializeToGrowable(bytes, value, variant, 7);
+  EXPECT_EQ(bytes, expected);
+
+  Vector<std::byte> vector;
+  serializeToGrowable(vector, value, variant, 7);
+  ASSERT_EQ(vector.size(), expected.size());
+  EXPECT_EQ(std::memcmp(vector.get_data(), expected.data(), expected.size()),
+            0);
+
+  std::string text;
+  serializeToGrowable(text, value, variant, 7);
+  EXPECT_EQ(text, std::string((const char *)expected.data(), expected.size()));
+
+  BufferHandle buffer = serializeToGrowableBuffer(value, variant, 7);
+  ASSERT_EQ(buffer->get_size(), expected.size());
+  EXPECT_EQ(std::memcmp(buffer->get_data(), expected.data(), expected.size()),
+            0);
+
+  ComplexStruct result;
+  std::variant<int, std::string> variant_result;
+  int number = 0;
+  deserializeBuffer(buffer, result, variant_result, number);
+  EXPECT_EQ(result, value);
+  EXPECT_EQ(std::get<std::string>(variant_result), "tail");
+  EXPECT_EQ(number, 7);
+}
+
+TEST_F(SerializationTest, GrowableEmptyAndTell) {
+  BufferHandle empty = serializeToGrowableBuffer();
+  ASSERT_TRUE(empty);
+  EXPECT_EQ(empty->get_size(), 0u);
+
+  size_t position = 0;
+  std::vector<std::byte> bytes;
+  serializeToGrowable(bytes, std::string(100, 'x'),
+                      SerializeFunction([&](auto &context) {
+                        position = context.tell();
+                      }));
+  EXPECT_EQ(position, sizeof(size_t) + 100);
+}
+
+TEST_F(SerializationTest, GrowableIntoBufferChain) {
+  std::vector<std::string> strings;
+  for (size_t i = 0; i != 300; ++i) {
+    strings.push_back(std::string(i, char('0' + i % 10)));
+  }
+  std::vector<std::byte> expected;
+  serializeTo(expected, strings, 42);
+
+  BufferChain chain;
+  chain.write("head", 4);
+  chain.append_serialized(strings, 42);
+  EXPECT_GT(chain.segment_count(), 1u);
+  EXPECT_EQ(chain.size(), expected.size() + 4);
+  std::string contents = chain.to_string();
+  EXPECT_EQ(contents.substr(0, 4), "head");
+  EXPECT_EQ(contents.substr(4),
+            std::string((const char *)expected.data(), expected.size()));
+}
+
+TEST_F(SerializationTest, TrivialContainersWriteInBulk) {
+  std::vector<float> floats(1000);
+  for (size_t i = 0; i != floats.size(); ++i) {
+    floats[i] = i * 0.5f;
+  }
+  std::vector<std::byte> bytes;
+  serializeTo(bytes, floats);
+  ASSERT_EQ(bytes.size(), sizeof(size_t) + sizeof(float) * floats.size());
+  size_t count = 0;
+  std::memcpy(&count, bytes.data(), sizeof(count));
+  EXPECT_EQ(count, floats.size());
+  EXPECT_EQ(std::memcmp(bytes.data() + sizeof(size_t), floats.data(),
+                        sizeof(float) * floats.size()),
+            0);
+
+  Vector<int> vector;
+  SimpleVector<int> simple_vector;
+  for (int i = 0; i != 100; ++i) {
+    vector.append(i);
+  }
+  simple_vector.resize(50);
+  for (int i = 0; i != 50; ++i) {
+    simple_vector[i] = -i;
+  }
+
+  BufferHandle buffer = serializeToBuffer(floats, vector, simple_vector);
+  std::vector<float> floats_result;
+  Vector<int> vector_result;
+  SimpleVector<int> simple_vector_result;
+  deserializeBuffer(buffer, floats_result, vector_result,
+                    simple_vector_result);
+  EXPECT_EQ(floats_result, floats);
+  ASSERT_EQ(vector_result.size(), 100u);
+  EXPECT_EQ(vector_result[99], 99);
+  ASSERT_EQ(simple_vector_result.size(), 50u);
+  EXPECT_EQ(simple_vector_result[49], -49);
+}
+
+TEST_F(SerializationTest, FixedSizeArrays) {
+  int numbers[4] = {1, 2, 3, 4};
+  std::string names[2] = {"first", "second"};
+  std::array<double, 3> doubles{1.5, 2.5, 3.5};
+  std::array<std::string, 2> strings{"a", "bc"};
+
+  BufferHandle buffer = serializeToBuffer(numbers, names, doubles, strings);
+  EXPECT_EQ(buffer->get_size(), sizeof(numbers) + 2 * sizeof(size_t) + 11 +
+                                    sizeof(doubles) + 2 * sizeof(size_t) + 3);
+
+  int numbers_result[4] = {};
+  std::string names_result[2];
+  std::array<double, 3> doubles_result{};
+  std::array<std::string, 2> strings_result;
+  deserializeBuffer(buffer, numbers_result, names_result, doubles_result,
+                    strings_result);
+  EXPECT_EQ(std::memcmp(numbers_result, numbers, sizeof(numbers)), 0);
+  EXPECT_EQ(names_result[1], "second");
+  EXPECT_EQ(doubles_result, doubles);
+  EXPECT_EQ(strings_result, strings);
+
+  std::vector<std::byte> growable;
+  serializeToGrowable(growable, numbers, names, doubles, strings);
+  ASSERT_EQ(growable.size(), buffer->get_size());
+  EXPECT_EQ(std::memcmp(growable.data(), buffer->get_data(), growable.size()),
+            0);
+}
+
+TEST_F(SerializationTest, LargeTrivialStdArrayStaysOffTheStack) {
+  // 16 MiB, twice the usual default stack.
+  using Samples = std::array<float, size_t(1) << 22>;
+  auto samples = std::make_unique<Samples>();
+  for (size_t i = 0; i != samples->size(); ++i) {
+    (*samples)[i] = i * 0.5f;
+  }
+  std::vector<std::byte> two_pass;
+  serializeTo(two_pass, *samples);
+  std::vector<std::byte> growable;
+  serializeToGrowable(growable, *samples);
+  ASSERT_EQ(two_pass.size(), sizeof(Samples));
+  ASSERT_EQ(growable.size(), sizeof(Samples));
+  EXPECT_EQ(std::memcmp(two_pass.data(), samples->data(), sizeof(Samples)), 0);
+  EXPECT_EQ(std::memcmp(growable.data(), samples->data(), sizeof(Samples)), 0);
+
+  auto result = std::make_unique<Samples>();
+  deserializeBuffer(
+      std::string_view((const char *)growable.data(), growable.size()),
+      *result);
+  EXPECT_EQ((*result)[12345], 12345 * 0.5f);
+}
+
+enum class Side : int32_t { BUY = 1, SELL = -1 };
+
+struct Quote {
+  int64_t price;
+  uint32_t quantity;
+  Side side;
+  std::string venue;
+  std::optional<int16_t> flags;
+
+  template <typename X> void serialize(X &x) {
+    x(price, quantity, side, venue, flags);
+  }
+};
+
+TEST_F(SerializationTest, CompactIntegersRoundTrip) {
+  std::vector<int64_t> signed_values{0,
+                                     1,
+                                     -1,
+                                     63,
+                                     -64,
+                                     64,
+                                     1 << 20,
+                                     -(int64_t(1) << 40),
+                                     std::numeric_limits<int64_t>::max(),
+                                     std::numeric_limits<int64_t>::min()};
+  std::vector<uint64_t> unsigned_values{0,
+                                        127,
+                                        128,
+                                        16383,
+                                        16384,
+                                        uint64_t(1) << 55,
+                                        (uint64_t(1) << 56) - 1,
+                                        uint64_t(1) << 56,
+                                        std::numeric_limits<uint64_t>::max()};
+  for (int64_t value : signed_values) {
+    BufferHandle buffer = serializeToCompactBuffer(value, value, 'x');
+    int64_t result = 0;
+    int64_t second = 0;
+    char tail = 0;
+    deserializeCompactBuffer(buffer, result, second, tail);
+    EXPECT_EQ(result, value);
+    EXPECT_EQ(second, value);
+    EXPECT_EQ(tail, 'x');
+  }
+  for (uint64_t value : unsigned_values) {
+    std::vector<std::byte> bytes;
+    serializeToCompact(bytes, value);
+    EXPECT_EQ(bytes.size(), CompactDataWriter::varint_size(value));
+    uint64_t result = 0;
+    deserializeCompactBuffer(
+        std::string_view((const char *)bytes.data(), bytes.size()), result);
+    EXPECT_EQ(result, value);
+  }
+}
+
+TEST_F(SerializationTest, CompactFormatIsSmaller) {
+  std::vector<Quote> quotes;
+  for (int i = 0; i != 100; ++i) {
+    std::optional<int16_t> flags;
+    if (i % 3) {
+      flags = int16_t(-i);
+    }
+    quotes.push_back({10000 + i, uint32_t(i), i % 2 ? Side::BUY : Side::SELL,
+                      "XNAS", flags});
+  }
+  BufferHandle raw = serializeToBuffer(quotes);
+  BufferHandle compact = serializeToCompactBuffer(quotes);
+  EXPECT_LT(compact->get_size() * 2, raw->get_size());
+
+  std::vector<Quote> result;
+  deserializeCompactBuffer(compact, result);
+  ASSERT_EQ(result.size(), quotes.size());
+  for (size_t i = 0; i != quotes.size(); ++i) {
+    EXPECT_EQ(result[i].price, quotes[i].price);
+    EXPECT_EQ(result[i].quantity, quotes[i].quantity);
+    EXPECT_EQ(result[i].side, quotes[i].side);
+    EXPECT_EQ(result[i].venue, quotes[i].venue);
+    EXPECT_EQ(result[i].flags, quotes[i].flags);
+  }
+}
+
+TEST_F(SerializationTest, CompactRejectsMalformedInput) {
+  std::vector<std::byte> bytes;
+  serializeToCompact(bytes, uint32_t(70000));
+  uint16_t narrow = 0;
+  EXPECT_THROW(deserializeCompactBuffer(
+                   std::string_view((const char *)bytes.data(), bytes.size()),
+                   narrow),
+               DataFormatError);
+
+  std::string overlong(11, '\x80');
+  uint64_t value = 0;
+  EXPECT_THROW(deserializeCompactBuffer(overlong, value), DataFormatError);
+  EXPECT_THROW(deserializeCompactBuffer(std::string_view("\x85", 1), value),
+               DataFormatError);
+
+  // The tenth byte may only carry bit 63.
+  std::string overflowing(9, '\xff');
+  overflowing += '\x02';
+  EXPECT_THROW(deserializeCompactBuffer(overflowing, value), DataFormatError);
+  overflowing.back() = '\x01';
+  deserializeCompactBuffer(overflowing, value);
+  EXPECT_EQ(value, std::numeric_limits<uint64_t>::max());
+
+  // Non-canonical encodings are rejected on both the short-buffer path and
+  // the single-load path.
+  EXPECT_THROW(deserializeCompactBuffer(std::string_view("\x80\x00", 2), value),
+               DataFormatError);
+  std::string padded("\x80\x01\x08"
+                     "abcdefgh",
+                     11);
+  std::string tail;
+  deserializeCompactBuffer(padded, value, tail);
+  EXPECT_EQ(value, 128u);
+  padded.replace(0, 2, "\x80\x81\x00", 3);
+  EXPECT_THROW(deserializeCompactBuffer(padded, value, tail), DataFormatError);
+
+  std::string text;
+  EXPECT_THROW(deserializeCompactBuffer(std::string_view("\x05"
+                                                         "ab",
+                                                         3),
+                                        text),
+               DataFormatError);
+}
+
+struct Snapshot {
+  std::string_view venue;
+  Span<const double> prices;
+  std::basic_string_view<int32_t> sizes;
+  BufferSlice payload;
+
+  template <typename X> void serialize(X &x) {
+    x(venue, prices, sizes, payload);
+  }
+};
+
+TEST_F(SerializationTest, BorrowedViews) {
+  std::vector<double> prices{1.5, 2.5, 3.5};
+  std::vector<int32_t> sizes{10, 20};
+  BufferSlice payload(makeBuffer(6));
+  std::memcpy(payload.get_data(), "opaque", 6);
+
+  // An 8-byte venue keeps the borrowed doubles 8-byte aligned.
+  BufferSlice input(serializeToBuffer(std::string("NASDAQGS"), prices, sizes,
+                                      payload));
+  const char *begin = (const char *)input.get_data();
+  const char *end = begin + input.get_size();
+  EXPECT_EQ(input.get_block()->reference_count.load(), 1u);
+
+  Snapshot snapshot;
+  deserializeBuffer(input, snapshot);
+  EXPECT_EQ(snapshot.venue, "NASDAQGS");
+  EXPECT_GE(snapshot.venue.data(), begin);
+  EXPECT_LT(snapshot.venue.data(), end);
+  ASSERT_EQ(snapshot.prices.size(), 3u);
+  EXPECT_EQ(snapshot.prices[2], 3.5);
+  EXPECT_GE((const char *)snapshot.prices.get_data(), begin);
+  ASSERT_EQ(snapshot.sizes.size(), 2u);
+  EXPECT_EQ(snapshot.sizes[1], 20);
+  EXPECT_EQ(snapshot.payload.view(), "opaque");
+  EXPECT_EQ(snapshot.payload.get_block(), input.get_block());
+  EXPECT_EQ(input.get_block()->reference_count.load(), 2u);
+
+  std::vector<double> copied_prices;
+  std::vector<int32_t> copied_sizes;
+  std::string venue;
+  BufferSlice copied_payload;
+  deserializeBuffer(input.view(), venue, copied_prices, copied_sizes,
+                    copied_payload);
+  EXPECT_EQ(copied_prices, prices);
+  EXPECT_EQ(copied_payload.view(), "opaque");
+  EXPECT_NE(copied_payload.get_block(), input.get_block());
+}
+
+TEST_F(SerializationTest, MisalignedSpanAfterString) {
+  std::vector<double> prices{1.5, 2.5};
+  BufferHandle input = serializeToBuffer(std::string("XNAS"), prices);
+
+  // Valid input, but the 4-byte venue leaves the doubles misaligned, so
+  // every kind of borrowed view of them is refused.
+  std::string_view venue;
+  Span<const double> borrowed;
+  EXPECT_THROW(deserializeBuffer(input, venue, borrowed), DataFormatError);
+  std::basic_string_view<double> borrowed_view;
+  EXPECT_THROW(deserializeBuffer(input, venue, borrowed_view),
+               DataFormatError);
+  BufferHandle compact = serializeToCompactBuffer(std::string("XNAS"), prices);
+  EXPECT_THROW(deserializeCompactBuffer(compact, venue, borrowed_view),
+               DataFormatError);
+
+  std::vector<double> copied;
+  deserializeBuffer(input, venue, copied);
+  EXPECT_EQ(venue, "XNAS");
+  EXPECT_EQ(copied, prices);
+}
+
+TEST_F(SerializationTest, RejectsWrappingLength) {
+  // 8 * (2^61 + 1) wraps to 8, which fits in the remaining bytes.
+  uint64_t input[2] = {(uint64_t(1) << 61) + 1, 0};
+  std::string_view bytes((const char *)input, sizeof(input));
+  Span<const double> borrowed;
+  EXPECT_THROW(deserializeBuffer(bytes, borrowed), DataFormatError);
+  std::vector<double> copied;
+  EXPECT_THROW(deserializeBuffer(bytes, copied), DataFormatError);
+}
+
+TEST_F(SerializationTest, SpanWritesLikeVector) {
+  std::vector<uint16_t> values{1, 2, 3};
+  Span<const uint16_t> span(values.data(), values.size());
+  BufferHandle from_span = serializeToBuffer(span);
+  BufferHandle from_vector = serializeToBuffer(values);
+  ASSERT_EQ(from_span->get_size(), from_vector->get_size());
+  EXPECT_EQ(std::memcmp(from_span->get_data(), from_vector->get_data(),
+                        from_span->get_size()),
+            0);
+
+  // The one-byte varint length leaves the compact elements at an odd offset.
+  Span<const uint16_t> compact_view;
+  BufferHandle compact = serializeToCompactBuffer(values);
+  EXPECT_THROW(deserializeCompactBuffer(compact, compact_view),
+               DataFormatError);
+
+  Span<const uint8_t> bytes_view;
+  std::vector<uint8_t> bytes{7, 8, 9};
+  deserializeCompactBuffer(serializeToCompactBuffer(bytes), bytes_view);
+  ASSERT_EQ(bytes_view.size(), 3u);
+  EXPECT_EQ(bytes_view[2], 9);
+}
+
+struct OrderV1 {
+  uint64_t id = 0;
+  std::string symbol;
+  uint32_t version = 0;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 1, id, symbol);
+  }
+};
+
+struct OrderV2 {
+  uint64_t id = 0;
+  std::string symbol;
+  std::vector<int32_t> fills{-1};
+  uint32_t version = 0;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 2, id, symbol, fills);
+  }
+};
+
+TEST_F(SerializationTest, VersionedSkipsUnknownFields) {
+  OrderV2 newer;
+  newer.id = 7;
+  newer.symbol = "AAPL";
+  newer.fills = {1, 2, 3};
+  std::vector<OrderV2> orders{newer, newer};
+  orders[1].id = 8;
+  auto buffer = serializeToBuffer(orders, std::string("tail"));
+
+  std::vector<OrderV1> older;
+  std::string tail;
+  deserializeBuffer(buffer, older, tail);
+  ASSERT_EQ(older.size(), 2u);
+  EXPECT_EQ(older[0].id, 7u);
+  EXPECT_EQ(older[1].id, 8u);
+  EXPECT_EQ(older[1].symbol, "AAPL");
+  EXPECT_EQ(older[1].version, 2u);
+  EXPECT_EQ(tail, "tail");
+}
+
+TEST_F(SerializationTest, VersionedKeepsDefaultsForMissingFields) {
+  OrderV1 older;
+  older.id = 3;
+  older.symbol = "MSFT";
+  auto buffer = serializeToBuffer(older, 99);
+
+  OrderV2 newer;
+  int tail = 0;
+  deserializeBuffer(buffer, newer, tail);
+  EXPECT_EQ(newer.id, 3u);
+  EXPECT_EQ(newer.symbol, "MSFT");
+  EXPECT_EQ(newer.fills, std::vector<int32_t>{-1});
+  EXPECT_EQ(newer.version, 1u);
+  EXPECT_EQ(tail, 99);
+
+  std::string truncated((const char *)buffer->get_data(), 10);
+  EXPECT_THROW(deserializeBuffer(truncated, newer), DataFormatError);
+}
+
+TEST_F(SerializationTest, VersionedAcrossFormatsAndSinks) {
+  OrderV2 newer;
+  newer.id = 11;
+  newer.symbol = "GOOG";
+  newer.fills.assign(3000, 5);
+
+  OrderV1 from_compact;
+  auto compact = serializeToCompactBuffer(newer, 17u);
+  uint32_t compact_tail = 0;
+  deserializeCompactBuffer(compact, from_compact, compact_tail);
+  EXPECT_EQ(from_compact.symbol, "GOOG");
+  EXPECT_EQ(compact_tail, 17u);
+
+  std::string output;
+  serializeToGrowable(output, newer);
+  auto expected = serializeToBuffer(newer);
+  EXPECT_EQ(output, std::string((const char *)expected->get_data(),
+                                expected->get_size()));
+
+  BufferChain chain;
+  chain.append_serialized(std::string(4000, 'x'), newer, newer);
+  std::string bytes = chain.to_string();
+  std::string prefix;
+  OrderV1 first;
+  OrderV2 second;
+  deserializeBuffer(bytes, prefix, first, second);
+  EXPECT_EQ(first.id, 11u);
+  EXPECT_EQ(second.fills, newer.fills);
+}
+
+enum class Venue : uint8_t { Primary, Dark };
+
+struct PortableRecord {
+  int16_t delta = 0;
+  uint32_t flags = 0;
+  long offset = 0;
+  double price = 0;
+  Venue venue = Venue::Primary;
+  bool active = false;
+  std::string name;
+  std::vector<float> weights;
+  std::vector<long> offsets;
+  std::map<std::string, uint64_t> counts;
+  std::optional<int32_t> limit;
+  std::variant<int64_t, std::string> tag;
+  int32_t levels[3] = {};
+  std::array<uint16_t, 2> ports = {};
+
+  template <typename X> void serialize(X &x) {
+    x(delta, flags, offset, price, venue, active, name, weights, offsets,
+      counts, limit, tag, levels, ports);
+  }
+};
+
+TEST_F(SerializationTest, PortableRoundTrip) {
+  PortableRecord record;
+  record.delta = -300;
+  record.flags = 0xdeadbeef;
+  record.offset = -1234567;
+  record.price = 101.25;
+  record.venue = Venue::Dark;
+  record.active = true;
+  record.name = "portable";
+  record.weights = {0.5f, -1.5f, 3.0f};
+  record.offsets = {-1, 0, 1L << 40};
+  record.counts = {{"a", 1}, {"b", 1ull << 50}};
+  record.limit = -7;
+  record.tag = std::string("tag");
+  record.levels[0] = -1;
+  record.levels[2] = 70000;
+  record.ports = {80, 443};
+
+  auto check = [&](const PortableRecord &result) {
+    EXPECT_EQ(result.delta, -300);
+    EXPECT_EQ(result.flags, 0xdeadbeef);
+    EXPECT_EQ(result.offset, -1234567);
+    EXPECT_EQ(result.price, 101.25);
+    EXPECT_EQ(result.venue, Venue::Dark);
+    EXPECT_TRUE(result.active);
+    EXPECT_EQ(result.name, "portable");
+    EXPECT_EQ(result.weights, record.weights);
+    EXPECT_EQ(result.offsets, record.offsets);
+    EXPECT_EQ(result.counts, record.counts);
+    EXPECT_EQ(result.limit, -7);
+    EXPECT_EQ(std::get<std::string>(result.tag), "tag");
+    EXPECT_EQ(result.levels[0], -1);
+    EXPECT_EQ(result.levels[2], 70000);
+    EXPECT_EQ(result.ports, record.ports);
+  };
+
+  PortableRecord portable;
+  deserializePortableBuffer(serializeToPortableBuffer(record), portable);
+  check(portable);
+
+  PortableRecord compact;
+  deserializeCompactBuffer(serializeToCompactBuffer(record), compact);
+  check(compact);
+
+  PortableRecord native;
+  deserializeBuffer(serializeToBuffer(record), native);
+  check(native);
+
+  auto buffer = serializeToPortableBuffer(record);
+  std::string truncated((const char *)buffer->get_data(),
+                        buffer->get_size() - 1);
+  EXPECT_THROW(deserializePortableBuffer(truncated, portable),
+               DataFormatError);
+}
+
+template <typename Type> static size_t portableWireSize(Type value) {
+  std::vector<uint8_t> bytes;
+  serializeToPortable(bytes, value);
+  return bytes.size();
+}
+
+TEST_F(SerializationTest, PortableScalarWidths) {
+  EXPECT_EQ(portableWireSize(true), 1u);
+  EXPECT_EQ(portableWireSize(char(1)), 1u);
+  EXPECT_EQ(portableWireSize(int8_t(1)), 1u);
+  EXPECT_EQ(portableWireSize(uint8_t(1)), 1u);
+  EXPECT_EQ(portableWireSize(int16_t(1)), 2u);
+  EXPECT_EQ(portableWireSize(uint16_t(1)), 2u);
+  EXPECT_EQ(portableWireSize(int32_t(1)), 4u);
+  EXPECT_EQ(portableWireSize(uint32_t(1)), 4u);
+  EXPECT_EQ(portableWireSize(int64_t(1)), 8u);
+  EXPECT_EQ(portableWireSize(uint64_t(1)), 8u);
+  EXPECT_EQ(portableWireSize(1L), 8u);
+  EXPECT_EQ(portableWireSize(1UL), 8u);
+  EXPECT_EQ(portableWireSize(1LL), 8u);
+  EXPECT_EQ(portableWireSize(1ULL), 8u);
+  EXPECT_EQ(portableWireSize(1.0f), 4u);
+  EXPECT_EQ(portableWireSize(1.0), 8u);
+  EXPECT_EQ(portableWireSize(Venue::Dark), 1u);
+  EXPECT_EQ(portableWireSize(std::string("ab")), 10u);
+}
+
+TEST_F(SerializationTest, PortableLayoutIsLittleEndian) {
+  std::vector<uint8_t> bytes;
+  serializeToPortable(bytes, uint32_t(0x01020304),
+                      std::vector<uint16_t>{0x0a0b}, long(-2), true);
+  std::vector<uint8_t> expected{0x04, 0x03, 0x02, 0x01, 1,    0,    0,
+                                0,    0,    0,    0,    0,    0x0b, 0x0a,
+                                0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                0xff, 1};
+  EXPECT_EQ(bytes, expected);
+
+  std::string_view view((const char *)bytes.data(), bytes.size());
+  uint32_t value = 0;
+  std::vector<uint16_t> values;
+  long negative = 0;
+  bool flag = false;
+  deserializePortableBuffer(view, value, values, negative, flag);
+  EXPECT_EQ(value, 0x01020304u);
+  EXPECT_EQ(values, std::vector<uint16_t>{0x0a0b});
+  EXPECT_EQ(negative, -2);
+  EXPECT_TRUE(flag);
+
+  std::vector<uint8_t> wide;
+  serializeToPortable(wide, int64_t(1) << 40);
+  int64_t truncated = 0;
+  EXPECT_THROW(deserializePortableBuffer(
+                   std::string_view((const char *)wide.data(), 4), truncated),
+               DataFormatError);
+}
+
+TEST_F(SerializationTest, ByteSwapElements) {
+  std::vector<uint32_t> words(37);
+  std::vector<uint64_t> quads(19);
+  for (size_t i = 0; i != words.size(); ++i) {
+    words[i] = 0x01020304u + (uint32_t)i;
+  }
+  for (size_t i = 0; i != quads.size(); ++i) {
+    quads[i] = 0x0102030405060708ull + i;
+  }
+  std::vector<uint32_t> swapped_words(words.size());
+  std::vector<uint64_t> swapped_quads(quads.size());
+  byte_swap_elements<uint32_t>(swapped_words.data(), words.data(),
+                               words.size());
+  byte_swap_elements<uint64_t>(swapped_quads.data(), quads.data(),
+                               quads.size());
+  for (size_t i = 0; i != words.size(); ++i) {
+    EXPECT_EQ(swapped_words[i], __builtin_bswap32(words[i]));
+  }
+  for (size_t i = 0; i != quads.size(); ++i) {
+    EXPECT_EQ(swapped_quads[i], __builtin_bswap64(quads[i]));
+  }
+}
+
+TEST_F(SerializationTest, FramedRoundTrip) {
+  TestStruct data{7, "framed", 2.5};
+  std::vector<uint32_t> values(50000, 3);
+  BufferHandle frame = serializeToFramedBuffer(data, values);
+  EXPECT_EQ(frame->get_size(),
+            FrameHeader::size + serializeToBuffer(data, values)->get_size());
+
+  TestStruct result;
+  std::vector<uint32_t> result_values;
+  deserializeFramedBuffer(frame, result, result_values);
+  EXPECT_EQ(result.y, "framed");
+  EXPECT_EQ(result_values, values);
+
+  BufferSlice slice(serializeToFramedBuffer(std::string_view("payload")));
+  BufferSlice borrowed;
+  deserializeFramedBuffer(slice, borrowed);
+  EXPECT_EQ(borrowed.view(), "payload");
+  EXPECT_EQ(borrowed.get_block(), slice.get_block());
+}
+
+TEST_F(SerializationTest, FramedRejectsCorruption) {
+  BufferHandle frame = serializeToFramedBuffer(std::string(1000, 'x'), 42);
+  std::string bytes((const char *)frame->get_data(), frame->get_size());
+  std::string result;
+  int number = 0;
+  deserializeFramedBuffer(bytes, result, number);
+  EXPECT_EQ(number, 42);
+
+  std::string flipped = bytes;
+  flipped[FrameHeader::size + 500] ^= 1;
+  EXPECT_THROW(deserializeFramedBuffer(flipped, result, number),
+               DataFormatError);
+  EXPECT_THROW(deserializeFramedBuffer(bytes.substr(0, bytes.size() - 1),
+                                       result, number),
+               DataFormatError);
+  EXPECT_THROW(deserializeFramedBuffer(bytes.substr(0, 8), result, number),
+               DataFormatError);
+  std::string bad_magic = bytes;
+  bad_magic[0] ^= 1;
+  EXPECT_THROW(deserializeFramedBuffer(bad_magic, result, number),
+               DataFormatError);
+
+  std::string stream = bytes + bytes;
+  std::string_view rest = deserializeFramedBufferPart(stream, result, number);
+  EXPECT_EQ(rest.size(), bytes.size());
+  EXPECT_THROW(deserializeFramedBuffer(stream, result, number),
+               DataFormatError);
+}
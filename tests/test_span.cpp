@@ -0,0 +1,51 @@
+#include "span.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace turbokit;
+
+class SpanTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(SpanTest, DefaultConstruction) {
+  Span<int> span;
+  EXPECT_EQ(span.size(), 0u);
+  EXPECT_TRUE(span.empty());
+  EXPECT_EQ(span.begin(), span.end());
+}
+
+TEST_F(SpanTest, ViewsExistingElements) {
+  std::vector<int> values{1, 2, 3, 4};
+  Span<int> span(values.data(), values.size());
+  EXPECT_EQ(span.size(), 4u);
+  EXPECT_EQ(span[2], 3);
+  span[2] = 30;
+  EXPECT_EQ(values[2], 30);
+
+  int sum = 0;
+  for (int value : span) {
+    sum += value;
+  }
+  EXPECT_EQ(sum, 37);
+
+  Span<const int> readonly = span;
+  EXPECT_EQ(readonly.get_data(), values.data());
+  EXPECT_THROW(readonly.get_at(4), std::out_of_range);
+}
+
+TEST_F(SpanTest, ArraysAndSubspans) {
+  double array[5] = {0, 1, 2, 3, 4};
+  Span<double> span(array);
+  EXPECT_EQ(span.size(), 5u);
+
+  Span<double> middle = span.subspan(1, 3);
+  EXPECT_EQ(middle.size(), 3u);
+  EXPECT_EQ(middle[0], 1);
+  EXPECT_EQ(span.subspan(4).size(), 1u);
+  EXPECT_TRUE(span.subspan(5).empty());
+  EXPECT_THROW(span.subspan(6), std::out_of_range);
+  EXPECT_THROW(span.subspan(2, 4), std::out_of_range);
+}
@@ -0,0 +1,74 @@
+#include "stopwatch.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace turbokit;
+
+class StopwatchTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(StopwatchTest, CyclesIncrease) {
+  int64_t begin = readCyclesBegin();
+  int64_t end = readCyclesEnd();
+  EXPECT_GT(end, begin);
+}
+
+TEST_F(StopwatchTest, StartStopAccumulates) {
+  CycleStopwatch stopwatch;
+  for (int i = 0; i != 10; ++i) {
+    stopwatch.start();
+    int64_t interval = stopwatch.stop();
+    EXPECT_GE(interval, 0);
+  }
+  EXPECT_EQ(stopwatch.interval_count, 10u);
+  EXPECT_GT(stopwatch.elapsed_cycles(), 0);
+
+  stopwatch.reset();
+  EXPECT_EQ(stopwatch.interval_count, 0u);
+  EXPECT_EQ(stopwatch.elapsed_cycles(), 0);
+}
+
+TEST_F(StopwatchTest, ConvertsToNanoseconds) {
+  CycleStopwatch stopwatch;
+  stopwatch.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  stopwatch.stop();
+
+  auto elapsed = stopwatch.elapsed();
+  EXPECT_GE(elapsed, std::chrono::microseconds(1500));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+}
+
+TEST_F(StopwatchTest, CycleConversionMatchesClock) {
+  int64_t start_time = time_manager.get_current_time();
+  int64_t start_cycles = readCyclesBegin();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  int64_t end_cycles = readCyclesEnd();
+  int64_t end_time = time_manager.get_current_time();
+
+  int64_t converted = time_manager.cycles_to_nanoseconds(end_cycles -
+                                                         start_cycles);
+  EXPECT_NEAR(converted, end_time - start_time, 1000000);
+}
+
+TEST_F(StopwatchTest, ScopedTimerWithStopwatch) {
+  CycleStopwatch stopwatch;
+  for (int i = 0; i != 3; ++i) {
+    ScopedTimer timer(stopwatch);
+  }
+  EXPECT_EQ(stopwatch.interval_count, 3u);
+}
+
+TEST_F(StopwatchTest, ScopedTimerWithCallback) {
+  int64_t recorded = -1;
+  {
+    ScopedTimer timer([&](int64_t cycles) { recorded = cycles; });
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  EXPECT_GT(recorded, 0);
+  EXPECT_GE(time_manager.cycles_to_nanoseconds(recorded), 50000);
+}
@@ -0,0 +1,221 @@
+#include "stream_serialization.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace turbokit;
+
+class StreamSerializationTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char path[] = "/tmp/turbokit_stream_XXXXXX";
+    fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+  }
+  void TearDown() override { close(fd); }
+
+  void rewind() { ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0); }
+
+  std::string contents() {
+    std::string result(lseek(fd, 0, SEEK_END), '\0');
+    EXPECT_EQ(pread(fd, result.data(), result.size(), 0),
+              (ssize_t)result.size());
+    return result;
+  }
+
+  int fd = -1;
+};
+
+struct StreamRecordV1 {
+  uint32_t version = 0;
+  std::string name;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 1, name);
+  }
+};
+
+struct StreamRecordV2 {
+  uint32_t version = 0;
+  std::string name;
+  std::vector<double> samples;
+
+  template <typename X> void serialize(X &x) {
+    version = serializeVersioned(x, 2, name, samples);
+  }
+};
+
+TEST_F(StreamSerializationTest, RoundTripThroughSmallWindow) {
+  std::vector<float> values(100000);
+  for (size_t i = 0; i != values.size(); ++i) {
+    values[i] = i * 0.5f;
+  }
+  std::string text(50000, 'x');
+  text[49999] = 'y';
+  std::map<std::string, int> lookup{{"a", 1}, {"b", 2}};
+  std::vector<std::string> names(1000, "name");
+
+  {
+    StreamWriter writer(fd, 4096);
+    writer.serialize(values, text, lookup);
+    writer.serialize(names, 42);
+    EXPECT_EQ(writer.tell(), (uint64_t)serializeToBuffer(values, text, lookup,
+                                                         names, 42)
+                                 ->get_size());
+  }
+  auto expected = serializeToBuffer(values, text, lookup, names, 42);
+  EXPECT_EQ(contents(), std::string((const char *)expected->get_data(),
+                                    expected->get_size()));
+
+  rewind();
+  std::vector<float> values2;
+  std::string text2;
+  std::map<std::string, int> lookup2;
+  std::vector<std::string> names2;
+  int tail = 0;
+  StreamReader reader(fd, 4096);
+  reader.deserialize(values2, text2, lookup2);
+  reader.deserialize(names2, tail);
+  EXPECT_EQ(values2, values);
+  EXPECT_EQ(text2, text);
+  EXPECT_EQ(lookup2, lookup);
+  EXPECT_EQ(names2, names);
+  EXPECT_EQ(tail, 42);
+  EXPECT_TRUE(reader.empty());
+}
+
+struct StreamPoint {
+  float x, y, z;
+};
+
+TEST_F(StreamSerializationTest, ElementsLargerThanOneByteAcrossWindows) {
+  // 12-byte elements never divide the window evenly.
+  std::vector<StreamPoint> points(100000);
+  for (size_t i = 0; i != points.size(); ++i) {
+    points[i] = {float(i), float(i) * 2, float(i) * 3};
+  }
+  serializeToFd(fd, points);
+  for (size_t window_size : {size_t(100), size_t(4096), size_t(1) << 20}) {
+    rewind();
+    std::vector<StreamPoint> result;
+    StreamReader reader(fd, window_size);
+    reader.deserialize(result);
+    ASSERT_EQ(result.size(), points.size());
+    EXPECT_EQ(std::memcmp(result.data(), points.data(),
+                          points.size() * sizeof(StreamPoint)),
+              0);
+  }
+
+  // A count whose byte size wraps around must not turn into a short read.
+  ASSERT_EQ(ftruncate(fd, 0), 0);
+  rewind();
+  size_t corrupt_count = std::numeric_limits<size_t>::max() / 4;
+  ASSERT_EQ(write(fd, &corrupt_count, sizeof(corrupt_count)),
+            (ssize_t)sizeof(corrupt_count));
+  rewind();
+  std::vector<StreamPoint> result;
+  EXPECT_THROW(deserializeFromFd(fd, result), DataFormatError);
+}
+
+struct StreamBlob {
+  uint8_t bytes[200];
+};
+
+TEST_F(StreamSerializationTest, TrivialValueLargerThanWindow) {
+  StreamBlob blob;
+  for (size_t i = 0; i != sizeof(blob.bytes); ++i) {
+    blob.bytes[i] = uint8_t(i * 7);
+  }
+  serializeToFd(fd, 1, blob, 2, blob);
+  rewind();
+  StreamBlob first{}, second{};
+  int before = 0, between = 0;
+  StreamReader reader(fd, 64);
+  reader.deserialize(before, first, between, second);
+  EXPECT_EQ(before, 1);
+  EXPECT_EQ(between, 2);
+  EXPECT_EQ(std::memcmp(first.bytes, blob.bytes, sizeof(blob.bytes)), 0);
+  EXPECT_EQ(std::memcmp(second.bytes, blob.bytes, sizeof(blob.bytes)), 0);
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST_F(StreamSerializationTest, VersionedSkipOverFileAndPipe) {
+  StreamRecordV2 newer;
+  newer.name = "feed";
+  newer.samples.assign(20000, 1.5);
+  serializeToFd(fd, newer, std::string("tail"));
+
+  rewind();
+  StreamRecordV1 older;
+  std::string tail;
+  deserializeFromFd(fd, older, tail);
+  EXPECT_EQ(older.version, 2u);
+  EXPECT_EQ(older.name, "feed");
+  EXPECT_EQ(tail, "tail");
+
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  std::string data = contents();
+  ASSERT_EQ(write(pipe_fds[1], data.data(), 1024), 1024);
+  StreamReader reader(pipe_fds[0], 256);
+  older = {};
+  tail.clear();
+  // The rest arrives while the reader is skipping; pipes cannot lseek.
+  std::thread producer([&] {
+    size_t length = data.size() - 1024;
+    EXPECT_EQ(write(pipe_fds[1], data.data() + 1024, length),
+              (ssize_t)length);
+    close(pipe_fds[1]);
+  });
+  reader.deserialize(older, tail);
+  producer.join();
+  EXPECT_EQ(older.name, "feed");
+  EXPECT_EQ(tail, "tail");
+  EXPECT_TRUE(reader.empty());
+  close(pipe_fds[0]);
+}
+
+TEST_F(StreamSerializationTest, BufferSlicesAndTruncation) {
+  BufferHandle block = makeBuffer(10000);
+  for (size_t i = 0; i != 10000; ++i) {
+    block->get_data()[i] = std::byte(i);
+  }
+  BufferSlice slice(std::move(block));
+  serializeToFd(fd, slice, std::string(5000, 'z'));
+
+  rewind();
+  BufferSlice slice2;
+  std::string text;
+  StreamReader reader(fd, 512);
+  reader.deserialize(slice2, text);
+  ASSERT_EQ(slice2.get_size(), slice.get_size());
+  EXPECT_EQ(slice2.view(), slice.view());
+  // Read straight into a block of exactly the slice's size.
+  EXPECT_EQ(slice2.get_block()->get_size(), slice.get_size());
+  EXPECT_EQ(text, std::string(5000, 'z'));
+
+  ASSERT_EQ(ftruncate(fd, 0), 0);
+  rewind();
+  serializeToFd(fd, BufferSlice(makeBuffer(0)), 7);
+  rewind();
+  int after = 0;
+  deserializeFromFd(fd, slice2, after);
+  EXPECT_TRUE(slice2.empty());
+  EXPECT_EQ(after, 7);
+
+  ASSERT_EQ(ftruncate(fd, 0), 0);
+  rewind();
+  serializeToFd(fd, slice, std::string(5000, 'z'));
+
+  ASSERT_EQ(ftruncate(fd, 9000), 0);
+  rewind();
+  EXPECT_THROW(deserializeFromFd(fd, slice2, text), DataFormatError);
+}
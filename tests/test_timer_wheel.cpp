@@ -0,0 +1,184 @@
+#include "timer_wheel.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace turbokit;
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+struct TestTimer : TimerNode {
+  int id = 0;
+  int64_t deadline = 0;
+  int64_t fired_at = -1;
+};
+
+TEST_F(TimerWheelTest, FiresInDeadlineOrder) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 0);
+  TestTimer timers[4];
+  int64_t deadlines[] = {30, 10, 20, 10};
+  for (int i = 0; i != 4; ++i) {
+    timers[i].id = i;
+    wheel.schedule(timers[i], deadlines[i]);
+  }
+  EXPECT_EQ(wheel.size(), 4u);
+
+  std::vector<int> fired;
+  auto callback = [&](TimerNode &timer) {
+    fired.push_back(static_cast<TestTimer &>(timer).id);
+  };
+  EXPECT_EQ(wheel.advance(9, callback), 0u);
+  EXPECT_EQ(wheel.advance(10, callback), 2u);
+  EXPECT_EQ(wheel.advance(100, callback), 2u);
+  EXPECT_EQ(fired, (std::vector<int>{1, 3, 2, 0}));
+  EXPECT_TRUE(wheel.empty());
+  for (auto &timer : timers) {
+    EXPECT_FALSE(timer.is_scheduled());
+  }
+}
+
+TEST_F(TimerWheelTest, NeverFiresEarly) {
+  TimerWheel wheel(std::chrono::milliseconds(1), 0);
+  TestTimer timer;
+  wheel.schedule(timer, 1500000);
+  int fired = 0;
+  wheel.advance(1999999, [&](TimerNode &) { ++fired; });
+  EXPECT_EQ(fired, 0);
+  wheel.advance(2000000, [&](TimerNode &) { ++fired; });
+  EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerWheelTest, CancelAndReschedule) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 0);
+  TestTimer first, second;
+  wheel.schedule(first, 100);
+  wheel.schedule(second, 5000);
+  EXPECT_TRUE(wheel.cancel(first));
+  EXPECT_FALSE(wheel.cancel(first));
+  wheel.schedule(second, 50);
+  EXPECT_EQ(wheel.size(), 1u);
+  EXPECT_EQ(wheel.next_expiry_time(), std::optional<int64_t>(50));
+
+  std::vector<TimerNode *> fired;
+  wheel.advance(10000, [&](TimerNode &timer) { fired.push_back(&timer); });
+  EXPECT_EQ(fired, (std::vector<TimerNode *>{&second}));
+  EXPECT_FALSE(wheel.next_expiry_time());
+}
+
+TEST_F(TimerWheelTest, PastDeadlinesFireOnNextAdvance) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 1000);
+  TestTimer timer;
+  wheel.schedule(timer, 10);
+  int fired = 0;
+  wheel.advance(1000, [&](TimerNode &) { ++fired; });
+  EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerWheelTest, CallbackCanReschedule) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 0);
+  TestTimer timer;
+  wheel.schedule(timer, 10);
+  std::vector<int64_t> fired;
+  int64_t now = 0;
+  for (now = 0; now <= 100; now += 7) {
+    wheel.advance(now, [&](TimerNode &node) {
+      fired.push_back(now);
+      if (fired.size() < 3) {
+        wheel.schedule(node, now);
+      }
+    });
+  }
+  EXPECT_EQ(fired, (std::vector<int64_t>{14, 21, 28}));
+}
+
+TEST_F(TimerWheelTest, MatchesMultimapOverLongRanges) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 0);
+  std::mt19937_64 random(7);
+  const int timer_count = 20000;
+  std::vector<TestTimer> timers(timer_count);
+  std::multimap<int64_t, int> expected;
+  for (int i = 0; i != timer_count; ++i) {
+    int magnitude = random() % 40;
+    timers[i].id = i;
+    timers[i].deadline = random() % ((int64_t)1 << magnitude) + 1;
+    wheel.schedule(timers[i], timers[i].deadline);
+  }
+  for (int i = 0; i < timer_count; i += 3) {
+    wheel.cancel(timers[i]);
+  }
+  for (int i = 0; i != timer_count; ++i) {
+    if (i % 3 != 0) {
+      expected.emplace(timers[i].deadline, i);
+    }
+  }
+  EXPECT_EQ(wheel.size(), expected.size());
+
+  int64_t now = 0;
+  size_t fired_count = 0;
+  while (!wheel.empty()) {
+    now += random() % ((int64_t)1 << (random() % 36)) + 1;
+    fired_count += wheel.advance(now, [&](TimerNode &node) {
+      auto &timer = static_cast<TestTimer &>(node);
+      ASSERT_EQ(timer.fired_at, -1);
+      timer.fired_at = now;
+    });
+  }
+  EXPECT_EQ(fired_count, expected.size());
+  int64_t previous_deadline = 0;
+  int64_t previous_now = 0;
+  for (auto &[deadline, id] : expected) {
+    ASSERT_GE(timers[id].fired_at, deadline);
+    if (deadline > previous_deadline) {
+      ASSERT_GE(timers[id].fired_at, previous_now);
+    }
+    previous_deadline = deadline;
+    previous_now = timers[id].fired_at;
+  }
+}
+
+TEST_F(TimerWheelTest, FiresPromptlyAfterEachAdvance) {
+  TimerWheel wheel(std::chrono::nanoseconds(1), 0);
+  std::vector<TestTimer> timers(1000);
+  for (size_t i = 0; i != timers.size(); ++i) {
+    timers[i].deadline = (int64_t)i * 4099 + 1;
+    wheel.schedule(timers[i], timers[i].deadline);
+  }
+  for (int64_t now = 0; !wheel.empty(); now += 1000) {
+    wheel.advance(now, [&](TimerNode &node) {
+      auto &timer = static_cast<TestTimer &>(node);
+      ASSERT_LE(timer.deadline, now);
+      ASSERT_GT(timer.deadline, now - 1000);
+    });
+  }
+}
+
+TEST_F(TimerWheelTest, OverflowBeyondTopLevel) {
+  BasicTimerWheel<2> wheel(std::chrono::nanoseconds(1), 0);
+  TestTimer near_timer, far_timer;
+  wheel.schedule(near_timer, 100);
+  wheel.schedule(far_timer, 100000);
+  std::vector<TimerNode *> fired;
+  auto callback = [&](TimerNode &timer) { fired.push_back(&timer); };
+  wheel.advance(99999, callback);
+  EXPECT_EQ(fired, (std::vector<TimerNode *>{&near_timer}));
+  wheel.advance(100000, callback);
+  EXPECT_EQ(fired, (std::vector<TimerNode *>{&near_timer, &far_timer}));
+}
+
+TEST_F(TimerWheelTest, UsesClockByDefault) {
+  TimerWheel wheel;
+  TestTimer timer;
+  wheel.schedule_after(timer, std::chrono::milliseconds(2));
+  int fired = 0;
+  wheel.advance([&](TimerNode &) { ++fired; });
+  EXPECT_EQ(fired, 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  wheel.advance([&](TimerNode &) { ++fired; });
+  EXPECT_EQ(fired, 1);
+}
@@ -0,0 +1,159 @@
+#include "trace.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace turbokit;
+
+class TraceTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    traceRegistry.stop();
+    traceRegistry.clear();
+  }
+  void TearDown() override {
+    traceRegistry.stop();
+    traceRegistry.clear();
+  }
+};
+
+static size_t countOccurrences(const std::string &text,
+                               const std::string &pattern) {
+  size_t count = 0;
+  for (size_t position = text.find(pattern); position != std::string::npos;
+       position = text.find(pattern, position + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+static void tracedWork(int depth) {
+  TURBOKIT_TRACE_SCOPE("tracedWork");
+  if (depth > 0) {
+    tracedWork(depth - 1);
+  }
+}
+
+TEST_F(TraceTest, DisabledRecordsNothing) {
+  tracedWork(3);
+  std::string json = traceRegistry.export_chrome_json();
+  EXPECT_EQ(countOccurrences(json, "\"tracedWork\""), 0u);
+}
+
+TEST_F(TraceTest, RecordsNestedScopes) {
+  traceRegistry.start();
+  {
+    TURBOKIT_TRACE_SCOPE("outer");
+    tracedWork(2);
+  }
+  traceRegistry.stop();
+  std::string json = traceRegistry.export_chrome_json();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+  EXPECT_EQ(countOccurrences(json, "\"name\":\"outer\",\"ph\":\"B\""), 1u);
+  EXPECT_EQ(countOccurrences(json, "\"name\":\"outer\",\"ph\":\"E\""), 1u);
+  EXPECT_EQ(countOccurrences(json, "\"name\":\"tracedWork\",\"ph\":\"B\""), 3u);
+  EXPECT_EQ(countOccurrences(json, "\"name\":\"tracedWork\",\"ph\":\"E\""), 3u);
+  EXPECT_LT(json.find("\"outer\",\"ph\":\"B\""),
+            json.find("\"tracedWork\",\"ph\":\"B\""));
+}
+
+TEST_F(TraceTest, SeparatesThreadsAndNames) {
+  traceRegistry.start();
+  std::vector<std::thread> threads;
+  for (int i = 0; i != 3; ++i) {
+    threads.emplace_back([i] {
+      traceRegistry.set_thread_name("worker \"" + std::to_string(i) + "\"");
+      for (int j = 0; j != 10; ++j) {
+        TURBOKIT_TRACE_SCOPE("threadWork");
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  traceRegistry.stop();
+  std::string json = traceRegistry.export_chrome_json();
+  EXPECT_EQ(countOccurrences(json, "\"threadWork\",\"ph\":\"B\""), 30u);
+  EXPECT_EQ(countOccurrences(json, "\"thread_name\""), 3u);
+  EXPECT_NE(json.find("worker \\\"1\\\""), std::string::npos);
+}
+
+TEST_F(TraceTest, ReusesBuffersOfExitedThreads) {
+  traceRegistry.start();
+  auto runWorker = [](int i) {
+    std::thread([i] {
+      traceRegistry.set_thread_name("churn " + std::to_string(i));
+      TURBOKIT_TRACE_SCOPE("churnWork");
+    }).join();
+  };
+  runWorker(0);
+  size_t buffer_count = traceRegistry.buffers.size();
+  for (int i = 1; i != 20; ++i) {
+    runWorker(i);
+  }
+  traceRegistry.stop();
+  EXPECT_EQ(traceRegistry.buffers.size(), buffer_count);
+
+  // Events of earlier owners stay in the ring under their own thread ids.
+  std::string json = traceRegistry.export_chrome_json();
+  EXPECT_EQ(countOccurrences(json, "\"churnWork\",\"ph\":\"B\""), 20u);
+  EXPECT_EQ(countOccurrences(json, "\"churnWork\",\"ph\":\"E\""), 20u);
+  EXPECT_EQ(countOccurrences(json, "\"thread_name\""), 20u);
+  EXPECT_NE(json.find("\"churn 0\""), std::string::npos);
+  EXPECT_NE(json.find("\"churn 19\""), std::string::npos);
+}
+
+TEST_F(TraceTest, SamplesOuterScopes) {
+  traceRegistry.start(4);
+  for (int i = 0; i != 40; ++i) {
+    tracedWork(1);
+  }
+  traceRegistry.stop();
+  std::string json = traceRegistry.export_chrome_json();
+  EXPECT_EQ(countOccurrences(json, "\"tracedWork\",\"ph\":\"B\""), 20u);
+  EXPECT_EQ(countOccurrences(json, "\"tracedWork\",\"ph\":\"E\""), 20u);
+}
+
+TEST_F(TraceTest, RingOverwritesOldestEvents) {
+  traceRegistry.start();
+  size_t capacity = TraceRegistry::default_buffer_capacity;
+  for (size_t i = 0; i != capacity; ++i) {
+    TURBOKIT_TRACE_SCOPE("wrapped");
+  }
+  traceRegistry.stop();
+  std::string json = traceRegistry.export_chrome_json();
+  size_t begins = countOccurrences(json, "\"wrapped\",\"ph\":\"B\"");
+  size_t ends = countOccurrences(json, "\"wrapped\",\"ph\":\"E\"");
+  EXPECT_EQ(begins, capacity / 2);
+  EXPECT_EQ(ends, capacity / 2);
+}
+
+TEST_F(TraceTest, TimestampsAreOrderedMicroseconds) {
+  traceRegistry.start();
+  {
+    TURBOKIT_TRACE_SCOPE("timed");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  traceRegistry.stop();
+  std::string json = traceRegistry.export_chrome_json();
+  auto timestampAfter = [&](const std::string &marker) {
+    size_t position = json.find("\"ts\":", json.find(marker));
+    return std::stod(json.substr(position + 5));
+  };
+  double begin = timestampAfter("\"timed\",\"ph\":\"B\"");
+  double end = timestampAfter("\"timed\",\"ph\":\"E\"");
+  EXPECT_GE(end - begin, 1500.0);
+  EXPECT_LT(end - begin, 100000.0);
+}
+
+TEST_F(TraceTest, WriteChromeTraceReportsErrors) {
+  EXPECT_FALSE(
+      traceRegistry.write_chrome_trace("/nonexistent/dir/trace.json"));
+  char path[] = "/tmp/turbokit_traceXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  EXPECT_TRUE(traceRegistry.write_chrome_trace(path));
+  unlink(path);
+}